@@ -0,0 +1,58 @@
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t thread_allocation_count = 0;
+
+} // namespace
+
+bool IsAllocationCountingEnabled() {
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t GetThreadAllocationCount() {
+    return thread_allocation_count;
+}
+
+AllocationCounter::AllocationCounter()
+        : start_count_(thread_allocation_count) {
+}
+
+uint64_t AllocationCounter::Count() const {
+    return thread_allocation_count - start_count_;
+}
+
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+
+// Остальные формы operator new и operator delete стандартной библиотеки, кроме
+// выровненных, выражены через эти три, поэтому их достаточно заменить
+void* operator new(std::size_t size) {
+    ++thread_allocation_count;
+    while (true) {
+        if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+            return pointer;
+        }
+        const std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+#endif
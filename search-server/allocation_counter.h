@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Режим подсчёта выделений памяти включается макросом SEARCH_SERVER_COUNT_ALLOCATIONS:
+// тогда глобальные operator new и operator delete заменяются в allocation_counter.cpp.
+// Без макроса замены нет, и счётчики всегда равны нулю - так собираются рабочая программа
+// и сборки с санитайзерами, у которых свой operator new
+bool IsAllocationCountingEnabled();
+
+// Число обращений текущего потока к глобальному operator new с начала его работы.
+// Счётчик у каждого потока свой и не требует синхронизации
+uint64_t GetThreadAllocationCount();
+
+// Считает выделения памяти текущим потоком от создания объекта до вызова Count
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    uint64_t Count() const;
+
+private:
+    const uint64_t start_count_;
+};
@@ -0,0 +1,118 @@
+#include "async_search_server.h"
+
+#include <algorithm>
+#include <execution>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, BatchOptions options)
+        : search_server_(search_server)
+        , options_(options) {
+    if (options_.max_batch_size == 0) {
+        throw invalid_argument("Размер пакета запросов должен быть положительным"s);
+    }
+    // поток запускается последним, когда все поля уже инициализированы
+    worker_ = thread([this] { Run(); });
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    queue_changed_.notify_one();
+    worker_.join();
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocuments(string raw_query) {
+    PendingQuery query{move(raw_query), {}, RequestStats::Clock::now()};
+    future<vector<Document>> result = query.result.get_future();
+    bool needs_notify = false;
+    {
+        lock_guard guard(mutex_);
+        if (pending_queries_.empty()) {
+            oldest_query_time_ = query.arrival_time;
+        }
+        pending_queries_.push_back(move(query));
+        // исполнитель будится на первом запросе пакета, чтобы засечь время, и на полном пакете
+        needs_notify = pending_queries_.size() == 1 || pending_queries_.size() >= options_.max_batch_size;
+    }
+    if (needs_notify) {
+        queue_changed_.notify_one();
+    }
+    return result;
+}
+
+void AsyncSearchServer::Run() {
+    unique_lock lock(mutex_);
+    while (true) {
+        queue_changed_.wait(lock, [this] { return is_stopping_ || !pending_queries_.empty(); });
+        if (pending_queries_.empty()) {
+            return;
+        }
+        // неполный пакет ждёт попутных запросов не дольше max_wait от самого старого
+        queue_changed_.wait_until(lock, oldest_query_time_ + options_.max_wait, [this] {
+            return is_stopping_ || pending_queries_.size() >= options_.max_batch_size;
+        });
+
+        vector<PendingQuery> batch;
+        if (pending_queries_.size() <= options_.max_batch_size) {
+            batch.swap(pending_queries_);
+        } else {
+            const auto batch_end = pending_queries_.begin() + options_.max_batch_size;
+            batch.assign(make_move_iterator(pending_queries_.begin()), make_move_iterator(batch_end));
+            // оставшиеся запросы пришли позже отправленных; отсчёт ожидания от прежнего, более
+            // раннего момента не сбрасывается, и следующий пакет уходит не позже max_wait от их прихода
+            pending_queries_.erase(pending_queries_.begin(), batch_end);
+        }
+
+        lock.unlock();
+        ProcessBatch(batch);
+        lock.lock();
+    }
+}
+
+RequestWindowStats AsyncSearchServer::GetStats(StatsWindow window) const {
+    return stats_.GetStats(window);
+}
+
+void AsyncSearchServer::ProcessBatch(vector<PendingQuery>& batch) {
+    vector<string_view> queries;
+    queries.reserve(batch.size());
+    for (const PendingQuery& query : batch) {
+        queries.push_back(query.raw_query);
+    }
+
+    try {
+        vector<vector<Document>> results = search_server_.FindTopDocumentsBatch(queries);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // статистика записывается до результата, чтобы получивший его видел свой запрос
+            RecordRequest(batch[i], results[i].size());
+            batch[i].result.set_value(move(results[i]));
+        }
+        return;
+    } catch (const exception&) {
+        // в пакете есть некорректный запрос - запросы исполняются по одному ниже
+    }
+
+    // исключение внутри параллельного алгоритма завершает программу, поэтому
+    // ошибка каждого запроса перехватывается и передаётся только его автору
+    for_each(execution::par,
+             batch.begin(), batch.end(),
+             [this](PendingQuery& query) {
+                 try {
+                     vector<Document> documents = search_server_.FindTopDocuments(query.raw_query);
+                     RecordRequest(query, documents.size());
+                     query.result.set_value(move(documents));
+                 } catch (...) {
+                     query.result.set_exception(current_exception());
+                 }
+             });
+}
+
+void AsyncSearchServer::RecordRequest(const PendingQuery& query, size_t result_count) {
+    const RequestStats::Clock::time_point now = RequestStats::Clock::now();
+    stats_.Record(now, chrono::duration_cast<chrono::microseconds>(now - query.arrival_time), result_count);
+}
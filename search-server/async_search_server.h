@@ -0,0 +1,64 @@
+#pragma once
+
+#include "request_stats.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Настройки группировки запросов: пакет отправляется на исполнение, когда в нём
+// набралось max_batch_size запросов или самый старый запрос ждёт дольше max_wait
+struct BatchOptions {
+    size_t max_batch_size = 64;
+    std::chrono::microseconds max_wait{200};
+};
+
+// Асинхронный интерфейс поиска. Запросы, пришедшие из разных потоков почти одновременно,
+// собираются в пакет и исполняются вместе через FindTopDocumentsBatch, результат
+// возвращается через future. Пока объект существует, search_server нельзя изменять
+class AsyncSearchServer {
+public:
+    explicit AsyncSearchServer(const SearchServer& search_server, BatchOptions options = {});
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    // Дожидается исполнения всех принятых запросов
+    ~AsyncSearchServer();
+
+    // Ошибка разбора запроса передаётся через future как исключение
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query);
+
+    // Статистика исполненных запросов: время от приёма запроса до готовности результата.
+    // Запросы, завершившиеся ошибкой, не учитываются
+    RequestWindowStats GetStats(StatsWindow window) const;
+
+private:
+    struct PendingQuery {
+        std::string raw_query;
+        std::promise<std::vector<Document>> result;
+        RequestStats::Clock::time_point arrival_time;
+    };
+
+    const SearchServer& search_server_;
+    const BatchOptions options_;
+    RequestStats stats_;
+
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::vector<PendingQuery> pending_queries_;
+    std::chrono::steady_clock::time_point oldest_query_time_;
+    bool is_stopping_ = false;
+    std::thread worker_;
+
+    void Run();
+
+    void ProcessBatch(std::vector<PendingQuery>& batch);
+
+    void RecordRequest(const PendingQuery& query, size_t result_count);
+};
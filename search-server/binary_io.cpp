@@ -0,0 +1,128 @@
+#include "binary_io.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+array<uint32_t, 256> MakeCrc32Table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+} // namespace
+
+uint32_t ComputeCrc32(string_view data) {
+    static const array<uint32_t, 256> table = MakeCrc32Table();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void ByteWriter::WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+        data_.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    data_.push_back(static_cast<char>(value));
+}
+
+void ByteWriter::WriteInt(int value) {
+    // zigzag: небольшие по модулю отрицательные числа тоже занимают мало байт
+    const auto unsigned_value = static_cast<uint32_t>(value);
+    WriteVarint((unsigned_value << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+
+void ByteWriter::WriteUint32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        data_.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void ByteWriter::WriteDouble(double value) {
+    char bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(double));
+    data_.append(bytes, sizeof(double));
+}
+
+void ByteWriter::WriteString(string_view value) {
+    WriteVarint(value.size());
+    data_.append(value);
+}
+
+void ByteWriter::WriteBytes(string_view bytes) {
+    data_.append(bytes);
+}
+
+const string& ByteWriter::Data() const {
+    return data_;
+}
+
+string& ByteWriter::Data() {
+    return data_;
+}
+
+ByteReader::ByteReader(string_view data)
+        : data_(data) {
+}
+
+uint64_t ByteReader::ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const auto byte = static_cast<unsigned char>(ReadBytes(1)[0]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw invalid_argument("Слишком длинное число в двоичных данных"s);
+}
+
+int ByteReader::ReadInt() {
+    const auto value = static_cast<uint32_t>(ReadVarint());
+    return static_cast<int>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+uint32_t ByteReader::ReadUint32() {
+    const string_view bytes = ReadBytes(4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+double ByteReader::ReadDouble() {
+    double value;
+    memcpy(&value, ReadBytes(sizeof(double)).data(), sizeof(double));
+    return value;
+}
+
+string_view ByteReader::ReadString() {
+    return ReadBytes(ReadVarint());
+}
+
+string_view ByteReader::ReadBytes(size_t size) {
+    if (size > data_.size()) {
+        throw invalid_argument("Неожиданный конец двоичных данных"s);
+    }
+    const string_view result = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return result;
+}
+
+bool ByteReader::Empty() const {
+    return data_.empty();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Контрольная сумма CRC-32 (многочлен 0xEDB88320, как в zlib)
+uint32_t ComputeCrc32(std::string_view data);
+
+// Запись чисел и строк в двоичный буфер: целые - в кодировке переменной длины,
+// числа double - побитовой копией, чтобы после чтения совпадать в точности
+class ByteWriter {
+public:
+    void WriteVarint(uint64_t value);
+
+    void WriteInt(int value);
+
+    void WriteUint32(uint32_t value);
+
+    void WriteDouble(double value);
+
+    void WriteString(std::string_view value);
+
+    void WriteBytes(std::string_view bytes);
+
+    const std::string& Data() const;
+
+    std::string& Data();
+
+private:
+    std::string data_;
+};
+
+// Чтение буфера, записанного ByteWriter. При выходе за конец буфера или некорректном
+// значении бросает std::invalid_argument
+class ByteReader {
+public:
+    explicit ByteReader(std::string_view data);
+
+    uint64_t ReadVarint();
+
+    int ReadInt();
+
+    uint32_t ReadUint32();
+
+    double ReadDouble();
+
+    std::string_view ReadString();
+
+    std::string_view ReadBytes(size_t size);
+
+    bool Empty() const;
+
+private:
+    std::string_view data_;
+};
@@ -0,0 +1,221 @@
+#include "corpus_reader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw invalid_argument("Не удалось открыть файл корпуса "s + path);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw invalid_argument("Не удалось получить размер файла корпуса "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw invalid_argument("Не удалось отобразить в память файл корпуса "s + path);
+        }
+        // файл читается один раз от начала до конца
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+string_view MappedFile::Data() const {
+    return {data_, size_};
+}
+
+namespace {
+
+const int CORPUS_CHUNKS_PER_THREAD = 4;
+
+bool ParseInt(string_view text, int& value) {
+    const auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && ptr == text.data() + text.size();
+}
+
+string_view NextField(string_view& line) {
+    const size_t tab = line.find('\t');
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab == line.npos ? line.size() : tab + 1);
+    return field;
+}
+
+// Разбирает запись без исключений, чтобы её можно было вызывать из параллельного алгоритма
+bool ParseRecord(string_view line, CorpusRecord& record) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    int status = 0;
+    if (!ParseInt(NextField(line), record.id) || !ParseInt(NextField(line), status)
+        || status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+
+    string_view ratings = NextField(line);
+    while (!ratings.empty()) {
+        const size_t space = ratings.find(' ');
+        const string_view rating = ratings.substr(0, space);
+        ratings.remove_prefix(space == ratings.npos ? ratings.size() : space + 1);
+        if (rating.empty()) {
+            continue;
+        }
+        int value = 0;
+        if (!ParseInt(rating, value)) {
+            return false;
+        }
+        record.ratings.push_back(value);
+    }
+
+    record.text = line;
+    return true;
+}
+
+void SplitLines(string_view data, vector<string_view>& lines) {
+    while (!data.empty()) {
+        const size_t end_of_line = data.find('\n');
+        const string_view line = data.substr(0, end_of_line);
+        data.remove_prefix(end_of_line == data.npos ? data.size() : end_of_line + 1);
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+}
+
+// Делит данные на куски по границам строк
+vector<string_view> SplitIntoChunks(string_view data, size_t chunk_count) {
+    vector<string_view> chunks;
+    const size_t chunk_size = data.size() / chunk_count + 1;
+    while (!data.empty()) {
+        size_t end_of_chunk = data.find('\n', min(chunk_size, data.size()) - 1);
+        end_of_chunk = end_of_chunk == data.npos ? data.size() : end_of_chunk + 1;
+        chunks.push_back(data.substr(0, end_of_chunk));
+        data.remove_prefix(end_of_chunk);
+    }
+    return chunks;
+}
+
+vector<string_view> SplitLengthPrefixed(string_view data) {
+    vector<string_view> records;
+    while (!data.empty()) {
+        if (data.size() < sizeof(uint32_t)) {
+            throw invalid_argument("Обрезанный заголовок записи корпуса"s);
+        }
+        const auto* header = reinterpret_cast<const unsigned char*>(data.data());
+        const uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+        data.remove_prefix(sizeof(uint32_t));
+        if (length > data.size()) {
+            throw invalid_argument("Обрезанная запись корпуса"s);
+        }
+        records.push_back(data.substr(0, length));
+        data.remove_prefix(length);
+    }
+    return records;
+}
+
+template <typename ExecutionPolicy>
+vector<CorpusRecord> ParseRecords(ExecutionPolicy&& policy, const vector<string_view>& lines) {
+    vector<CorpusRecord> records(lines.size());
+    vector<char> is_valid(lines.size());
+    transform(policy,
+              lines.begin(), lines.end(),
+              records.begin(), is_valid.begin(),
+              [](string_view line, CorpusRecord& record) -> char { return ParseRecord(line, record); });
+
+    const auto it_invalid = find(is_valid.begin(), is_valid.end(), false);
+    if (it_invalid != is_valid.end()) {
+        throw invalid_argument("Некорректная запись корпуса номер "s + to_string(distance(is_valid.begin(), it_invalid)));
+    }
+    return records;
+}
+
+} // namespace
+
+vector<CorpusRecord> ParseCorpus(const execution::sequenced_policy&, string_view data, CorpusFormat format) {
+    vector<string_view> lines;
+    if (format == CorpusFormat::LENGTH_PREFIXED) {
+        lines = SplitLengthPrefixed(data);
+    } else {
+        SplitLines(data, lines);
+    }
+    return ParseRecords(execution::seq, lines);
+}
+
+vector<CorpusRecord> ParseCorpus(const execution::parallel_policy&, string_view data, CorpusFormat format) {
+    vector<string_view> lines;
+    if (format == CorpusFormat::LENGTH_PREFIXED) {
+        // заголовки длины позволяют перешагивать через записи, не читая их содержимое
+        lines = SplitLengthPrefixed(data);
+    } else {
+        const size_t chunk_count = max(1u, thread::hardware_concurrency()) * CORPUS_CHUNKS_PER_THREAD;
+        const vector<string_view> chunks = SplitIntoChunks(data, chunk_count);
+        vector<vector<string_view>> chunk_lines(chunks.size());
+        transform(execution::par,
+                  chunks.begin(), chunks.end(),
+                  chunk_lines.begin(),
+                  [](string_view chunk) {
+                      vector<string_view> result;
+                      SplitLines(chunk, result);
+                      return result;
+                  });
+        for (const vector<string_view>& current_lines : chunk_lines) {
+            lines.insert(lines.end(), current_lines.begin(), current_lines.end());
+        }
+    }
+    return ParseRecords(execution::par, lines);
+}
+
+vector<CorpusRecord> ParseCorpus(string_view data, CorpusFormat format) {
+    return ParseCorpus(execution::seq, data, format);
+}
+
+double IngestStats::MegabytesPerSecond() const {
+    if (seconds <= 0.0) {
+        return 0.0;
+    }
+    return bytes / (1024.0 * 1024.0) / seconds;
+}
+
+ostream& operator<<(ostream& out, const IngestStats& stats) {
+    out << "{ "s
+        << "documents = "s << stats.documents << ", "s
+        << "bytes = "s << stats.bytes << ", "s
+        << "seconds = "s << stats.seconds << ", "s
+        << "MB/s = "s << stats.MegabytesPerSecond() << " }"s;
+    return out;
+}
+
+IngestStats LoadCorpus(SearchServer& search_server, const MappedFile& file, CorpusFormat format) {
+    const auto start_time = chrono::steady_clock::now();
+
+    const vector<CorpusRecord> records = ParseCorpus(execution::par, file.Data(), format);
+    search_server.AddDocuments(execution::par, records);
+
+    const chrono::duration<double> duration = chrono::steady_clock::now() - start_time;
+    return {file.Data().size(), records.size(), duration.count()};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <cstddef>
+#include <execution>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Формат файла корпуса:
+// NEWLINE_DELIMITED - по одной записи на строку;
+// LENGTH_PREFIXED - перед каждой записью 4 байта длины (little-endian).
+// Поля записи разделены табуляцией: id, статус (число), оценки через пробел, текст документа
+enum class CorpusFormat {
+    NEWLINE_DELIMITED,
+    LENGTH_PREFIXED,
+};
+
+// Запись корпуса. Текст ссылается на отображённый в память файл и не копируется
+struct CorpusRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view Data() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+std::vector<CorpusRecord> ParseCorpus(const std::execution::sequenced_policy&, std::string_view data, CorpusFormat format);
+
+std::vector<CorpusRecord> ParseCorpus(const std::execution::parallel_policy&, std::string_view data, CorpusFormat format);
+
+std::vector<CorpusRecord> ParseCorpus(std::string_view data, CorpusFormat format);
+
+struct IngestStats {
+    size_t bytes = 0;
+    size_t documents = 0;
+    double seconds = 0.0;
+
+    double MegabytesPerSecond() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const IngestStats& stats);
+
+// Загружает корпус в сервер: записи разбираются и разбиваются на слова параллельно.
+// После загрузки файл можно закрыть - сервер хранит собственные копии слов
+IngestStats LoadCorpus(SearchServer& search_server, const MappedFile& file, CorpusFormat format);
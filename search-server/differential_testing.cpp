@@ -0,0 +1,563 @@
+#include "differential_testing.h"
+#include "corpus_reader.h"
+#include "document_filter.h"
+#include "process_queries.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int MAX_DOCUMENT_ID = 64;
+const int MAX_DOCUMENT_WORDS = 12;
+const int MAX_QUERY_WORDS = 5;
+const int RATING_RANGE_WIDTH = 8;
+// размер страницы при проверке постраничной выдачи
+const size_t CURSOR_PAGE_SIZE = 2;
+const string STOP_WORDS = "and in"s;
+const vector<string> VOCABULARY = {"and"s, "in"s, "cat"s, "dog"s, "curly"s, "tail"s, "fancy"s, "collar"s,
+                                   "big"s, "sparrow"s, "white"s, "grey"s};
+
+using Predicate = function<bool(int, DocumentStatus, int)>;
+
+// Эталон: документы хранятся как списки слов, каждый запрос перебирает их все
+class ReferenceSearchServer {
+public:
+    bool HasDocument(int document_id) const {
+        return documents_.count(document_id) > 0;
+    }
+
+    int GetDocumentCount() const {
+        return documents_.size();
+    }
+
+    void AddDocument(int document_id, string_view text, DocumentStatus status, int rating) {
+        ReferenceDocument& document = documents_[document_id];
+        document.status = status;
+        document.rating = rating;
+        for (string_view word : SplitIntoWordsView(text)) {
+            if (!IsStopWord(word)) {
+                document.words.emplace_back(word);
+            }
+        }
+    }
+
+    void RemoveDocument(int document_id) {
+        documents_.erase(document_id);
+    }
+
+    template <typename Scorer>
+    vector<Document> FindTopDocuments(string_view raw_query, const Predicate& predicate, bool all_words,
+                                      size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        const ReferenceQuery query = ParseQuery(raw_query, all_words);
+        int total_word_count = 0;
+        for (const auto& [document_id, document] : documents_) {
+            total_word_count += document.words.size();
+        }
+        const int document_count = documents_.size();
+        const CollectionStats stats{document_count, document_count == 0 ? 0.0 : total_word_count * 1.0 / document_count};
+
+        vector<Document> result;
+        for (const auto& [document_id, document] : documents_) {
+            if (!Matches(query, document) || !predicate(document_id, document.status, document.rating)) {
+                continue;
+            }
+            bool has_plus_word = false;
+            double relevance = 0.0;
+            for (const string& word : query.plus_words) {
+                const double term_freq = GetTermFreq(document, word);
+                if (term_freq > 0) {
+                    has_plus_word = true;
+                    relevance += Scorer::Score(term_freq, Scorer::TermWeight(stats, GetDocumentFreq(word)),
+                                               document.words.size(), stats);
+                }
+            }
+            if (has_plus_word) {
+                result.push_back({document_id, relevance, document.rating});
+            }
+        }
+
+        stable_sort(result.begin(), result.end(), [](const Document& lhs, const Document& rhs) {
+            if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+                return lhs.rating > rhs.rating;
+            }
+            return lhs.relevance > rhs.relevance;
+        });
+        if (result.size() > max_count) {
+            result.resize(max_count);
+        }
+        return result;
+    }
+
+    vector<string> MatchDocument(string_view raw_query, int document_id) const {
+        const ReferenceQuery query = ParseQuery(raw_query, false);
+        const ReferenceDocument& document = documents_.at(document_id);
+        vector<string> words;
+        if (!Matches(query, document)) {
+            return words;
+        }
+        for (const string& word : query.plus_words) {
+            if (GetTermFreq(document, word) > 0) {
+                words.push_back(word);
+            }
+        }
+        return words;
+    }
+
+    map<string, double> GetWordFrequencies(int document_id) const {
+        map<string, double> result;
+        const ReferenceDocument& document = documents_.at(document_id);
+        for (const string& word : document.words) {
+            result[word] += 1.0 / document.words.size();
+        }
+        return result;
+    }
+
+private:
+    struct ReferenceDocument {
+        vector<string> words;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        int rating = 0;
+    };
+
+    struct ReferenceQuery {
+        set<string> plus_words;
+        set<string> minus_words;
+        set<string> required_words;
+    };
+
+    map<int, ReferenceDocument> documents_;
+
+    static bool IsStopWord(string_view word) {
+        return word == "and"sv || word == "in"sv;
+    }
+
+    ReferenceQuery ParseQuery(string_view raw_query, bool all_words) const {
+        ReferenceQuery query;
+        for (string_view word : SplitIntoWordsView(raw_query)) {
+            const char prefix = word[0];
+            if (prefix == '-' || prefix == '+') {
+                word.remove_prefix(1);
+            }
+            if (IsStopWord(word)) {
+                continue;
+            }
+            if (const auto pattern = ParsePattern(word)) {
+                set<string>& words = prefix == '-' ? query.minus_words : query.plus_words;
+                for (const string& expansion : ExpandPattern(pattern->first, pattern->second)) {
+                    words.insert(expansion);
+                }
+                continue;
+            }
+            if (prefix == '-') {
+                query.minus_words.emplace(word);
+                continue;
+            }
+            query.plus_words.emplace(word);
+            if (prefix == '+' || all_words) {
+                query.required_words.emplace(word);
+            }
+        }
+        return query;
+    }
+
+    // Основа шаблона и допустимое расстояние; -1 для шаблона слово*
+    static optional<pair<string, int>> ParsePattern(string_view word) {
+        if (word.back() == '*') {
+            return pair{string(word.substr(0, word.size() - 1)), -1};
+        }
+        if (word.size() > 2 && word[word.size() - 2] == '~') {
+            return pair{string(word.substr(0, word.size() - 2)), word.back() - '0'};
+        }
+        return nullopt;
+    }
+
+    static vector<char32_t> GetLetters(const string& word) {
+        vector<Utf8Letter> letters;
+        DecodeUtf8(word, letters);
+        vector<char32_t> code_points;
+        for (const Utf8Letter& letter : letters) {
+            code_points.push_back(letter.code_point);
+        }
+        return code_points;
+    }
+
+    static int GetEditDistance(const string& lhs_word, const string& rhs_word) {
+        const vector<char32_t> lhs = GetLetters(lhs_word);
+        const vector<char32_t> rhs = GetLetters(rhs_word);
+        vector<vector<int>> distance(lhs.size() + 1, vector<int>(rhs.size() + 1));
+        for (size_t i = 0; i <= lhs.size(); ++i) {
+            for (size_t j = 0; j <= rhs.size(); ++j) {
+                if (i == 0 || j == 0) {
+                    distance[i][j] = i + j;
+                } else {
+                    distance[i][j] = min({distance[i - 1][j] + 1, distance[i][j - 1] + 1,
+                                          distance[i - 1][j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+                }
+            }
+        }
+        return distance[lhs.size()][rhs.size()];
+    }
+
+    // Не больше MAX_PATTERN_EXPANSIONS ближайших к основе слов, при равном расстоянии - самых частых
+    vector<string> ExpandPattern(const string& base, int max_edits) const {
+        set<string> words;
+        for (const auto& [document_id, document] : documents_) {
+            words.insert(document.words.begin(), document.words.end());
+        }
+        // расстояние, минус число документов и слово
+        vector<tuple<int, int, string>> matches;
+        for (const string& word : words) {
+            const int edits = max_edits < 0 ? static_cast<int>(GetLetters(word).size() - GetLetters(base).size())
+                                            : GetEditDistance(word, base);
+            const bool is_matched = max_edits < 0 ? word.substr(0, base.size()) == base : edits <= max_edits;
+            if (is_matched) {
+                matches.emplace_back(edits, -static_cast<int>(GetDocumentFreq(word)), word);
+            }
+        }
+        sort(matches.begin(), matches.end());
+        vector<string> expansions;
+        for (size_t i = 0; i < matches.size() && i < static_cast<size_t>(MAX_PATTERN_EXPANSIONS); ++i) {
+            expansions.push_back(get<2>(matches[i]));
+        }
+        return expansions;
+    }
+
+    static double GetTermFreq(const ReferenceDocument& document, const string& word) {
+        double term_freq = 0.0;
+        for (const string& document_word : document.words) {
+            if (document_word == word) {
+                term_freq += 1.0 / document.words.size();
+            }
+        }
+        return term_freq;
+    }
+
+    size_t GetDocumentFreq(const string& word) const {
+        return count_if(documents_.begin(), documents_.end(), [&word](const auto& document) {
+            return GetTermFreq(document.second, word) > 0;
+        });
+    }
+
+    static bool Matches(const ReferenceQuery& query, const ReferenceDocument& document) {
+        const auto contains = [&document](const string& word) { return GetTermFreq(document, word) > 0; };
+        return none_of(query.minus_words.begin(), query.minus_words.end(), contains)
+               && all_of(query.required_words.begin(), query.required_words.end(), contains);
+    }
+};
+
+class ScenarioReader {
+public:
+    explicit ScenarioReader(string_view scenario)
+            : scenario_(scenario) {
+    }
+
+    bool Empty() const {
+        return scenario_.empty();
+    }
+
+    // Следующее число из [0, bound); за концом сценария - нули
+    int Next(int bound) {
+        if (scenario_.empty()) {
+            return 0;
+        }
+        const int value = static_cast<unsigned char>(scenario_.front()) % bound;
+        scenario_.remove_prefix(1);
+        return value;
+    }
+
+private:
+    string_view scenario_;
+};
+
+void Check(bool condition, const string& message) {
+    if (!condition) {
+        throw logic_error(message);
+    }
+}
+
+void CheckDocuments(const vector<Document>& actual, const vector<Document>& expected, const string& context) {
+    Check(actual.size() == expected.size(), "Разное число найденных документов: "s + context);
+    for (size_t i = 0; i < actual.size(); ++i) {
+        Check(actual[i].id == expected[i].id && actual[i].rating == expected[i].rating,
+              "Разные документы на позиции "s + to_string(i) + ": "s + context);
+        Check(abs(actual[i].relevance - expected[i].relevance) < EPSILON,
+              "Разная релевантность документа "s + to_string(actual[i].id) + ": "s + context);
+    }
+}
+
+string ReadText(ScenarioReader& reader, int max_word_count, bool is_query) {
+    string text;
+    const int word_count = reader.Next(max_word_count + 1);
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        const string& word = VOCABULARY[reader.Next(VOCABULARY.size())];
+        if (!is_query) {
+            text += word;
+            continue;
+        }
+        const int prefix = reader.Next(6);
+        if (prefix == 0) {
+            text.push_back('-');
+        } else if (prefix == 1) {
+            text.push_back('+');
+        }
+        // шаблоны не могут быть обязательными словами
+        const int pattern = prefix == 1 ? 0 : reader.Next(8);
+        if (pattern == 1) {
+            text += word.substr(0, 1 + reader.Next(word.size())) + "*"s;
+        } else if (pattern == 2 || pattern == 3) {
+            // основа нечёткого шаблона может быть с опечаткой
+            string base = word;
+            base[reader.Next(base.size())] = 'a' + reader.Next(26);
+            text += base + "~"s + to_string(pattern - 1);
+        } else {
+            text += word;
+        }
+    }
+    return text;
+}
+
+void CheckAddDocument(SearchServer& search_server, ReferenceSearchServer& reference, ScenarioReader& reader) {
+    const int document_id = reader.Next(MAX_DOCUMENT_ID);
+    const auto status = static_cast<DocumentStatus>(reader.Next(DOCUMENT_STATUS_COUNT));
+    const bool is_batch = reader.Next(2) == 1;
+    const string text = ReadText(reader, MAX_DOCUMENT_WORDS, false);
+    // рейтинг совпадает с id, поэтому порядок документов с равной релевантностью однозначен
+    const vector<int> ratings = {document_id};
+
+    bool is_added = true;
+    try {
+        if (is_batch) {
+            search_server.AddDocuments(execution::par, vector<CorpusRecord>{{document_id, status, ratings, text}});
+        } else {
+            search_server.AddDocument(document_id, text, status, ratings);
+        }
+    } catch (const invalid_argument&) {
+        is_added = false;
+    }
+    Check(is_added != reference.HasDocument(document_id), "Добавление документа "s + to_string(document_id));
+    if (is_added) {
+        reference.AddDocument(document_id, text, status, document_id);
+    }
+}
+
+void CheckRemoveDocument(SearchServer& search_server, ReferenceSearchServer& reference, ScenarioReader& reader) {
+    const int document_id = reader.Next(MAX_DOCUMENT_ID);
+    const bool is_parallel = reader.Next(2) == 1;
+    bool is_removed = true;
+    try {
+        if (is_parallel) {
+            search_server.RemoveDocument(execution::par, document_id);
+        } else {
+            search_server.RemoveDocument(execution::seq, document_id);
+        }
+    } catch (const out_of_range&) {
+        is_removed = false;
+    }
+    Check(is_removed == reference.HasDocument(document_id), "Удаление документа "s + to_string(document_id));
+    reference.RemoveDocument(document_id);
+}
+
+// Замороженные копии сервера: без вкладов и с вкладами каждой точности. Копии строятся
+// через снимок при первом поиске после изменения индекса
+class FrozenReplicas {
+public:
+    static constexpr ImpactPrecision PRECISIONS[] = {ImpactPrecision::NONE, ImpactPrecision::BITS_8, ImpactPrecision::BITS_16};
+    static constexpr const char* PRECISION_NAMES[] = {"exact", "8 bit", "16 bit"};
+
+    void Invalidate() {
+        replicas_.clear();
+    }
+
+    const vector<unique_ptr<SearchServer>>& Get(const SearchServer& search_server) {
+        if (replicas_.empty()) {
+            ByteWriter snapshot;
+            search_server.SaveSnapshot(snapshot);
+            for (const ImpactPrecision precision : PRECISIONS) {
+                ByteReader reader(snapshot.Data());
+                replicas_.push_back(make_unique<SearchServer>(SearchServer::LoadSnapshot(reader)));
+                replicas_.back()->Freeze(FreezeOptions{false, precision});
+            }
+        }
+        return replicas_;
+    }
+
+private:
+    vector<unique_ptr<SearchServer>> replicas_;
+};
+
+// Все страницы FindTopDocumentsAfter подряд
+vector<Document> CollectPages(const SearchServer& search_server, const SearchServer::PreparedQuery& prepared_query,
+                              DocumentStatus status) {
+    vector<Document> documents;
+    optional<Document> after;
+    while (true) {
+        const vector<Document> page = search_server.FindTopDocumentsAfter(prepared_query, after, CURSOR_PAGE_SIZE, status);
+        documents.insert(documents.end(), page.begin(), page.end());
+        if (page.size() < CURSOR_PAGE_SIZE) {
+            return documents;
+        }
+        after = page.back();
+    }
+}
+
+void CheckFindTopDocuments(const SearchServer& search_server, FrozenReplicas& frozen_replicas,
+                           const ReferenceSearchServer& reference, ScenarioReader& reader) {
+    const string query = ReadText(reader, MAX_QUERY_WORDS, true);
+    const auto status = static_cast<DocumentStatus>(reader.Next(DOCUMENT_STATUS_COUNT));
+    const int min_rating = reader.Next(MAX_DOCUMENT_ID);
+    const string context = "запрос \""s + query + "\""s;
+
+    const Predicate is_actual = [](int, DocumentStatus document_status, int) { return document_status == DocumentStatus::ACTUAL; };
+    const Predicate has_status = [status](int, DocumentStatus document_status, int) { return document_status == status; };
+    const Predicate is_even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    const Predicate in_filter = [min_rating](int, DocumentStatus document_status, int rating) {
+        return (document_status == DocumentStatus::ACTUAL || document_status == DocumentStatus::BANNED)
+               && min_rating <= rating && rating <= min_rating + RATING_RANGE_WIDTH;
+    };
+    const DocumentFilter filter = DocumentFilter()
+            .AddStatus(DocumentStatus::ACTUAL)
+            .AddStatus(DocumentStatus::BANNED)
+            .SetRatingRange(min_rating, min_rating + RATING_RANGE_WIDTH);
+
+    const vector<Document> expected = reference.FindTopDocuments<TfIdfScorer>(query, is_actual, false);
+    CheckDocuments(search_server.FindTopDocuments(query), expected, context);
+    CheckDocuments(search_server.FindTopDocuments(execution::seq, query), expected, context + " seq"s);
+    CheckDocuments(search_server.FindTopDocuments(execution::par, query), expected, context + " par"s);
+    CheckDocuments(search_server.FindTopDocumentsBatch({query})[0], expected, context + " batch"s);
+    CheckDocuments(ProcessQueries(search_server, {query})[0], expected, context + " ProcessQueries"s);
+
+    const auto prepared_query = search_server.PrepareQuery(query);
+    const vector<Document> expected_status = reference.FindTopDocuments<TfIdfScorer>(query, has_status, false);
+    CheckDocuments(search_server.FindTopDocuments(execution::seq, query, status), expected_status, context + " seq status"s);
+    CheckDocuments(search_server.FindTopDocuments(execution::par, query, status), expected_status, context + " par status"s);
+    CheckDocuments(search_server.FindTopDocuments(prepared_query, status), expected_status, context + " prepared"s);
+
+    const vector<Document> expected_even = reference.FindTopDocuments<TfIdfScorer>(query, is_even, false);
+    CheckDocuments(search_server.FindTopDocuments(execution::seq, query, is_even), expected_even, context + " seq predicate"s);
+    CheckDocuments(search_server.FindTopDocuments(execution::par, query, is_even), expected_even, context + " par predicate"s);
+
+    const vector<Document> expected_filter = reference.FindTopDocuments<TfIdfScorer>(query, in_filter, false);
+    CheckDocuments(search_server.FindTopDocuments(execution::seq, query, filter), expected_filter, context + " seq filter"s);
+    CheckDocuments(search_server.FindTopDocuments(execution::par, query, filter), expected_filter, context + " par filter"s);
+
+    const vector<Document> expected_all_words = reference.FindTopDocuments<TfIdfScorer>(query, has_status, true);
+    CheckDocuments(search_server.FindTopDocuments(execution::seq, query, status, QueryMode::ALL_WORDS),
+                   expected_all_words, context + " seq all words"s);
+    CheckDocuments(search_server.FindTopDocuments(execution::par, query, status, QueryMode::ALL_WORDS),
+                   expected_all_words, context + " par all words"s);
+
+    CheckDocuments(search_server.FindTopDocuments<Bm25Scorer>(execution::seq, query, is_even),
+                   reference.FindTopDocuments<Bm25Scorer>(query, is_even, false), context + " bm25"s);
+
+    CheckDocuments(search_server.FindTopDocumentsPlanned(prepared_query, status), expected_status, context + " planned"s);
+    CheckDocuments(search_server.FindTopDocumentsPlanned(prepared_query, is_even), expected_even, context + " planned predicate"s);
+    CheckDocuments(search_server.FindTopDocumentsPlanned(prepared_query, filter), expected_filter, context + " planned filter"s);
+    CheckDocuments(CollectPages(search_server, prepared_query, status),
+                   reference.FindTopDocuments<TfIdfScorer>(query, has_status, false, numeric_limits<size_t>::max()),
+                   context + " cursor"s);
+
+    // квантованные вклады применяются только к поиску TF-IDF по статусу
+    const vector<unique_ptr<SearchServer>>& replicas = frozen_replicas.Get(search_server);
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        const unique_ptr<SearchServer>& replica = replicas[i];
+        const string frozen_context = context + " frozen "s + FrozenReplicas::PRECISION_NAMES[i] + " "s;
+        const auto frozen_query = replica->PrepareQuery(query);
+        CheckDocuments(replica->FindTopDocuments(query), expected, frozen_context + "default"s);
+        CheckDocuments(replica->FindTopDocuments(execution::par, query, status), expected_status, frozen_context + "par status"s);
+        CheckDocuments(replica->FindTopDocuments(frozen_query, status), expected_status, frozen_context + "prepared"s);
+        CheckDocuments(replica->FindTopDocuments(execution::seq, query, filter), expected_filter, frozen_context + "filter"s);
+        CheckDocuments(replica->FindTopDocumentsPlanned(frozen_query, status), expected_status, frozen_context + "planned"s);
+    }
+}
+
+void CheckMatchDocument(const SearchServer& search_server, const ReferenceSearchServer& reference, ScenarioReader& reader) {
+    const int document_id = reader.Next(MAX_DOCUMENT_ID);
+    const string query = ReadText(reader, MAX_QUERY_WORDS, true);
+    const string context = "документ "s + to_string(document_id) + ", запрос \""s + query + "\""s;
+
+    if (!reference.HasDocument(document_id)) {
+        for (const bool is_parallel : {false, true}) {
+            bool is_thrown = false;
+            try {
+                if (is_parallel) {
+                    search_server.MatchDocument(execution::par, query, document_id);
+                } else {
+                    search_server.MatchDocument(execution::seq, query, document_id);
+                }
+            } catch (const out_of_range&) {
+                is_thrown = true;
+            }
+            Check(is_thrown, "Нет исключения для отсутствующего документа: "s + context);
+        }
+        Check(search_server.GetWordFrequencies(document_id).empty(), "Частоты отсутствующего документа: "s + context);
+        return;
+    }
+
+    const vector<string> expected = reference.MatchDocument(query, document_id);
+    const auto check_words = [&expected, &context](const vector<string_view>& words, const string& method) {
+        Check(vector<string>(words.begin(), words.end()) == expected, "Разные слова MatchDocument "s + method + ": "s + context);
+    };
+    check_words(get<0>(search_server.MatchDocument(execution::seq, query, document_id)), "seq"s);
+    check_words(get<0>(search_server.MatchDocument(execution::par, query, document_id)), "par"s);
+    check_words(get<0>(search_server.MatchDocument(search_server.PrepareQuery(query), document_id)), "prepared"s);
+
+    const map<string_view, double> frequencies = search_server.GetWordFrequencies(document_id);
+    const map<string, double> expected_frequencies = reference.GetWordFrequencies(document_id);
+    Check(frequencies.size() == expected_frequencies.size(), "Разные слова GetWordFrequencies: "s + context);
+    for (const auto& [word, freq] : expected_frequencies) {
+        const auto it = frequencies.find(word);
+        Check(it != frequencies.end() && abs(it->second - freq) < EPSILON, "Разная частота слова "s + word + ": "s + context);
+    }
+}
+
+} // namespace
+
+void RunDifferentialScenario(string_view scenario) {
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearchServer reference;
+    FrozenReplicas frozen_replicas;
+    ScenarioReader reader(scenario);
+    while (!reader.Empty()) {
+        switch (reader.Next(4)) {
+            case 0:
+                CheckAddDocument(search_server, reference, reader);
+                frozen_replicas.Invalidate();
+                break;
+            case 1:
+                CheckRemoveDocument(search_server, reference, reader);
+                frozen_replicas.Invalidate();
+                break;
+            case 2:
+                CheckFindTopDocuments(search_server, frozen_replicas, reference, reader);
+                break;
+            default:
+                CheckMatchDocument(search_server, reference, reader);
+                break;
+        }
+        Check(search_server.GetDocumentCount() == reference.GetDocumentCount(), "Разное число документов"s);
+    }
+}
+
+string GenerateDifferentialScenario(mt19937& generator, size_t length) {
+    string scenario(length, '\0');
+    for (char& c : scenario) {
+        c = static_cast<char>(uniform_int_distribution<int>(0, 255)(generator));
+    }
+    return scenario;
+}
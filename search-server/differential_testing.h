@@ -0,0 +1,14 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <string_view>
+
+// Дифференциальная проверка SearchServer. Байты сценария задают последовательность операций
+// (добавление и удаление документов, поиск, сопоставление с запросом), которые выполняются
+// над SearchServer всеми политиками и способами поиска и над простой эталонной реализацией,
+// перебирающей все документы. Любой набор байтов - допустимый сценарий, поэтому функцию
+// можно вызывать из фаззера. При расхождении бросает std::logic_error с описанием
+void RunDifferentialScenario(std::string_view scenario);
+
+std::string GenerateDifferentialScenario(std::mt19937& generator, size_t length);
@@ -23,4 +23,6 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const int DOCUMENT_STATUS_COUNT = 4;
+
 void PrintMatchDocumentResult(int document_id, const std::vector<std::string_view>& words, DocumentStatus status);
@@ -0,0 +1,64 @@
+#include "document_filter.h"
+
+#include <stdexcept>
+#include <utility>
+#include <string>
+
+using namespace std;
+
+DocumentFilter& DocumentFilter::AddStatus(DocumentStatus status) {
+    if (status_mask_ == ALL_STATUSES) {
+        status_mask_ = 0;
+    }
+    status_mask_ |= 1u << static_cast<int>(status);
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetRatingRange(int min_rating, int max_rating) {
+    if (min_rating > max_rating) {
+        throw invalid_argument("Пустой диапазон рейтинга в фильтре документов"s);
+    }
+    min_rating_ = min_rating;
+    max_rating_ = max_rating;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetAllowedDocuments(shared_ptr<const RoaringBitmap> documents) {
+    if (!documents) {
+        throw invalid_argument("Пустой указатель на множество документов в фильтре"s);
+    }
+    allowed_documents_ = move(documents);
+    return *this;
+}
+
+bool DocumentFilter::HasStatus(DocumentStatus status) const {
+    return status_mask_ & (1u << static_cast<int>(status));
+}
+
+bool DocumentFilter::HasRating(int rating) const {
+    return min_rating_ <= rating && rating <= max_rating_;
+}
+
+bool DocumentFilter::HasRatingRange() const {
+    return min_rating_ != numeric_limits<int>::min() || max_rating_ != numeric_limits<int>::max();
+}
+
+bool DocumentFilter::HasDocument(int document_id) const {
+    return !allowed_documents_ || allowed_documents_->Contains(document_id);
+}
+
+const RoaringBitmap* DocumentFilter::GetAllowedDocuments() const {
+    return allowed_documents_.get();
+}
+
+int DocumentFilter::GetMinRating() const {
+    return min_rating_;
+}
+
+int DocumentFilter::GetMaxRating() const {
+    return max_rating_;
+}
+
+bool DocumentFilter::operator()(int document_id, DocumentStatus status, int rating) const {
+    return HasStatus(status) && HasRating(rating) && HasDocument(document_id);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "document.h"
+#include "roaring_bitmap.h"
+
+#include <limits>
+#include <memory>
+
+// Типизированный фильтр документов: набор статусов и диапазон рейтинга.
+// В отличие от произвольного предиката, его условия видны поисковому серверу,
+// поэтому поиск обходит только списки выбранных статусов, а узкий диапазон
+// рейтинга проверяется по индексу рейтингов без обхода списков документов. Готовое
+// множество допустимых документов заменяет предикат по id: небольшое множество
+// пересекается с документами выбранных статусов вместо обхода списков
+class DocumentFilter {
+public:
+    // Фильтр без ограничений: любой статус, любой рейтинг
+    DocumentFilter() = default;
+
+    // Добавляет статус в набор допустимых; первый вызов отменяет «любой статус»
+    DocumentFilter& AddStatus(DocumentStatus status);
+
+    // Рейтинг документа должен лежать в отрезке [min_rating, max_rating]
+    DocumentFilter& SetRatingRange(int min_rating, int max_rating);
+
+    // Допустимы только документы из множества; фильтр разделяет владение множеством
+    DocumentFilter& SetAllowedDocuments(std::shared_ptr<const RoaringBitmap> documents);
+
+    bool HasStatus(DocumentStatus status) const;
+
+    bool HasRating(int rating) const;
+
+    bool HasRatingRange() const;
+
+    bool HasDocument(int document_id) const;
+
+    // Множество допустимых документов или nullptr, если оно не задано
+    const RoaringBitmap* GetAllowedDocuments() const;
+
+    int GetMinRating() const;
+
+    int GetMaxRating() const;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const;
+
+private:
+    static const unsigned ALL_STATUSES = (1u << DOCUMENT_STATUS_COUNT) - 1;
+
+    unsigned status_mask_ = ALL_STATUSES;
+    int min_rating_ = std::numeric_limits<int>::min();
+    int max_rating_ = std::numeric_limits<int>::max();
+    std::shared_ptr<const RoaringBitmap> allowed_documents_;
+};
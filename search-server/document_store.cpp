@@ -0,0 +1,207 @@
+#include "document_store.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const size_t MIN_MATCH_LENGTH = 4;
+const int MATCH_HASH_BITS = 12;
+
+void WriteVarint(string& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+size_t ReadVarint(string_view& in) {
+    size_t value = 0;
+    int shift = 0;
+    while (!in.empty()) {
+        const auto byte = static_cast<unsigned char>(in.front());
+        in.remove_prefix(1);
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+        shift += 7;
+    }
+    throw invalid_argument("Повреждённый блок хранилища документов"s);
+}
+
+uint32_t HashSequence(const char* data) {
+    uint32_t sequence;
+    memcpy(&sequence, data, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - MATCH_HASH_BITS);
+}
+
+} // namespace
+
+// Блок - последовательность команд: длина литерала, байты литерала, затем,
+// если блок не закончился, длина повтора минус MIN_MATCH_LENGTH и расстояние до его начала
+string CompressBlock(string_view data) {
+    string result;
+    result.reserve(data.size() / 2 + 16);
+    // последняя позиция каждой четвёрки байт по её хешу
+    array<size_t, 1 << MATCH_HASH_BITS> last_positions;
+    last_positions.fill(data.size());
+
+    size_t literal_start = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH_LENGTH <= data.size()) {
+        const uint32_t hash = HashSequence(data.data() + position);
+        const size_t candidate = last_positions[hash];
+        last_positions[hash] = position;
+        if (candidate >= position || memcmp(data.data() + candidate, data.data() + position, MIN_MATCH_LENGTH) != 0) {
+            ++position;
+            continue;
+        }
+        size_t length = MIN_MATCH_LENGTH;
+        while (position + length < data.size() && data[candidate + length] == data[position + length]) {
+            ++length;
+        }
+        WriteVarint(result, position - literal_start);
+        result.append(data.substr(literal_start, position - literal_start));
+        WriteVarint(result, length - MIN_MATCH_LENGTH);
+        WriteVarint(result, position - candidate);
+        position += length;
+        literal_start = position;
+    }
+    WriteVarint(result, data.size() - literal_start);
+    result.append(data.substr(literal_start));
+    result.shrink_to_fit();
+    return result;
+}
+
+string DecompressBlock(string_view compressed, size_t prefix_size) {
+    string result;
+    result.reserve(prefix_size);
+    while (result.size() < prefix_size && !compressed.empty()) {
+        const size_t literal_length = ReadVarint(compressed);
+        if (literal_length > compressed.size()) {
+            throw invalid_argument("Повреждённый блок хранилища документов"s);
+        }
+        result.append(compressed.substr(0, literal_length));
+        compressed.remove_prefix(literal_length);
+        if (compressed.empty()) {
+            break;
+        }
+        const size_t length = ReadVarint(compressed) + MIN_MATCH_LENGTH;
+        const size_t distance = ReadVarint(compressed);
+        if (distance == 0 || distance > result.size()) {
+            throw invalid_argument("Повреждённый блок хранилища документов"s);
+        }
+        // повтор может перекрываться с самим собой, поэтому копируется побайтово
+        const size_t start = result.size() - distance;
+        for (size_t i = 0; i < length; ++i) {
+            result.push_back(result[start + i]);
+        }
+    }
+    result.resize(min(result.size(), prefix_size));
+    return result;
+}
+
+void DocumentStore::Add(int document_id, string_view text) {
+    if (!open_block_.empty() && open_block_.size() + text.size() > DOCUMENT_STORE_BLOCK_SIZE) {
+        CloseBlock();
+    }
+    locations_[document_id] = {static_cast<uint32_t>(blocks_.size()), static_cast<uint32_t>(open_block_.size()),
+                               static_cast<uint32_t>(text.size())};
+    open_block_.append(text);
+    text_bytes_ += text.size();
+}
+
+void DocumentStore::Erase(int document_id) {
+    const auto it = locations_.find(document_id);
+    if (it != locations_.end()) {
+        text_bytes_ -= it->second.size;
+        locations_.erase(it);
+    }
+}
+
+bool DocumentStore::Contains(int document_id) const {
+    return locations_.count(document_id) > 0;
+}
+
+string DocumentStore::Get(int document_id) const {
+    const auto it = locations_.find(document_id);
+    if (it == locations_.end()) {
+        return {};
+    }
+    const auto [block, offset, size] = it->second;
+    if (block == blocks_.size()) {
+        return open_block_.substr(offset, size);
+    }
+    return DecompressBlock(blocks_[block], offset + size).substr(offset);
+}
+
+size_t DocumentStore::GetTextBytes() const {
+    return text_bytes_;
+}
+
+size_t DocumentStore::GetMemoryBytes() const {
+    size_t result = blocks_.capacity() * sizeof(string) + StringHeapBytes(open_block_)
+                    + locations_.size() * TreeNodeBytes<pair<const int, Location>>();
+    for (const string& block : blocks_) {
+        result += StringHeapBytes(block);
+    }
+    return result;
+}
+
+size_t DocumentStore::GetStoredBytes() const {
+    size_t result = open_block_.size();
+    for (const string& block : blocks_) {
+        result += block.size();
+    }
+    return result;
+}
+
+void DocumentStore::Save(ByteWriter& out) const {
+    out.WriteVarint(blocks_.size());
+    for (const string& block : blocks_) {
+        out.WriteString(block);
+    }
+    out.WriteString(open_block_);
+    out.WriteVarint(locations_.size());
+    for (const auto& [document_id, location] : locations_) {
+        out.WriteInt(document_id);
+        out.WriteVarint(location.block);
+        out.WriteVarint(location.offset);
+        out.WriteVarint(location.size);
+    }
+}
+
+DocumentStore DocumentStore::Load(ByteReader& in) {
+    DocumentStore store;
+    store.blocks_.resize(in.ReadVarint());
+    for (string& block : store.blocks_) {
+        block = in.ReadString();
+    }
+    store.open_block_ = in.ReadString();
+    const size_t location_count = in.ReadVarint();
+    for (size_t i = 0; i < location_count; ++i) {
+        const int document_id = in.ReadInt();
+        Location location{};
+        location.block = in.ReadVarint();
+        location.offset = in.ReadVarint();
+        location.size = in.ReadVarint();
+        if (location.block > store.blocks_.size()) {
+            throw invalid_argument("Некорректный номер блока хранилища документов"s);
+        }
+        store.locations_[document_id] = location;
+        store.text_bytes_ += location.size;
+    }
+    return store;
+}
+
+void DocumentStore::CloseBlock() {
+    blocks_.push_back(CompressBlock(open_block_));
+    open_block_.clear();
+}
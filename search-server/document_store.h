@@ -0,0 +1,62 @@
+#pragma once
+
+#include "binary_io.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Несжатый размер блока хранилища. Чтение документа раскодирует блок только до конца
+// документа, поэтому размер блока ограничивает стоимость чтения
+const size_t DOCUMENT_STORE_BLOCK_SIZE = 16 * 1024;
+
+// Тексты документов, сжатые блоками. Документы дописываются в открытый блок, заполненный
+// блок сжимается (LZ77: повторы заменяются ссылками на предыдущие байты блока) и больше
+// не меняется. Удалённый документ перестаёт быть доступен, но место в блоке не освобождается
+class DocumentStore {
+public:
+    void Add(int document_id, std::string_view text);
+
+    void Erase(int document_id);
+
+    bool Contains(int document_id) const;
+
+    // Текст документа; пустая строка для неизвестного id
+    std::string Get(int document_id) const;
+
+    // Суммарный размер текстов и размер, который они занимают в хранилище
+    size_t GetTextBytes() const;
+
+    size_t GetStoredBytes() const;
+
+    // Память хранилища вместе с ёмкостью строк блоков и таблицей расположения документов
+    size_t GetMemoryBytes() const;
+
+    // Запись в снимок индекса и чтение из него
+    void Save(ByteWriter& out) const;
+
+    static DocumentStore Load(ByteReader& in);
+
+private:
+    struct Location {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::vector<std::string> blocks_;
+    // несжатый блок, в который дописываются документы; его номер - blocks_.size()
+    std::string open_block_;
+    std::map<int, Location> locations_;
+    size_t text_bytes_ = 0;
+
+    void CloseBlock();
+};
+
+// Сжатие блока и раскодирование его первых prefix_size байт
+std::string CompressBlock(std::string_view data);
+
+std::string DecompressBlock(std::string_view compressed, size_t prefix_size);
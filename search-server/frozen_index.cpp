@@ -0,0 +1,242 @@
+#include "frozen_index.h"
+#include "scorers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t GetImpactSize(ImpactPrecision precision) {
+    switch (precision) {
+        case ImpactPrecision::BITS_8:
+            return sizeof(uint8_t);
+        case ImpactPrecision::BITS_16:
+            return sizeof(uint16_t);
+        default:
+            return 0;
+    }
+}
+
+} // namespace
+
+FrozenArena::FrozenArena(size_t capacity, bool use_huge_pages) {
+    // страницы по 2 МБ имеют смысл, только если блок занимает хотя бы одну такую страницу
+    const size_t alignment = use_huge_pages && capacity >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : CACHE_LINE_SIZE;
+    capacity_ = AlignUp(max<size_t>(capacity, 1), alignment);
+    data_ = static_cast<char*>(aligned_alloc(alignment, capacity_));
+    if (data_ == nullptr) {
+        throw bad_alloc();
+    }
+    if (alignment == HUGE_PAGE_SIZE) {
+        // ядро может отказать (например, если прозрачные huge pages отключены) - тогда блок остаётся на обычных страницах
+        uses_huge_pages_ = madvise(data_, capacity_, MADV_HUGEPAGE) == 0;
+    }
+}
+
+FrozenArena::~FrozenArena() {
+    free(data_);
+}
+
+bool FrozenArena::UsesHugePages() const {
+    return uses_huge_pages_;
+}
+
+size_t FrozenArena::GetAllocatedBytes() const {
+    return capacity_ + overflow_bytes_;
+}
+
+void* FrozenArena::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes >= CACHE_LINE_SIZE) {
+        alignment = max(alignment, CACHE_LINE_SIZE);
+    }
+    const size_t offset = AlignUp(used_, alignment);
+    if (offset + bytes > capacity_) {
+        overflow_bytes_ += bytes;
+        return overflow_.allocate(bytes, alignment);
+    }
+    used_ = offset + bytes;
+    return data_ + offset;
+}
+
+void FrozenArena::do_deallocate(void*, size_t, size_t) {
+    // память освобождается вся сразу вместе с ареной
+}
+
+bool FrozenArena::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+FrozenIndex::FrozenIndex(size_t term_count, size_t posting_list_count, size_t posting_count, size_t document_count,
+                         bool use_huge_pages, ImpactPrecision impact_precision)
+        // каждый массив может начинаться с границы строки кэша, отсюда запас в строку на массив
+        // с вкладами списки не хранят tf, зато у документов есть ссылка на прямой индекс
+        : arena_(term_count * (sizeof(string_view) + sizeof(int) + sizeof(StatusPostings))
+                 + posting_count * sizeof(int)
+                 + document_count * (3 * sizeof(int) + sizeof(DocumentStatus) + sizeof(uint32_t))
+                 + (posting_list_count + 8) * CACHE_LINE_SIZE
+                 + (impact_precision == ImpactPrecision::NONE
+                    ? posting_count * sizeof(double) + posting_list_count * CACHE_LINE_SIZE
+                    : document_count * sizeof(pair<const TermFrequency*, const TermFrequency*>)
+                      + 2 * (term_count * DOCUMENT_STATUS_COUNT + 1) * sizeof(size_t)
+                      + posting_count * (sizeof(uint32_t) + GetImpactSize(impact_precision))
+                      + (posting_count / IMPACT_BLOCK_SIZE + posting_list_count) * sizeof(uint16_t)
+                      + 6 * CACHE_LINE_SIZE),
+                 use_huge_pages)
+        , impact_precision_(impact_precision) {
+    terms_.reserve(term_count);
+    term_ids_.reserve(term_count);
+    postings_.reserve(term_count);
+    document_ids_.reserve(document_count);
+    ratings_.reserve(document_count);
+    statuses_.reserve(document_count);
+    word_counts_.reserve(document_count);
+    rating_order_.reserve(document_count);
+    if (impact_precision_ != ImpactPrecision::NONE) {
+        forward_index_.reserve(document_count);
+    }
+}
+
+void FrozenIndex::AddTerm(string_view word, int term_id, const StatusPostings& postings) {
+    terms_.push_back(word);
+    term_ids_.push_back(term_id);
+    if (impact_precision_ == ImpactPrecision::NONE) {
+        postings_.emplace_back(postings, &arena_);
+    } else {
+        postings_.emplace_back(postings, &arena_, this, term_id);
+    }
+}
+
+void FrozenIndex::AddDocument(int document_id, const DocumentAttributes& attributes, const vector<TermFrequency>& word_freqs) {
+    document_ids_.push_back(document_id);
+    ratings_.push_back(attributes.rating);
+    statuses_.push_back(attributes.status);
+    word_counts_.push_back(attributes.word_count);
+    if (impact_precision_ != ImpactPrecision::NONE) {
+        forward_index_.emplace_back(word_freqs.data(), word_freqs.data() + word_freqs.size());
+    }
+}
+
+const TermFrequency* FrozenIndex::FindDocumentTerm(size_t index, int term_id) const {
+    const auto [first, last] = forward_index_[index];
+    const TermFrequency* it = lower_bound(first, last, term_id, [](const TermFrequency& entry, int id) {
+        return entry.term_id < id;
+    });
+    return it != last && it->term_id == term_id ? it : nullptr;
+}
+
+double FrozenIndex::TermFreq(int document_id, int term_id) const {
+    return FindDocumentTerm(FindDocument(document_id), term_id)->freq;
+}
+
+void FrozenIndex::BuildRatingOrder() {
+    rating_order_.resize(document_ids_.size());
+    iota(rating_order_.begin(), rating_order_.end(), 0u);
+    // столбцы упорядочены по id, поэтому устойчивая сортировка сохраняет порядок id при равном рейтинге
+    stable_sort(rating_order_.begin(), rating_order_.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return ratings_[lhs] < ratings_[rhs];
+    });
+}
+
+pair<const uint32_t*, const uint32_t*> FrozenIndex::RatingRange(int min_rating, int max_rating) const {
+    const auto first = partition_point(rating_order_.begin(), rating_order_.end(), [this, min_rating](uint32_t index) {
+        return ratings_[index] < min_rating;
+    });
+    const auto last = partition_point(first, rating_order_.end(), [this, max_rating](uint32_t index) {
+        return ratings_[index] <= max_rating;
+    });
+    return {rating_order_.data() + (first - rating_order_.begin()), rating_order_.data() + (last - rating_order_.begin())};
+}
+
+void FrozenIndex::BuildImpacts() {
+    if (impact_precision_ == ImpactPrecision::NONE) {
+        return;
+    }
+    const CollectionStats stats{static_cast<int>(document_ids_.size()), 0.0};
+    // общий масштаб для всех слов, чтобы вклады разных слов складывались как целые
+    double max_impact = 0.0;
+    for (const StatusPostings& postings : postings_) {
+        const double term_weight = TfIdfScorer::TermWeight(stats, postings.size());
+        for (int status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index) {
+            for (const auto& [document_id, term_freq] : postings.Partition(static_cast<DocumentStatus>(status_index))) {
+                max_impact = max(max_impact, TfIdfScorer::Score(term_freq, term_weight, 0, stats));
+            }
+        }
+    }
+    const double max_units = impact_precision_ == ImpactPrecision::BITS_8 ? UINT8_MAX : UINT16_MAX;
+    impact_scale_ = max_impact > 0.0 ? max_units / max_impact : 0.0;
+
+    size_t posting_count = 0;
+    for (const StatusPostings& postings : postings_) {
+        posting_count += postings.size();
+    }
+    impact_offsets_.reserve(postings_.size() * DOCUMENT_STATUS_COUNT + 1);
+    impact_block_offsets_.reserve(postings_.size() * DOCUMENT_STATUS_COUNT + 1);
+    impact_block_maxima_.reserve(posting_count / IMPACT_BLOCK_SIZE + postings_.size() * DOCUMENT_STATUS_COUNT);
+    impact_document_indices_.reserve(posting_count);
+    if (impact_precision_ == ImpactPrecision::BITS_8) {
+        impacts_8_.reserve(posting_count);
+    } else {
+        impacts_16_.reserve(posting_count);
+    }
+
+    impact_offsets_.push_back(0);
+    impact_block_offsets_.push_back(0);
+    for (const StatusPostings& postings : postings_) {
+        const double term_weight = TfIdfScorer::TermWeight(stats, postings.size());
+        for (int status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index) {
+            for (const auto& [document_id, term_freq] : postings.Partition(static_cast<DocumentStatus>(status_index))) {
+                const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+                impact_document_indices_.push_back(static_cast<uint32_t>(it - document_ids_.begin()));
+                const long impact = lround(TfIdfScorer::Score(term_freq, term_weight, 0, stats) * impact_scale_);
+                if (impact_precision_ == ImpactPrecision::BITS_8) {
+                    impacts_8_.push_back(static_cast<uint8_t>(impact));
+                } else {
+                    impacts_16_.push_back(static_cast<uint16_t>(impact));
+                }
+            }
+            const size_t begin = impact_offsets_.back();
+            const size_t end = impact_document_indices_.size();
+            for (size_t block_begin = begin; block_begin < end; block_begin += IMPACT_BLOCK_SIZE) {
+                const size_t block_end = min(end, block_begin + IMPACT_BLOCK_SIZE);
+                impact_block_maxima_.push_back(impact_precision_ == ImpactPrecision::BITS_8
+                                               ? *max_element(impacts_8_.begin() + block_begin, impacts_8_.begin() + block_end)
+                                               : *max_element(impacts_16_.begin() + block_begin, impacts_16_.begin() + block_end));
+            }
+            impact_offsets_.push_back(end);
+            impact_block_offsets_.push_back(impact_block_maxima_.size());
+        }
+    }
+}
+
+size_t FrozenIndex::GetImpactBytes() const {
+    return impact_offsets_.size() * sizeof(size_t)
+           + impact_document_indices_.size() * sizeof(uint32_t)
+           + impacts_8_.size() * sizeof(uint8_t)
+           + impacts_16_.size() * sizeof(uint16_t)
+           + impact_block_offsets_.size() * sizeof(size_t)
+           + impact_block_maxima_.size() * sizeof(uint16_t)
+           + forward_index_.size() * sizeof(pair<const TermFrequency*, const TermFrequency*>);
+}
+
+size_t FrozenIndex::FindTerm(string_view word) const {
+    const size_t index = LowerBound(word);
+    if (index == terms_.size() || terms_[index] != word) {
+        return terms_.size();
+    }
+    return index;
+}
+
+size_t FrozenIndex::LowerBound(string_view word) const {
+    return lower_bound(terms_.begin(), terms_.end(), word) - terms_.begin();
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "document.h"
+#include "impact_kernel.h"
+#include "posting_list.h"
+#include "word_frequencies.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+const size_t CACHE_LINE_SIZE = 64;
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Память неизменяемого индекса: выделяется подряд из одного блока и не освобождается до
+// разрушения арены. Массивы не короче строки кэша начинаются с её границы. Большой блок
+// можно разместить на страницах по 2 МБ, чтобы обход списков реже промахивался мимо TLB.
+// Если блока не хватило, память берётся из кучи
+class FrozenArena : public std::pmr::memory_resource {
+public:
+    FrozenArena(size_t capacity, bool use_huge_pages);
+
+    FrozenArena(const FrozenArena&) = delete;
+
+    FrozenArena& operator=(const FrozenArena&) = delete;
+
+    ~FrozenArena() override;
+
+    bool UsesHugePages() const;
+
+    // Память блока и выделенная сверх него из кучи
+    size_t GetAllocatedBytes() const;
+
+private:
+    char* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t overflow_bytes_ = 0;
+    bool uses_huge_pages_ = false;
+    std::pmr::monotonic_buffer_resource overflow_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Данные документа, которые читаются при ранжировании
+struct DocumentAttributes {
+    int rating;
+    DocumentStatus status;
+    int word_count;
+};
+
+// Точность квантованных вкладов слов в релевантность TF-IDF
+enum class ImpactPrecision {
+    NONE,     // вклады не строятся
+    BITS_8,
+    BITS_16,
+};
+
+// Квантованные вклады части списка документов слова: номера документов в столбцах индекса
+// и вклады tf * idf, умноженные на масштаб индекса и округлённые до целого. Для каждых
+// IMPACT_BLOCK_SIZE вкладов подряд хранится наибольший из них
+template <typename Impact>
+struct ImpactList {
+    const uint32_t* document_indices;
+    const Impact* impacts;
+    size_t size;
+    const uint16_t* block_maxima;
+
+    size_t BlockCount() const {
+        return (size + IMPACT_BLOCK_SIZE - 1) / IMPACT_BLOCK_SIZE;
+    }
+};
+
+// Индекс только для чтения (SearchServer::Freeze). Словарь - отсортированный массив слов
+// и параллельный ему массив списков документов, списки лежат подряд в одном блоке,
+// данные документов хранятся по столбцам, упорядоченным по id. С квантованными вкладами
+// списки хранят только id документов, а tf читается из прямого индекса документов
+class FrozenIndex : public TermFreqSource {
+public:
+    FrozenIndex(size_t term_count, size_t posting_list_count, size_t posting_count, size_t document_count,
+                bool use_huge_pages, ImpactPrecision impact_precision = ImpactPrecision::NONE);
+
+    FrozenIndex(const FrozenIndex&) = delete;
+
+    FrozenIndex& operator=(const FrozenIndex&) = delete;
+
+    // Слова добавляются по возрастанию; term_id - номер слова в прямом индексе
+    void AddTerm(std::string_view word, int term_id, const StatusPostings& postings);
+
+    // Документы добавляются по возрастанию id. Прямой индекс word_freqs упорядочен по номеру
+    // слова; с квантованными вкладами индекс ссылается на него и не должен его пережить
+    void AddDocument(int document_id, const DocumentAttributes& attributes, const std::vector<TermFrequency>& word_freqs);
+
+    // Упорядочивает документы по рейтингу для RatingRange. Вызывается после добавления всех документов
+    void BuildRatingOrder();
+
+    // Строит квантованные вклады всех списков с точностью, заданной при создании.
+    // Вызывается после добавления всех слов и документов
+    void BuildImpacts();
+
+    // Номер слова в словаре или TermCount(), если слова нет
+    size_t FindTerm(std::string_view word) const;
+
+    // Номер первого слова словаря не меньше word
+    size_t LowerBound(std::string_view word) const;
+
+    size_t TermCount() const {
+        return terms_.size();
+    }
+
+    std::string_view Term(size_t index) const {
+        return terms_[index];
+    }
+
+    const StatusPostings& Postings(size_t index) const {
+        return postings_[index];
+    }
+
+    int TermId(size_t index) const {
+        return term_ids_[index];
+    }
+
+    // Номер слова по его спискам документов из Postings
+    size_t TermIndex(const StatusPostings* postings) const {
+        return postings - postings_.data();
+    }
+
+    size_t DocumentCount() const {
+        return document_ids_.size();
+    }
+
+    int DocumentId(size_t index) const {
+        return document_ids_[index];
+    }
+
+    int DocumentRating(size_t index) const {
+        return ratings_[index];
+    }
+
+    DocumentAttributes DocumentAt(size_t index) const {
+        return {ratings_[index], statuses_[index], word_counts_[index]};
+    }
+
+    // Запись прямого индекса документа с номером index в столбцах для слова term_id или
+    // nullptr, если слова в документе нет. Прямой индекс есть только у индекса с вкладами
+    const TermFrequency* FindDocumentTerm(size_t index, int term_id) const;
+
+    double TermFreq(int document_id, int term_id) const override;
+
+    // Номера в столбцах документов с рейтингом из [min_rating, max_rating]
+    // по возрастанию рейтинга, при равном рейтинге - по возрастанию id
+    std::pair<const uint32_t*, const uint32_t*> RatingRange(int min_rating, int max_rating) const;
+
+    ImpactPrecision GetImpactPrecision() const {
+        return impact_precision_;
+    }
+
+    // Число единиц квантованного вклада на единицу релевантности. Вклад отличается
+    // от точного не больше чем на половину единицы
+    double GetImpactScale() const {
+        return impact_scale_;
+    }
+
+    // Impact - uint8_t для ImpactPrecision::BITS_8 и uint16_t для BITS_16
+    template <typename Impact>
+    ImpactList<Impact> Impacts(size_t term_index, DocumentStatus status) const {
+        const size_t list_index = term_index * DOCUMENT_STATUS_COUNT + static_cast<size_t>(status);
+        const size_t begin = impact_offsets_[list_index];
+        const size_t size = impact_offsets_[list_index + 1] - begin;
+        const uint16_t* block_maxima = impact_block_maxima_.data() + impact_block_offsets_[list_index];
+        if constexpr (sizeof(Impact) == sizeof(uint8_t)) {
+            return {impact_document_indices_.data() + begin, impacts_8_.data() + begin, size, block_maxima};
+        } else {
+            return {impact_document_indices_.data() + begin, impacts_16_.data() + begin, size, block_maxima};
+        }
+    }
+
+    // Память квантованных вкладов и ссылок на прямой индекс в байтах
+    size_t GetImpactBytes() const;
+
+    // Документ должен быть в индексе
+    DocumentAttributes GetDocument(int document_id) const {
+        return DocumentAt(FindDocument(document_id));
+    }
+
+    bool UsesHugePages() const {
+        return arena_.UsesHugePages();
+    }
+
+    size_t GetMemoryBytes() const {
+        return arena_.GetAllocatedBytes();
+    }
+
+private:
+    // арена объявлена первой: массивы ниже выделены из неё
+    FrozenArena arena_;
+    std::pmr::vector<std::string_view> terms_{&arena_};
+    std::pmr::vector<int> term_ids_{&arena_};
+    std::pmr::vector<StatusPostings> postings_{&arena_};
+    std::pmr::vector<int> document_ids_{&arena_};
+    std::pmr::vector<int> ratings_{&arena_};
+    std::pmr::vector<DocumentStatus> statuses_{&arena_};
+    std::pmr::vector<int> word_counts_{&arena_};
+    // прямой индекс документов: записи [first, second) по возрастанию номера слова
+    std::pmr::vector<std::pair<const TermFrequency*, const TermFrequency*>> forward_index_{&arena_};
+    // номера документов в столбцах по возрастанию рейтинга
+    std::pmr::vector<uint32_t> rating_order_{&arena_};
+    ImpactPrecision impact_precision_;
+    double impact_scale_ = 0.0;
+    // вклады всех частей списков подряд: часть status слова term начинается
+    // с impact_offsets_[term * DOCUMENT_STATUS_COUNT + status]
+    std::pmr::vector<size_t> impact_offsets_{&arena_};
+    std::pmr::vector<uint32_t> impact_document_indices_{&arena_};
+    std::pmr::vector<uint8_t> impacts_8_{&arena_};
+    std::pmr::vector<uint16_t> impacts_16_{&arena_};
+    // наибольшие вклады блоков, у каждой части списка свои блоки
+    std::pmr::vector<size_t> impact_block_offsets_{&arena_};
+    std::pmr::vector<uint16_t> impact_block_maxima_{&arena_};
+
+    // Номер документа в столбцах; документ должен быть в индексе. Двоичный поиск без ветвлений:
+    // выбор половины компилируется в условную пересылку, поэтому не зависит от предсказания переходов
+    size_t FindDocument(int document_id) const {
+        const int* first = document_ids_.data();
+        size_t count = document_ids_.size();
+        while (count > 1) {
+            const size_t half = count / 2;
+            first = first[half] <= document_id ? first + half : first;
+            count -= half;
+        }
+        return first - document_ids_.data();
+    }
+};
@@ -0,0 +1,13 @@
+// Точка входа libFuzzer для дифференциальной проверки SearchServer.
+// Сборка описана в README.md; в обычную сборку файл не входит
+#include "differential_testing.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // расхождение с эталоном - исключение, которое libFuzzer считает падением
+    RunDifferentialScenario(std::string_view(reinterpret_cast<const char*>(data), size));
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "impact_kernel.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define IMPACT_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+template <typename Impact>
+void AddImpactsScalar(const uint32_t* document_indices, const Impact* impacts, size_t count, uint32_t* scores) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t& score = scores[document_indices[i]];
+        score = (score + impacts[i]) | IMPACT_TOUCHED_BIT;
+    }
+}
+
+#ifdef IMPACT_KERNEL_X86
+
+// вклады расширяются до 32 бит одной инструкцией, своей для каждой ширины вклада,
+// поэтому загрузка - перегрузки по типу вклада, а шаблонные ядра выбирают нужную
+__attribute__((target("avx2"))) __m256i LoadImpactsAvx2(const uint8_t* impacts) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(impacts)));
+}
+
+__attribute__((target("avx2"))) __m256i LoadImpactsAvx2(const uint16_t* impacts) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(impacts)));
+}
+
+// в AVX2 нет рассылки, поэтому сложенные счета записываются по одному
+template <typename Impact>
+__attribute__((target("avx2"))) void AddImpactsAvx2(const uint32_t* document_indices, const Impact* impacts, size_t count,
+                                                    uint32_t* scores) {
+    const __m256i touched = _mm256_set1_epi32(static_cast<int>(IMPACT_TOUCHED_BIT));
+    alignas(32) uint32_t sums[8];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(document_indices + i));
+        const __m256i current = _mm256_i32gather_epi32(reinterpret_cast<const int*>(scores), indices, 4);
+        const __m256i sum = _mm256_or_si256(_mm256_add_epi32(current, LoadImpactsAvx2(impacts + i)), touched);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum);
+        for (int lane = 0; lane < 8; ++lane) {
+            scores[document_indices[i + lane]] = sums[lane];
+        }
+    }
+    AddImpactsScalar(document_indices + i, impacts + i, count - i, scores);
+}
+
+// маскированные формы с явным начальным значением: немаскированные в GCC 12 дают ложные
+// предупреждения о неинициализированных регистрах
+const __mmask16 ALL_LANES = 0xFFFF;
+
+__attribute__((target("avx512f"))) __m512i LoadImpactsAvx512(const uint8_t* impacts) {
+    return _mm512_maskz_cvtepu8_epi32(ALL_LANES, _mm_loadu_si128(reinterpret_cast<const __m128i*>(impacts)));
+}
+
+__attribute__((target("avx512f"))) __m512i LoadImpactsAvx512(const uint16_t* impacts) {
+    return _mm512_maskz_cvtepu16_epi32(ALL_LANES, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(impacts)));
+}
+
+// рассылка корректна, потому что номера документов в одной порции не повторяются
+template <typename Impact>
+__attribute__((target("avx512f"))) void AddImpactsAvx512(const uint32_t* document_indices, const Impact* impacts, size_t count,
+                                                         uint32_t* scores) {
+    const __m512i touched = _mm512_set1_epi32(static_cast<int>(IMPACT_TOUCHED_BIT));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m512i indices = _mm512_loadu_si512(document_indices + i);
+        const __m512i current = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), ALL_LANES, indices, scores, 4);
+        const __m512i sum = _mm512_or_si512(_mm512_add_epi32(current, LoadImpactsAvx512(impacts + i)), touched);
+        _mm512_i32scatter_epi32(scores, indices, sum, 4);
+    }
+    AddImpactsScalar(document_indices + i, impacts + i, count - i, scores);
+}
+
+#endif
+
+template <typename Impact>
+void AddImpactsWith(KernelIsa isa, const uint32_t* document_indices, const Impact* impacts, size_t count, uint32_t* scores) {
+#ifdef IMPACT_KERNEL_X86
+    switch (isa) {
+        case KernelIsa::AVX512:
+            AddImpactsAvx512(document_indices, impacts, count, scores);
+            return;
+        case KernelIsa::AVX2:
+            AddImpactsAvx2(document_indices, impacts, count, scores);
+            return;
+        default:
+            break;
+    }
+#endif
+    AddImpactsScalar(document_indices, impacts, count, scores);
+}
+
+KernelIsa DetectKernelIsa() {
+    for (const KernelIsa isa : {KernelIsa::AVX512, KernelIsa::AVX2}) {
+        if (IsKernelIsaSupported(isa)) {
+            return isa;
+        }
+    }
+    return KernelIsa::SCALAR;
+}
+
+} // namespace
+
+string_view ToString(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512:
+            return "avx512"sv;
+        case KernelIsa::AVX2:
+            return "avx2"sv;
+        default:
+            return "scalar"sv;
+    }
+}
+
+KernelIsa GetBestKernelIsa() {
+    static const KernelIsa isa = DetectKernelIsa();
+    return isa;
+}
+
+bool IsKernelIsaSupported(KernelIsa isa) {
+#ifdef IMPACT_KERNEL_X86
+    switch (isa) {
+        case KernelIsa::AVX512:
+            return __builtin_cpu_supports("avx512f");
+        case KernelIsa::AVX2:
+            return __builtin_cpu_supports("avx2");
+        default:
+            return true;
+    }
+#else
+    return isa == KernelIsa::SCALAR;
+#endif
+}
+
+void AddImpacts(const uint32_t* document_indices, const uint8_t* impacts, size_t count, uint32_t* scores) {
+    AddImpactsWith(GetBestKernelIsa(), document_indices, impacts, count, scores);
+}
+
+void AddImpacts(const uint32_t* document_indices, const uint16_t* impacts, size_t count, uint32_t* scores) {
+    AddImpactsWith(GetBestKernelIsa(), document_indices, impacts, count, scores);
+}
+
+void AddImpacts(KernelIsa isa, const uint32_t* document_indices, const uint8_t* impacts, size_t count, uint32_t* scores) {
+    AddImpactsWith(isa, document_indices, impacts, count, scores);
+}
+
+void AddImpacts(KernelIsa isa, const uint32_t* document_indices, const uint16_t* impacts, size_t count, uint32_t* scores) {
+    AddImpactsWith(isa, document_indices, impacts, count, scores);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Число вкладов в блоке списка. Для каждого блока хранится наибольший вклад,
+// чтобы при поиске пропускать блоки, которые не могут повлиять на лучшие документы
+const size_t IMPACT_BLOCK_SIZE = 128;
+
+// Признак документа, счёт которого затронут хотя бы одним вкладом
+const uint32_t IMPACT_TOUCHED_BIT = 1u << 31;
+
+// Набор инструкций ядра сложения вкладов
+enum class KernelIsa {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+std::string_view ToString(KernelIsa isa);
+
+// Лучший набор инструкций, поддерживаемый процессором. Определяется один раз
+KernelIsa GetBestKernelIsa();
+
+bool IsKernelIsaSupported(KernelIsa isa);
+
+// Прибавляет вклады к счетам документов и отмечает их:
+// scores[document_indices[i]] = (scores[document_indices[i]] + impacts[i]) | IMPACT_TOUCHED_BIT.
+// Номера документов внутри вызова не должны повторяться - в списке документов слова так и есть.
+// Векторные версии читают счета сборкой (gather), AVX-512 и записывает их рассылкой (scatter)
+void AddImpacts(const uint32_t* document_indices, const uint8_t* impacts, size_t count, uint32_t* scores);
+
+void AddImpacts(const uint32_t* document_indices, const uint16_t* impacts, size_t count, uint32_t* scores);
+
+// То же с явно заданным набором инструкций, который должен поддерживаться процессором
+void AddImpacts(KernelIsa isa, const uint32_t* document_indices, const uint8_t* impacts, size_t count, uint32_t* scores);
+
+void AddImpacts(KernelIsa isa, const uint32_t* document_indices, const uint16_t* impacts, size_t count, uint32_t* scores);
@@ -0,0 +1,32 @@
+#include "index_stats.h"
+
+using namespace std;
+
+ostream& operator<<(ostream& out, const IndexStats& stats) {
+    out << "{ documents = "s << stats.document_count
+        << ", terms = "s << stats.term_count
+        << ", postings = "s << stats.posting_count
+        << ", posting_lengths = ["s;
+    for (size_t i = 0; i < stats.posting_length_histogram.size(); ++i) {
+        out << (i == 0 ? ""s : ", "s) << stats.posting_length_histogram[i];
+    }
+    out << "], dictionary = "s << stats.dictionary_bytes
+        << ", postings_bytes = "s << stats.postings_bytes
+        << ", positions = "s << stats.positions_bytes
+        << ", forward_index = "s << stats.forward_index_bytes
+        << ", document_ids = "s << stats.document_ids_bytes
+        << ", rating_index = "s << stats.rating_index_bytes
+        << ", status_documents = "s << stats.status_documents_bytes
+        << ", document_store = "s << stats.document_store_bytes
+        << ", frozen_index = "s << stats.frozen_index_bytes
+        << ", impacts = "s << stats.impact_bytes
+        << ", index_pool = "s << stats.index_pool_bytes
+        << ", index_pool_overhead = "s << stats.index_pool_overhead_bytes
+        << ", total = "s << stats.total_bytes
+        << ", heaviest_terms = ["s;
+    for (size_t i = 0; i < stats.heaviest_terms.size(); ++i) {
+        const TermStats& term = stats.heaviest_terms[i];
+        out << (i == 0 ? ""s : ", "s) << term.word << ": "s << term.document_count << " docs "s << term.bytes << " bytes"s;
+    }
+    return out << "] }"s;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Слово индекса и память его списков документов и позиций
+struct TermStats {
+    std::string word;
+    size_t document_count = 0;
+    size_t bytes = 0;
+};
+
+// Состав индекса и память по структурам в байтах. Память узлов деревьев оценивается по
+// их числу, память массивов - по ёмкости. index_pool_bytes - сколько пул узлов индекса
+// взял у системы, index_pool_overhead_bytes - его часть сверх оценки узлов: округление
+// размеров, свободные узлы после удаления документов и незанятые части блоков пула
+struct IndexStats {
+    size_t document_count = 0;
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    // posting_length_histogram[i] - число слов, которые встречаются в [2^i, 2^(i+1)) документах
+    std::vector<size_t> posting_length_histogram;
+
+    size_t dictionary_bytes = 0;
+    size_t postings_bytes = 0;
+    size_t positions_bytes = 0;
+    size_t forward_index_bytes = 0;
+    size_t document_ids_bytes = 0;
+    size_t rating_index_bytes = 0;
+    size_t status_documents_bytes = 0;
+    size_t document_store_bytes = 0;
+    size_t frozen_index_bytes = 0;
+    // часть frozen_index_bytes под квантованные вклады (FreezeOptions::impact_precision)
+    size_t impact_bytes = 0;
+    size_t index_pool_bytes = 0;
+    size_t index_pool_overhead_bytes = 0;
+    size_t total_bytes = 0;
+
+    // слова с наибольшей памятью, по убыванию
+    std::vector<TermStats> heaviest_terms;
+};
+
+std::ostream& operator<<(std::ostream& out, const IndexStats& stats);
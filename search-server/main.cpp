@@ -1,71 +1,168 @@
 #include "search_server.h"
+#include "corpus_reader.h"
+#include "generators.h"
+#include "impact_kernel.h"
 #include "log_duration.h"
+#include "numa_search_server.h"
+#include "persistent_search_server.h"
+#include "process_queries.h"
 
+#include <algorithm>
 #include <execution>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution('a', 'z')(generator));
+template <typename ExecutionPolicy>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+
+void TestIngest(const string& stop_words, const vector<string>& documents) {
+    const string path = (filesystem::temp_directory_path() / "search_server_bench_corpus.txt"s).string();
+    {
+        ofstream out(path);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            out << i << "\t0\t1 2 3\t"s << documents[i] << '\n';
+        }
+    }
+    {
+        const MappedFile file(path);
+        SearchServer search_server(stop_words);
+        cout << "ingest "s << LoadCorpus(search_server, file, CorpusFormat::NEWLINE_DELIMITED) << endl;
+    }
+    filesystem::remove(path);
+}
+
+// Память индекса по структурам и время её подсчёта
+void TestIndexStats(const SearchServer& search_server) {
+    IndexStats stats;
+    {
+        LOG_DURATION("index stats"s);
+        stats = search_server.GetIndexStats(3);
     }
-    return word;
+    cout << "index stats "s << stats << endl;
+}
+
+// Итог EXPLAIN первого запроса по статусу и с предикатом по рейтингу: выбранный способ,
+// оценка и фактическое число чтений списков. Слова плана не выводятся - их десятки
+void TestQueryPlans(const SearchServer& search_server, const vector<string>& queries) {
+    const auto print_summary = [](const QueryExplanation& explanation) {
+        cout << "EXPLAIN "s << ToString(explanation.plan.strategy)
+             << " { estimated_cost = "s << explanation.plan.estimated_cost
+             << ", posting_reads = "s << explanation.posting_reads
+             << ", scored_documents = "s << explanation.scored_documents
+             << ", elapsed = "s << explanation.elapsed.count() << " us }"s << endl;
+    };
+    const auto prepared_query = search_server.PrepareQuery(queries.front());
+    print_summary(search_server.ExplainQuery(prepared_query));
+    print_summary(search_server.ExplainQuery(prepared_query, [](int, DocumentStatus, int rating) {
+        return rating > 0;
+    }));
 }
 
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
+// Поиск по замороженному индексу без квантования и с квантованными вкладами: сумма
+// релевантностей совпадает, различаются время и память. Вклады хранятся в дополнение
+// к точным tf, поэтому память замороженного индекса с ними больше
+void TestImpactPrecision(const SearchServer& search_server, const vector<string>& queries) {
+    ByteWriter snapshot;
+    search_server.SaveSnapshot(snapshot);
+    const vector<pair<string, ImpactPrecision>> precisions = {{"frozen exact"s, ImpactPrecision::NONE},
+                                                              {"frozen impacts 16 bit"s, ImpactPrecision::BITS_16},
+                                                              {"frozen impacts 8 bit"s, ImpactPrecision::BITS_8}};
+    for (const auto& [mark, precision] : precisions) {
+        ByteReader reader(snapshot.Data());
+        SearchServer frozen_server = SearchServer::LoadSnapshot(reader);
+        frozen_server.Freeze(FreezeOptions{false, precision});
+        const IndexStats stats = frozen_server.GetIndexStats(0);
+        cout << mark << " memory: frozen_index = "s << stats.frozen_index_bytes << ", impacts = "s << stats.impact_bytes << endl;
+        Test(mark, frozen_server, queries, execution::seq);
     }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
 }
 
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
+// Сложение блоков по IMPACT_BLOCK_SIZE вкладов в счета миллиона документов каждым
+// поддерживаемым набором инструкций
+void TestImpactKernels() {
+    mt19937 generator(47);
+    vector<uint32_t> indices(1 << 20);
+    iota(indices.begin(), indices.end(), 0);
+    shuffle(indices.begin(), indices.end(), generator);
+    vector<uint16_t> impacts(indices.size());
+    for (uint16_t& impact : impacts) {
+        impact = generator() % 65536;
+    }
+    for (const KernelIsa isa : {KernelIsa::SCALAR, KernelIsa::AVX2, KernelIsa::AVX512}) {
+        if (!IsKernelIsaSupported(isa)) {
+            continue;
         }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+        vector<uint32_t> scores(indices.size());
+        {
+            LOG_DURATION("impact kernel "s + string(ToString(isa)));
+            for (int repeat = 0; repeat < 20; ++repeat) {
+                for (size_t begin = 0; begin < indices.size(); begin += IMPACT_BLOCK_SIZE) {
+                    AddImpacts(isa, indices.data() + begin, impacts.data() + begin, IMPACT_BLOCK_SIZE, scores.data());
+                }
+            }
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+        cout << accumulate(scores.begin(), scores.end(), uint64_t{0}) << endl;
     }
-    return query;
 }
 
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+// Пакет запросов без привязки к узлам и с копиями индекса на узлах NUMA
+void TestNumaQueries(const SearchServer& search_server, const vector<string>& queries) {
+    {
+        LOG_DURATION("process queries"s);
+        ProcessQueries(search_server, queries);
+    }
+    const NumaSearchServer numa_server(search_server);
+    {
+        LOG_DURATION("numa process queries"s);
+        numa_server.ProcessQueries(queries);
+    }
+    for (const NumaNodeStats& stats : numa_server.GetNodeStats()) {
+        cout << "numa node "s << stats << endl;
     }
-    return queries;
 }
 
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    double total_relevance = 0;
-    for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
-            total_relevance += document.relevance;
+// Добавление документов с журналом изменений и время восстановления из журнала и из снимка
+void TestPersistentIngest(const string& stop_words, const vector<string>& documents) {
+    const string directory = (filesystem::temp_directory_path() / "search_server_bench_persistence"s).string();
+    filesystem::remove_all(directory);
+    {
+        PersistentSearchServer search_server(directory, stop_words, {}, PersistenceOptions{256, chrono::milliseconds(10), 0});
+        LOG_DURATION("wal ingest"s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
         }
+        search_server.Sync();
     }
-    cout << total_relevance << endl;
+    {
+        PersistentSearchServer search_server(directory, stop_words);
+        cout << "recovery from wal "s << search_server.GetRecoveryStats() << endl;
+        search_server.Checkpoint();
+    }
+    {
+        PersistentSearchServer search_server(directory, stop_words);
+        cout << "recovery from snapshot "s << search_server.GetRecoveryStats() << endl;
+    }
+    filesystem::remove_all(directory);
 }
 
-#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
-
 int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -77,4 +174,11 @@ int main() {
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    TestIndexStats(search_server);
+    TestQueryPlans(search_server, queries);
+    TestImpactPrecision(search_server, queries);
+    TestImpactKernels();
+    TestNumaQueries(search_server, queries);
+    TestIngest(dictionary[0], documents);
+    TestPersistentIngest(dictionary[0], documents);
 }
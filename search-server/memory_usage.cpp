@@ -0,0 +1,22 @@
+#include "memory_usage.h"
+
+CountingMemoryResource::CountingMemoryResource(std::pmr::memory_resource* upstream)
+        : upstream_(upstream) {
+}
+
+void* CountingMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* result = upstream_->allocate(bytes, alignment);
+    allocated_bytes_ += bytes;
+    ++allocation_count_;
+    return result;
+}
+
+void CountingMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+    allocated_bytes_ -= bytes;
+    --allocation_count_;
+}
+
+bool CountingMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Ресурс памяти, который передаёт выделения в upstream и считает байты и блоки,
+// занятые в нём сейчас. Счётчики не атомарные: ресурс предназначен для однопоточных пулов
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    size_t GetAllocatedBytes() const {
+        return allocated_bytes_;
+    }
+
+    size_t GetAllocationCount() const {
+        return allocation_count_;
+    }
+
+private:
+    std::pmr::memory_resource* upstream_;
+    size_t allocated_bytes_ = 0;
+    size_t allocation_count_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Оценка памяти узла std::map или std::set: заголовок узла красно-чёрного дерева
+// (три указателя и цвет) и значение, округлённые до выравнивания указателя
+template <typename Value>
+constexpr size_t TreeNodeBytes() {
+    const size_t bytes = 4 * sizeof(void*) + sizeof(Value);
+    return (bytes + alignof(void*) - 1) / alignof(void*) * alignof(void*);
+}
+
+// Память строки вне объекта: ноль, если символы помещаются во встроенный буфер
+template <typename String>
+size_t StringHeapBytes(const String& text) {
+    const char* data = text.data();
+    const char* object = reinterpret_cast<const char*>(&text);
+    if (data >= object && data < object + sizeof(String)) {
+        return 0;
+    }
+    return text.capacity() + 1;
+}
@@ -0,0 +1,127 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+namespace {
+
+int ParseCpuNumber(string_view text) {
+    int result = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), result);
+    if (error != errc() || end != text.data() + text.size() || text.empty()) {
+        throw invalid_argument("Неверный номер процессора: "s + string(text));
+    }
+    return result;
+}
+
+}  // namespace
+
+vector<int> ParseCpuList(string_view text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.remove_suffix(1);
+    }
+    vector<int> cpus;
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        const string_view range = text.substr(0, comma);
+        text = comma == string_view::npos ? string_view() : text.substr(comma + 1);
+
+        const size_t dash = range.find('-');
+        const int first = ParseCpuNumber(range.substr(0, dash));
+        const int last = dash == string_view::npos ? first : ParseCpuNumber(range.substr(dash + 1));
+        if (last < first) {
+            throw invalid_argument("Неверный диапазон процессоров: "s + string(range));
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    sort(cpus.begin(), cpus.end());
+    cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+vector<NumaNode> ReadNumaNodes(const string& node_directory) {
+    vector<NumaNode> nodes;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(node_directory, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node"s) != 0
+            || !all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        ifstream cpulist(entry.path() / "cpulist"s);
+        string text;
+        getline(cpulist, text);
+        NumaNode node{ParseCpuNumber(string_view(name).substr(4)), ParseCpuList(text)};
+        if (!node.cpus.empty()) {
+            nodes.push_back(move(node));
+        }
+    }
+    sort(nodes.begin(), nodes.end(), [](const NumaNode& lhs, const NumaNode& rhs) { return lhs.id < rhs.id; });
+    return nodes;
+}
+
+vector<NumaNode> DetectNumaNodes() {
+    const vector<int> allowed_cpus = GetAllowedCpus();
+    vector<NumaNode> nodes;
+    // процессоры узла, недоступные процессу (cgroup, taskset), не используются
+    for (NumaNode& node : ReadNumaNodes(NUMA_SYSFS_NODE_DIRECTORY)) {
+        vector<int> cpus;
+        set_intersection(node.cpus.begin(), node.cpus.end(), allowed_cpus.begin(), allowed_cpus.end(), back_inserter(cpus));
+        if (!cpus.empty()) {
+            nodes.push_back({node.id, move(cpus)});
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back({0, allowed_cpus});
+    }
+    return nodes;
+}
+
+vector<int> GetAllowedCpus() {
+    vector<int> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpu_set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < max(1u, thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool PinCurrentThread(const vector<int>& cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+    if (CPU_COUNT(&cpu_set) == 0) {
+        return false;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+int GetCurrentCpu() {
+    return sched_getcpu();
+}
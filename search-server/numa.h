@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+const std::string NUMA_SYSFS_NODE_DIRECTORY = "/sys/devices/system/node";
+
+// Узел NUMA: номер и процессоры, для которых его память локальна
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// Список процессоров в формате sysfs, например "0-3,8,10-11". Бросает std::invalid_argument
+std::vector<int> ParseCpuList(std::string_view text);
+
+// Узлы с процессорами из каталога вида /sys/devices/system/node, упорядоченные по номеру.
+// Узлы только с памятью пропускаются. Пустой результат, если каталога нет
+std::vector<NumaNode> ReadNumaNodes(const std::string& node_directory);
+
+// Узлы машины, ограниченные процессорами, на которых процессу разрешено работать.
+// Без NUMA или без sysfs возвращается один узел со всеми разрешёнными процессорами
+std::vector<NumaNode> DetectNumaNodes();
+
+// Процессоры, на которых разрешено работать текущему потоку
+std::vector<int> GetAllowedCpus();
+
+// Ограничивает текущий поток заданными процессорами. Возвращает false, если система
+// не позволила это сделать - тогда поток продолжает работать без привязки
+bool PinCurrentThread(const std::vector<int>& cpus);
+
+// Процессор, на котором сейчас выполняется поток, или -1, если это неизвестно
+int GetCurrentCpu();
@@ -0,0 +1,236 @@
+#include "numa_search_server.h"
+
+#include "binary_io.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+ostream& operator<<(ostream& out, const NumaNodeStats& stats) {
+    return out << "{ node = "s << stats.node
+               << ", cpus = "s << stats.cpu_count
+               << ", replica = "s << (stats.has_replica ? "yes"s : "no"s)
+               << ", queries = "s << stats.queries
+               << ", off_node_queries = "s << stats.off_node_queries << " }"s;
+}
+
+NumaSearchServer::NumaSearchServer(const SearchServer& search_server, NumaOptions options)
+        : NumaSearchServer(search_server, DetectNumaNodes(), options) {
+}
+
+NumaSearchServer::NumaSearchServer(const SearchServer& search_server, vector<NumaNode> nodes, NumaOptions options)
+        : search_server_(search_server)
+        , options_(options) {
+    if (nodes.empty()) {
+        throw invalid_argument("Нужен хотя бы один узел NUMA"s);
+    }
+    for (NumaNode& node : nodes) {
+        if (node.cpus.empty()) {
+            throw invalid_argument("У узла NUMA "s + to_string(node.id) + " нет процессоров"s);
+        }
+        sort(node.cpus.begin(), node.cpus.end());
+        for (int cpu : node.cpus) {
+            if (cpu < 0) {
+                throw invalid_argument("Неверный номер процессора: "s + to_string(cpu));
+            }
+            if (static_cast<size_t>(cpu) >= cpu_to_node_.size()) {
+                cpu_to_node_.resize(cpu + 1, -1);
+            }
+            if (cpu_to_node_[cpu] < 0) {
+                cpu_to_node_[cpu] = nodes_.size();
+            }
+        }
+        auto state = make_unique<NodeState>();
+        state->node = move(node);
+        nodes_.push_back(move(state));
+    }
+    if (options_.replicate_index && nodes_.size() > 1) {
+        BuildReplicas();
+    }
+    StartWorkers();
+}
+
+NumaSearchServer::~NumaSearchServer() {
+    StopWorkers();
+}
+
+void NumaSearchServer::BuildReplicas() {
+    ByteWriter snapshot;
+    search_server_.SaveSnapshot(snapshot);
+    const string_view data = snapshot.Data();
+
+    // страницы выделяются на узле потока, который первым к ним обратился, поэтому копия
+    // загружается и замораживается потоком, привязанным к своему узлу
+    vector<exception_ptr> errors(nodes_.size());
+    vector<thread> builders;
+    builders.reserve(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        builders.emplace_back([this, data, i, &errors] {
+            NodeState& state = *nodes_[i];
+            try {
+                PinCurrentThread(state.node.cpus);
+                ByteReader reader(data);
+                auto replica = make_unique<SearchServer>(SearchServer::LoadSnapshot(reader));
+                replica->Freeze();
+                state.replica = move(replica);
+            } catch (...) {
+                errors[i] = current_exception();
+            }
+        });
+    }
+    for (thread& builder : builders) {
+        builder.join();
+    }
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+void NumaSearchServer::StartWorkers() {
+    try {
+        for (const auto& node : nodes_) {
+            const size_t thread_count = options_.threads_per_node > 0 ? options_.threads_per_node : node->node.cpus.size();
+            node->workers.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; ++i) {
+                node->workers.emplace_back([this, &state = *node] { RunWorker(state); });
+            }
+        }
+    } catch (...) {
+        // деструктор не вызовется, поэтому уже запущенные потоки останавливаются здесь
+        StopWorkers();
+        throw;
+    }
+}
+
+void NumaSearchServer::StopWorkers() {
+    for (const auto& node : nodes_) {
+        {
+            lock_guard guard(node->mutex);
+            node->is_stopping = true;
+        }
+        node->tasks_changed.notify_all();
+    }
+    for (const auto& node : nodes_) {
+        for (thread& worker : node->workers) {
+            worker.join();
+        }
+        node->workers.clear();
+    }
+}
+
+void NumaSearchServer::RunWorker(NodeState& node) const {
+    const bool is_pinned = PinCurrentThread(node.node.cpus);
+    unique_lock lock(node.mutex);
+    while (true) {
+        node.tasks_changed.wait(lock, [&node] { return node.is_stopping || !node.tasks.empty(); });
+        if (node.tasks.empty()) {
+            return;
+        }
+        packaged_task<void(bool)> task = move(node.tasks.front());
+        node.tasks.pop_front();
+        lock.unlock();
+        // исключение куска сохраняется в его future и бросается в ProcessQueries
+        task(is_pinned);
+        lock.lock();
+    }
+}
+
+vector<Document> NumaSearchServer::FindTopDocuments(string_view raw_query) const {
+    const int first_cpu = GetCurrentCpu();
+    const int node_index = GetNodeIndex(first_cpu);
+    const NodeState& node = *nodes_[node_index < 0 ? 0 : node_index];
+    vector<Document> result = GetNodeServer(node).FindTopDocuments(raw_query);
+    CountQueries(node, 1, !IsOnNode(node, first_cpu) || !IsOnNode(node, GetCurrentCpu()));
+    return result;
+}
+
+vector<vector<Document>> NumaSearchServer::ProcessQueries(const vector<string>& queries) const {
+    if (queries.empty()) {
+        return {};
+    }
+    // куски запросов распределены по узлам пропорционально числу их потоков
+    vector<NodeState*> chunk_nodes;
+    for (const auto& node : nodes_) {
+        chunk_nodes.insert(chunk_nodes.end(), node->workers.size(), node.get());
+    }
+    const size_t chunk_count = min(chunk_nodes.size(), queries.size());
+    vector<vector<string_view>> chunks(chunk_count);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        chunks[i * chunk_count / queries.size()].push_back(queries[i]);
+    }
+
+    vector<vector<vector<Document>>> chunk_results(chunk_count);
+    vector<future<void>> chunk_done;
+    chunk_done.reserve(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        NodeState& node = *chunk_nodes[i];
+        packaged_task<void(bool)> task([this, &node, &chunk = chunks[i], &chunk_result = chunk_results[i]](bool is_pinned) {
+            const int first_cpu = GetCurrentCpu();
+            chunk_result = GetNodeServer(node).FindTopDocumentsBatch(chunk);
+            CountQueries(node, chunk.size(), !is_pinned || !IsOnNode(node, first_cpu) || !IsOnNode(node, GetCurrentCpu()));
+        });
+        chunk_done.push_back(task.get_future());
+        {
+            lock_guard guard(node.mutex);
+            node.tasks.push_back(move(task));
+        }
+        node.tasks_changed.notify_one();
+    }
+    // куски ссылаются на локальные массивы, поэтому дожидаемся всех, даже если один упал
+    for (const future<void>& done : chunk_done) {
+        done.wait();
+    }
+    for (future<void>& done : chunk_done) {
+        done.get();
+    }
+
+    vector<vector<Document>> result;
+    result.reserve(queries.size());
+    for (vector<vector<Document>>& documents : chunk_results) {
+        move(documents.begin(), documents.end(), back_inserter(result));
+    }
+    return result;
+}
+
+size_t NumaSearchServer::GetNodeCount() const {
+    return nodes_.size();
+}
+
+vector<NumaNodeStats> NumaSearchServer::GetNodeStats() const {
+    vector<NumaNodeStats> result;
+    result.reserve(nodes_.size());
+    for (const auto& node : nodes_) {
+        result.push_back({node->node.id, node->node.cpus.size(), node->replica != nullptr,
+                          node->queries.load(), node->off_node_queries.load()});
+    }
+    return result;
+}
+
+int NumaSearchServer::GetNodeIndex(int cpu) const {
+    if (cpu < 0 || static_cast<size_t>(cpu) >= cpu_to_node_.size()) {
+        return -1;
+    }
+    return cpu_to_node_[cpu];
+}
+
+const SearchServer& NumaSearchServer::GetNodeServer(const NodeState& node) const {
+    return node.replica ? *node.replica : search_server_;
+}
+
+bool NumaSearchServer::IsOnNode(const NodeState& node, int cpu) {
+    // процессор может входить в несколько заданных узлов, поэтому проверяется принадлежность узлу
+    return cpu < 0 || binary_search(node.node.cpus.begin(), node.node.cpus.end(), cpu);
+}
+
+void NumaSearchServer::CountQueries(const NodeState& node, size_t query_count, bool is_off_node) const {
+    node.queries.fetch_add(query_count, memory_order_relaxed);
+    if (is_off_node) {
+        node.off_node_queries.fetch_add(query_count, memory_order_relaxed);
+    }
+}
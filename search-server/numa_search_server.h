@@ -0,0 +1,110 @@
+#pragma once
+
+#include "numa.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct NumaOptions {
+    // на каждом узле строится своя замороженная копия индекса; иначе все узлы читают исходный
+    bool replicate_index = true;
+    // 0 - по одному потоку на процессор узла
+    size_t threads_per_node = 0;
+};
+
+// Счётчики узла. off_node_queries - запросы, при исполнении которых поток хотя бы раз оказался
+// вне узла своей копии индекса: процессор проверяется до и после запроса, а в ProcessQueries -
+// до и после куска запросов, поэтому кратковременный уход на другой узел может быть не замечен.
+// Запросы потока, которого не удалось привязать к узлу, учитываются все. Счётчик показывает,
+// работает ли привязка, но не измеряет обращения к чужой памяти - для этого нужны счётчики uncore
+struct NumaNodeStats {
+    int node = 0;
+    size_t cpu_count = 0;
+    bool has_replica = false;
+    uint64_t queries = 0;
+    uint64_t off_node_queries = 0;
+};
+
+std::ostream& operator<<(std::ostream& out, const NumaNodeStats& stats);
+
+// Поиск с учётом NUMA: индекс копируется в память каждого узла потоком, привязанным к этому
+// узлу, поэтому страницы копии выделяются локально, а запросы выполняются постоянными потоками,
+// привязанными к узлу своей копии. Внутри запроса используется последовательный поиск, чтобы
+// работа не уходила на чужой узел. На машине с одним узлом копия не строится и поиск идёт по
+// исходному индексу. Пока объект существует, search_server нельзя изменять
+class NumaSearchServer {
+public:
+    explicit NumaSearchServer(const SearchServer& search_server, NumaOptions options = {});
+
+    // Узлы задаются явно, например чтобы разделить процессоры одного узла на несколько
+    NumaSearchServer(const SearchServer& search_server, std::vector<NumaNode> nodes, NumaOptions options = {});
+
+    NumaSearchServer(const NumaSearchServer&) = delete;
+    NumaSearchServer& operator=(const NumaSearchServer&) = delete;
+
+    // Дожидается кусков запросов, уже отданных потокам узлов
+    ~NumaSearchServer();
+
+    // Выполняется в вызывающем потоке по копии узла процессора, на котором он сейчас работает
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    // Результат совпадает с ProcessQueries(search_server, queries). Запросы делятся на куски
+    // по числу потоков всех узлов; потоки создаются вместе с объектом, каждый привязан к своему
+    // узлу и читает его копию. Ошибка в запросе бросается после исполнения всех кусков
+    std::vector<std::vector<Document>> ProcessQueries(const std::vector<std::string>& queries) const;
+
+    size_t GetNodeCount() const;
+
+    std::vector<NumaNodeStats> GetNodeStats() const;
+
+private:
+    struct NodeState {
+        NumaNode node;
+        std::unique_ptr<SearchServer> replica;
+        mutable std::atomic<uint64_t> queries{0};
+        mutable std::atomic<uint64_t> off_node_queries{0};
+        // куски запросов, которые ждут свободного потока узла; аргумент - удалось ли
+        // привязать исполняющий поток к узлу
+        std::mutex mutex;
+        std::condition_variable tasks_changed;
+        std::deque<std::packaged_task<void(bool)>> tasks;
+        bool is_stopping = false;
+        std::vector<std::thread> workers;
+    };
+
+    const SearchServer& search_server_;
+    const NumaOptions options_;
+    std::vector<std::unique_ptr<NodeState>> nodes_;
+    // номер элемента nodes_ для каждого процессора, -1 для процессоров вне узлов
+    std::vector<int> cpu_to_node_;
+
+    void BuildReplicas();
+
+    void StartWorkers();
+
+    void StopWorkers();
+
+    // Цикл потока узла: привязывается к процессорам узла и исполняет его куски запросов
+    void RunWorker(NodeState& node) const;
+
+    int GetNodeIndex(int cpu) const;
+
+    const SearchServer& GetNodeServer(const NodeState& node) const;
+
+    // Процессор cpu входит в узел или неизвестен
+    static bool IsOnNode(const NodeState& node, int cpu);
+
+    // Учитывает выполненные на узле запросы
+    void CountQueries(const NodeState& node, size_t query_count, bool is_off_node) const;
+};
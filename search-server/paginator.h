@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 template <typename Iterator>
 class IteratorRange {
@@ -61,3 +65,83 @@ template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
+
+// Постраничный обход последовательности, страницы которой вычисляются только при переходе
+// к ним. PageSource::NextPage(page_size) возвращает следующую страницу, пустую, когда
+// элементы закончились. Обход однопроходный: begin() можно вызвать один раз
+template <typename PageSource>
+class LazyPaginator {
+public:
+    using Page = decltype(std::declval<PageSource&>().NextPage(std::size_t{}));
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Page;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Page*;
+        using reference = const Page&;
+
+        Iterator() = default;
+
+        explicit Iterator(LazyPaginator* paginator)
+                : paginator_(paginator) {
+            Fetch();
+        }
+
+        const Page& operator*() const {
+            return page_;
+        }
+
+        const Page* operator->() const {
+            return &page_;
+        }
+
+        Iterator& operator++() {
+            Fetch();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return paginator_ == other.paginator_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return paginator_ != other.paginator_;
+        }
+
+    private:
+        // после последней страницы итератор становится равным end()
+        void Fetch() {
+            page_ = paginator_->source_.NextPage(paginator_->page_size_);
+            if (page_.empty()) {
+                paginator_ = nullptr;
+            }
+        }
+
+        LazyPaginator* paginator_ = nullptr;
+        Page page_;
+    };
+
+    LazyPaginator(PageSource source, size_t page_size)
+            : source_(std::move(source))
+            , page_size_(page_size) {
+    }
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return {};
+    }
+
+private:
+    PageSource source_;
+    size_t page_size_;
+};
+
+template <typename PageSource>
+auto PaginateLazily(PageSource source, size_t page_size) {
+    return LazyPaginator<PageSource>(std::move(source), page_size);
+}
@@ -0,0 +1,180 @@
+#include "persistent_search_server.h"
+#include "binary_io.h"
+#include "corpus_reader.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const string_view SNAPSHOT_MAGIC = "SSNP"sv;
+const uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+
+void SyncPath(const string& path, int flags) {
+    const int fd = open(path.c_str(), flags);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть "s + path);
+    }
+    const int result = fsync(fd);
+    close(fd);
+    if (result != 0) {
+        throw runtime_error("Ошибка синхронизации "s + path);
+    }
+}
+
+void WriteFileDurably(const string& path, string_view data) {
+    const string temp_path = path + ".tmp"s;
+    const int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Не удалось создать файл "s + temp_path);
+    }
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            close(fd);
+            throw runtime_error("Ошибка записи файла "s + temp_path);
+        }
+        data.remove_prefix(written);
+    }
+    const int sync_result = fsync(fd);
+    close(fd);
+    if (sync_result != 0) {
+        throw runtime_error("Ошибка синхронизации файла "s + temp_path);
+    }
+    // переименование атомарно: после сбоя на месте файла либо старый снимок, либо новый целиком
+    filesystem::rename(temp_path, path);
+    SyncPath(filesystem::path(path).parent_path().string(), O_RDONLY | O_DIRECTORY);
+}
+
+} // namespace
+
+ostream& operator<<(ostream& out, const RecoveryStats& stats) {
+    out << "{ "s
+        << "snapshot_documents = "s << stats.snapshot_documents << ", "s
+        << "replayed_records = "s << stats.replayed_records << ", "s
+        << "discarded_bytes = "s << stats.discarded_bytes << ", "s
+        << "seconds = "s << stats.seconds << " }"s;
+    return out;
+}
+
+PersistentSearchServer::PersistentSearchServer(const string& directory, string_view stop_words, IndexOptions index_options,
+                                               PersistenceOptions options)
+        : PersistentSearchServer(directory, stop_words, index_options, options, chrono::steady_clock::now()) {
+}
+
+PersistentSearchServer::PersistentSearchServer(const string& directory, string_view stop_words, IndexOptions index_options,
+                                               PersistenceOptions options, chrono::steady_clock::time_point start_time)
+        : snapshot_path_((filesystem::path(directory) / "snapshot"s).string())
+        , wal_path_((filesystem::path(directory) / "wal"s).string())
+        , options_(options)
+        , search_server_(LoadSnapshotFile(stop_words, index_options)) {
+    const bool has_snapshot = filesystem::exists(snapshot_path_);
+    ReplayLog();
+    if (!has_snapshot) {
+        // снимок пустого индекса сохраняет стоп-слова и настройки до первой записи журнала
+        Checkpoint();
+    }
+    const chrono::duration<double> duration = chrono::steady_clock::now() - start_time;
+    recovery_stats_.seconds = duration.count();
+}
+
+SearchServer PersistentSearchServer::LoadSnapshotFile(string_view stop_words, IndexOptions index_options) {
+    if (!filesystem::exists(snapshot_path_)) {
+        filesystem::create_directories(filesystem::path(snapshot_path_).parent_path());
+        return SearchServer(stop_words, index_options);
+    }
+    const MappedFile file(snapshot_path_);
+    const string_view data = file.Data();
+    const size_t header_size = SNAPSHOT_MAGIC.size() + sizeof(uint32_t);
+    if (data.size() < header_size + sizeof(uint32_t) || data.substr(0, SNAPSHOT_MAGIC.size()) != SNAPSHOT_MAGIC) {
+        throw invalid_argument("Файл "s + snapshot_path_ + " не является снимком индекса"s);
+    }
+    const string_view body = data.substr(0, data.size() - sizeof(uint32_t));
+    if (ByteReader(data.substr(body.size())).ReadUint32() != ComputeCrc32(body)) {
+        throw invalid_argument("Повреждённый снимок индекса "s + snapshot_path_);
+    }
+
+    ByteReader in(body.substr(SNAPSHOT_MAGIC.size()));
+    if (in.ReadUint32() != SNAPSHOT_FORMAT_VERSION) {
+        throw invalid_argument("Неподдерживаемая версия снимка индекса "s + snapshot_path_);
+    }
+    last_lsn_ = in.ReadVarint();
+    SearchServer search_server = SearchServer::LoadSnapshot(in);
+    recovery_stats_.snapshot_documents = search_server.GetDocumentCount();
+    return search_server;
+}
+
+void PersistentSearchServer::ReplayLog() {
+    const WalContents contents = ReadWriteAheadLog(wal_path_);
+    for (const WalRecord& record : contents.records) {
+        // записи не новее снимка уже в нём: журнал мог не успеть очиститься после записи снимка
+        if (record.lsn <= last_lsn_) {
+            continue;
+        }
+        if (record.type == WalRecord::Type::ADD_DOCUMENT) {
+            search_server_.AddDocument(record.document_id, record.text, record.status, record.ratings);
+        } else {
+            search_server_.RemoveDocument(record.document_id);
+        }
+        last_lsn_ = record.lsn;
+        ++recovery_stats_.replayed_records;
+    }
+    records_since_checkpoint_ = contents.records.size();
+
+    wal_ = make_unique<WriteAheadLog>(wal_path_, options_.sync_every_records, options_.sync_interval);
+    const size_t file_size = filesystem::exists(wal_path_) ? filesystem::file_size(wal_path_) : 0;
+    if (file_size > contents.valid_size) {
+        // новые записи не должны оказаться за повреждённым хвостом
+        recovery_stats_.discarded_bytes = file_size - contents.valid_size;
+        wal_->Truncate(contents.valid_size);
+    }
+}
+
+void PersistentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    search_server_.AddDocument(document_id, document, status, ratings);
+    Log({0, WalRecord::Type::ADD_DOCUMENT, document_id, status, ratings, string(document)});
+}
+
+void PersistentSearchServer::RemoveDocument(int document_id) {
+    search_server_.RemoveDocument(document_id);
+    Log({0, WalRecord::Type::REMOVE_DOCUMENT, document_id, DocumentStatus::ACTUAL, {}, {}});
+}
+
+void PersistentSearchServer::Sync() {
+    wal_->Sync();
+}
+
+void PersistentSearchServer::Checkpoint() {
+    wal_->Sync();
+    ByteWriter out;
+    out.WriteBytes(SNAPSHOT_MAGIC);
+    out.WriteUint32(SNAPSHOT_FORMAT_VERSION);
+    out.WriteVarint(last_lsn_);
+    search_server_.SaveSnapshot(out);
+    out.WriteUint32(ComputeCrc32(out.Data()));
+    WriteFileDurably(snapshot_path_, out.Data());
+    wal_->Truncate(0);
+    records_since_checkpoint_ = 0;
+}
+
+const SearchServer& PersistentSearchServer::GetSearchServer() const {
+    return search_server_;
+}
+
+const RecoveryStats& PersistentSearchServer::GetRecoveryStats() const {
+    return recovery_stats_;
+}
+
+void PersistentSearchServer::Log(WalRecord record) {
+    record.lsn = ++last_lsn_;
+    wal_->Append(record);
+    ++records_since_checkpoint_;
+    if (options_.checkpoint_every_records > 0 && records_since_checkpoint_ >= options_.checkpoint_every_records) {
+        Checkpoint();
+    }
+}
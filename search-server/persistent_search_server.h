@@ -0,0 +1,103 @@
+#pragma once
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct PersistenceOptions {
+    // журнал сбрасывается на диск после стольких записей...
+    size_t sync_every_records = 256;
+    // ...или когда самая старая несброшенная запись ждёт столько времени, даже без новых записей
+    std::chrono::milliseconds sync_interval{10};
+    // снимок индекса записывается после стольких записей журнала; 0 - только по вызову Checkpoint
+    size_t checkpoint_every_records = 100'000;
+};
+
+struct RecoveryStats {
+    size_t snapshot_documents = 0;
+    size_t replayed_records = 0;
+    // отброшенный недописанный или повреждённый хвост журнала
+    size_t discarded_bytes = 0;
+    double seconds = 0.0;
+};
+
+std::ostream& operator<<(std::ostream& out, const RecoveryStats& stats);
+
+// Поисковый сервер, изменения которого переживают перезапуск. В каталоге хранятся снимок
+// индекса и журнал изменений после него. При открытии загружается снимок и применяются
+// только записи журнала с номерами больше номера снимка, поэтому сбой между записью снимка
+// и очисткой журнала не приводит к повторному применению. Изменение сначала проверяется и
+// применяется к индексу и только потом попадает в журнал: некорректные изменения в журнал
+// не пишутся. Изменение переживает сбой, когда его запись сброшена на диск (см. PersistenceOptions и Sync)
+class PersistentSearchServer {
+public:
+    // Стоп-слова и настройки индекса задают новый индекс. Если каталог уже содержит
+    // индекс, они берутся из его снимка
+    PersistentSearchServer(const std::string& directory, std::string_view stop_words, IndexOptions index_options = {},
+                           PersistenceOptions options = {});
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Как SearchServer::AddDocuments; при ошибке в журнал попадают документы, добавленные до неё
+    template <class ExecutionPolicy, typename DocumentContainer>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents);
+
+    void RemoveDocument(int document_id);
+
+    // Дожидается попадания на диск всех изменений
+    void Sync();
+
+    // Записывает снимок индекса (через временный файл и переименование) и очищает журнал
+    void Checkpoint();
+
+    const SearchServer& GetSearchServer() const;
+
+    const RecoveryStats& GetRecoveryStats() const;
+
+private:
+    const std::string snapshot_path_;
+    const std::string wal_path_;
+    const PersistenceOptions options_;
+    RecoveryStats recovery_stats_;
+    // номер последнего применённого изменения
+    uint64_t last_lsn_ = 0;
+    size_t records_since_checkpoint_ = 0;
+    SearchServer search_server_;
+    std::unique_ptr<WriteAheadLog> wal_;
+
+    PersistentSearchServer(const std::string& directory, std::string_view stop_words, IndexOptions index_options,
+                           PersistenceOptions options, std::chrono::steady_clock::time_point start_time);
+
+    SearchServer LoadSnapshotFile(std::string_view stop_words, IndexOptions index_options);
+
+    void ReplayLog();
+
+    void Log(WalRecord record);
+};
+
+template <class ExecutionPolicy, typename DocumentContainer>
+void PersistentSearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents) {
+    const int document_count = search_server_.GetDocumentCount();
+    const auto log_added = [this, &documents, document_count] {
+        // документы добавляются в порядке контейнера, поэтому добавленные - его начало
+        auto it_document = documents.begin();
+        for (int i = document_count; i < search_server_.GetDocumentCount(); ++i, ++it_document) {
+            Log({0, WalRecord::Type::ADD_DOCUMENT, it_document->id, it_document->status,
+                 std::vector<int>(it_document->ratings.begin(), it_document->ratings.end()), std::string(it_document->text)});
+        }
+    };
+    try {
+        search_server_.AddDocuments(policy, documents);
+    } catch (...) {
+        log_added();
+        throw;
+    }
+    log_added();
+}
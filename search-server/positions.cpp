@@ -0,0 +1,66 @@
+#include "positions.h"
+
+#include <algorithm>
+
+using namespace std;
+
+vector<uint8_t> EncodePositions(const vector<uint32_t>& positions) {
+    vector<uint8_t> result;
+    result.reserve(positions.size());
+    uint32_t previous = 0;
+    for (const uint32_t position : positions) {
+        uint32_t delta = position - previous;
+        previous = position;
+        while (delta >= 0x80) {
+            result.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        result.push_back(static_cast<uint8_t>(delta));
+    }
+    result.shrink_to_fit();
+    return result;
+}
+
+vector<uint32_t> DecodePositions(const vector<uint8_t>& encoded_positions) {
+    vector<uint32_t> result;
+    result.reserve(encoded_positions.size());
+    uint32_t position = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (const uint8_t byte : encoded_positions) {
+        delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += delta;
+        result.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+    return result;
+}
+
+bool MatchesPositions(const vector<vector<uint32_t>>& word_positions, int slop) {
+    if (word_positions.empty()) {
+        return true;
+    }
+    const int64_t max_span = static_cast<int64_t>(word_positions.size()) - 1 + slop;
+    for (const uint32_t first_position : word_positions.front()) {
+        // для каждого следующего слова берём ближайшую позицию правее текущей:
+        // так получается самое короткое окно, начинающееся с first_position
+        uint32_t current_position = first_position;
+        for (size_t i = 1; i < word_positions.size(); ++i) {
+            const auto it = upper_bound(word_positions[i].begin(), word_positions[i].end(), current_position);
+            if (it == word_positions[i].end()) {
+                // правее ни одного вхождения - более поздние начала тоже не подойдут
+                return false;
+            }
+            current_position = *it;
+        }
+        if (current_position - first_position <= max_span) {
+            return true;
+        }
+    }
+    return false;
+}
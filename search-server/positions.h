@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Позиции слова в документе хранятся сжато: разности соседних позиций
+// в кодировке переменной длины (7 бит на байт, старший бит - признак продолжения)
+std::vector<uint8_t> EncodePositions(const std::vector<uint32_t>& positions);
+
+std::vector<uint32_t> DecodePositions(const std::vector<uint8_t>& encoded_positions);
+
+// Проверяет, что слова встречаются в документе в заданном порядке и между первым и последним
+// из них не более slop посторонних слов. При slop == 0 слова должны идти подряд
+bool MatchesPositions(const std::vector<std::vector<uint32_t>>& word_positions, int slop);
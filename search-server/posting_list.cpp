@@ -0,0 +1,74 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+using namespace std;
+
+PostingList::PostingList(const PostingList& other, pmr::memory_resource* memory)
+        : document_ids_(other.document_ids_, memory)
+        , term_freqs_(other.term_freqs_, memory)
+        , term_freq_source_(other.term_freq_source_)
+        , term_id_(other.term_id_) {
+}
+
+PostingList::PostingList(const PostingList& other, pmr::memory_resource* memory,
+                         const TermFreqSource* term_freq_source, int term_id)
+        : document_ids_(other.document_ids_, memory)
+        , term_freqs_(memory)
+        , term_freq_source_(term_freq_source)
+        , term_id_(term_id) {
+}
+
+size_t PostingList::Advance(size_t from, int document_id) const {
+    const size_t count = document_ids_.size();
+    if (from >= count || document_ids_[from] >= document_id) {
+        return from;
+    }
+    // document_ids_[low] < document_id: ищем правую границу удвоением шага
+    size_t low = from;
+    size_t step = 1;
+    while (low + step < count && document_ids_[low + step] < document_id) {
+        low += step;
+        step *= 2;
+    }
+    const size_t high = min(low + step, count);
+    return lower_bound(document_ids_.begin() + low + 1, document_ids_.begin() + high, document_id) - document_ids_.begin();
+}
+
+size_t PostingList::Find(int document_id) const {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return document_ids_.size();
+    }
+    return it - document_ids_.begin();
+}
+
+bool PostingList::Contains(int document_id) const {
+    return binary_search(document_ids_.begin(), document_ids_.end(), document_id);
+}
+
+void PostingList::Add(int document_id, double term_freq) {
+    // документы обычно добавляются с возрастающими id - тогда вставка в конец
+    if (document_ids_.empty() || document_ids_.back() < document_id) {
+        document_ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+        return;
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const auto index = it - document_ids_.begin();
+    if (*it == document_id) {
+        term_freqs_[index] += term_freq;
+    } else {
+        document_ids_.insert(it, document_id);
+        term_freqs_.insert(term_freqs_.begin() + index, term_freq);
+    }
+}
+
+void PostingList::Erase(int document_id) {
+    const size_t index = Find(document_id);
+    if (index == document_ids_.size()) {
+        return;
+    }
+    document_ids_.erase(document_ids_.begin() + index);
+    term_freqs_.erase(term_freqs_.begin() + index);
+}
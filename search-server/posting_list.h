@@ -0,0 +1,186 @@
+#pragma once
+
+#include "document.h"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+struct Posting {
+    int document_id;
+    double term_freq;
+};
+
+// Частоты слов для списков без собственного массива частот: замороженный индекс
+// с квантованными вкладами берёт их из прямого индекса документов
+class TermFreqSource {
+public:
+    virtual ~TermFreqSource() = default;
+
+    // Документ должен содержать слово
+    virtual double TermFreq(int document_id, int term_id) const = 0;
+};
+
+// Список документов, содержащих слово, упорядоченный по возрастанию id.
+// id и частоты хранятся в отдельных массивах, чтобы поиск по id не тянул в кэш частоты
+class PostingList {
+public:
+    PostingList() = default;
+
+    // Копия списка, массивы которой выделены из memory
+    PostingList(const PostingList& other, std::pmr::memory_resource* memory);
+
+    // Копия только id документов; частоты слова term_id читаются из term_freq_source
+    PostingList(const PostingList& other, std::pmr::memory_resource* memory,
+                const TermFreqSource* term_freq_source, int term_id);
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Posting;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Posting;
+
+        Iterator(const PostingList* postings, size_t index)
+                : postings_(postings)
+                , index_(index) {
+        }
+
+        Posting operator*() const {
+            return {postings_->document_ids_[index_], postings_->TermFreq(index_)};
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const PostingList* postings_;
+        size_t index_;
+    };
+
+    Iterator begin() const {
+        return {this, 0};
+    }
+
+    Iterator end() const {
+        return {this, document_ids_.size()};
+    }
+
+    size_t size() const {
+        return document_ids_.size();
+    }
+
+    bool empty() const {
+        return document_ids_.empty();
+    }
+
+    int DocumentId(size_t index) const {
+        return document_ids_[index];
+    }
+
+    double TermFreq(size_t index) const {
+        if (term_freq_source_ != nullptr) {
+            return term_freq_source_->TermFreq(document_ids_[index], term_id_);
+        }
+        return term_freqs_[index];
+    }
+
+    // Индекс первого документа с id не меньше document_id, поиск начинается с позиции from.
+    // Шаг поиска удваивается, поэтому при последовательных вызовах с возрастающими id
+    // стоимость пропорциональна логарифму пропущенного расстояния
+    size_t Advance(size_t from, int document_id) const;
+
+    size_t Find(int document_id) const;
+
+    bool Contains(int document_id) const;
+
+    // Вставляет документ или увеличивает частоту уже добавленного
+    void Add(int document_id, double term_freq);
+
+    void Erase(int document_id);
+
+    // Память массивов списка по их ёмкости
+    size_t GetMemoryBytes() const {
+        return document_ids_.capacity() * sizeof(int) + term_freqs_.capacity() * sizeof(double);
+    }
+
+private:
+    std::pmr::vector<int> document_ids_;
+    std::pmr::vector<double> term_freqs_;
+    const TermFreqSource* term_freq_source_ = nullptr;
+    int term_id_ = 0;
+};
+
+// Списки документов слова, физически разделённые по статусу документа: запрос
+// с фильтром по статусу обходит только свою часть. Документ с данным статусом
+// находится только в соответствующей части
+class StatusPostings {
+public:
+    StatusPostings() = default;
+
+    StatusPostings(const StatusPostings& other, std::pmr::memory_resource* memory)
+            : StatusPostings(other, memory, std::make_index_sequence<DOCUMENT_STATUS_COUNT>()) {
+    }
+
+    StatusPostings(const StatusPostings& other, std::pmr::memory_resource* memory,
+                   const TermFreqSource* term_freq_source, int term_id)
+            : StatusPostings(other, memory, term_freq_source, term_id, std::make_index_sequence<DOCUMENT_STATUS_COUNT>()) {
+    }
+
+    const PostingList& Partition(DocumentStatus status) const {
+        return partitions_[static_cast<int>(status)];
+    }
+
+    PostingList& Partition(DocumentStatus status) {
+        return partitions_[static_cast<int>(status)];
+    }
+
+    // Число документов со словом во всех частях
+    size_t size() const {
+        size_t result = 0;
+        for (const PostingList& partition : partitions_) {
+            result += partition.size();
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t GetMemoryBytes() const {
+        size_t result = 0;
+        for (const PostingList& partition : partitions_) {
+            result += partition.GetMemoryBytes();
+        }
+        return result;
+    }
+
+private:
+    std::array<PostingList, DOCUMENT_STATUS_COUNT> partitions_;
+
+    template <size_t... Statuses>
+    StatusPostings(const StatusPostings& other, std::pmr::memory_resource* memory, std::index_sequence<Statuses...>)
+            : partitions_{PostingList(other.partitions_[Statuses], memory)...} {
+    }
+
+    template <size_t... Statuses>
+    StatusPostings(const StatusPostings& other, std::pmr::memory_resource* memory,
+                   const TermFreqSource* term_freq_source, int term_id, std::index_sequence<Statuses...>)
+            : partitions_{PostingList(other.partitions_[Statuses], memory, term_freq_source, term_id)...} {
+    }
+};
@@ -3,16 +3,31 @@
 
 #include <algorithm>
 #include <execution>
+#include <iterator>
 #include <string_view>
+#include <thread>
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
                                                   const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
+    // запросы делятся на куски по числу потоков; внутри куска списки документов
+    // общих слов обходятся один раз на все запросы куска
+    const size_t chunk_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), queries.size());
+    std::vector<std::vector<std::string_view>> chunks(chunk_count);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        chunks[i * chunk_count / queries.size()].push_back(queries[i]);
+    }
 
+    std::vector<std::vector<std::vector<Document>>> chunk_results(chunk_count);
     transform(std::execution::par,
-              queries.begin(), queries.end(),
-              result.begin(),
-              [&search_server](std::string_view query) { return search_server.FindTopDocuments(query); });
+              chunks.begin(), chunks.end(),
+              chunk_results.begin(),
+              [&search_server](const std::vector<std::string_view>& chunk) { return search_server.FindTopDocumentsBatch(chunk); });
+
+    std::vector<std::vector<Document>> result;
+    result.reserve(queries.size());
+    for (std::vector<std::vector<Document>>& documents : chunk_results) {
+        std::move(documents.begin(), documents.end(), std::back_inserter(result));
+    }
 
     return result;
 }
@@ -0,0 +1,61 @@
+#include "query_plan.h"
+
+using namespace std;
+
+string_view ToString(QueryStrategy strategy) {
+    switch (strategy) {
+        case QueryStrategy::PARALLEL:
+            return "parallel"sv;
+        case QueryStrategy::IMPACT_PRUNING:
+            return "impact pruning"sv;
+        case QueryStrategy::BITMAP:
+            return "bitmap"sv;
+        case QueryStrategy::INTERSECTION:
+            return "intersection"sv;
+        default:
+            return "sequential"sv;
+    }
+}
+
+namespace {
+
+string_view ToString(TermRole role) {
+    switch (role) {
+        case TermRole::MINUS:
+            return "minus"sv;
+        case TermRole::REQUIRED:
+            return "required"sv;
+        default:
+            return "plus"sv;
+    }
+}
+
+} // namespace
+
+ostream& operator<<(ostream& out, const QueryPlan& plan) {
+    out << "EXPLAIN "s << ToString(plan.strategy)
+        << " { documents = "s << plan.document_count
+        << ", plus_postings = "s << plan.plus_postings
+        << ", minus_postings = "s << plan.minus_postings
+        << ", reads_document_data = "s << (plan.reads_document_data ? "yes"s : "no"s)
+        << ", estimated_matches = "s << plan.estimated_matches
+        << ", estimated_cost = "s << plan.estimated_cost << " }"s;
+    for (const PlannedTerm& term : plan.terms) {
+        out << "\n  "s << ToString(term.role) << " "s << term.word << (term.is_expansion ? " (expansion)"s : ""s)
+            << ": "s << term.document_count << " documents"s;
+    }
+    out << "\n  alternatives:"s;
+    for (const auto& [strategy, cost] : plan.alternatives) {
+        out << " "s << ToString(strategy) << " = "s << cost;
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const QueryExplanation& explanation) {
+    return out << explanation.plan
+               << "\n  actual: posting_reads = "s << explanation.posting_reads
+               << " (estimated_cost = "s << explanation.plan.estimated_cost << ")"s
+               << ", scored_documents = "s << explanation.scored_documents
+               << ", results = "s << explanation.documents.size()
+               << ", elapsed = "s << explanation.elapsed.count() << " us"s;
+}
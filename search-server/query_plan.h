@@ -0,0 +1,74 @@
+#pragma once
+
+#include "document.h"
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Способ выполнения запроса, который выбирает планировщик (SearchServer::PlanQuery)
+enum class QueryStrategy {
+    SEQUENTIAL,      // обход всех списков плюс-слов в одном потоке
+    PARALLEL,        // списки плюс-слов обходятся параллельно, релевантность копится в общей таблице
+    IMPACT_PRUNING,  // квантованные вклады с пропуском блоков и точным пересчётом кандидатов
+    BITMAP,          // предикат и минус-слова вычисляются один раз на документ в битовую карту
+    INTERSECTION,    // обход самого короткого списка обязательных слов с проверкой остальных
+};
+
+std::string_view ToString(QueryStrategy strategy);
+
+// Стоимость выполнения оценивается в чтениях элементов списков документов.
+// Параллельный обход окупается только на больших списках
+const double PLANNER_PARALLEL_OVERHEAD = 50'000.0;
+// элемент квантованного списка занимает 5-6 байт против 12 и складывается без обращения к дереву
+const double PLANNER_IMPACT_POSTING_COST = 0.25;
+
+enum class TermRole {
+    PLUS,
+    MINUS,
+    REQUIRED,
+};
+
+// Слово запроса и число документов выбранных статусов, в которых оно встречается
+struct PlannedTerm {
+    std::string word;
+    TermRole role = TermRole::PLUS;
+    bool is_expansion = false;
+    size_t document_count = 0;
+};
+
+struct QueryPlan {
+    QueryStrategy strategy = QueryStrategy::SEQUENTIAL;
+    // слова по возрастанию числа документов: самые избирательные первыми
+    std::vector<PlannedTerm> terms;
+    size_t document_count = 0;
+    size_t plus_postings = 0;
+    size_t minus_postings = 0;
+    // предикату нужны рейтинг или статус документа для каждого элемента списков
+    bool reads_document_data = false;
+    size_t estimated_matches = 0;
+    double estimated_cost = 0.0;
+    // все рассмотренные способы и их оценки
+    std::vector<std::pair<QueryStrategy, double>> alternatives;
+};
+
+// Результат EXPLAIN: план, оценка и фактическое выполнение
+struct QueryExplanation {
+    QueryPlan plan;
+    std::vector<Document> documents;
+    // документы, для которых вычислена релевантность, до отбора лучших
+    size_t scored_documents = 0;
+    // фактически прочитанные элементы списков документов - для сравнения с plan.estimated_cost.
+    // Поиск документа в списке считается одним чтением, а элемент квантованного списка - целым,
+    // хотя в оценке он весит PLANNER_IMPACT_POSTING_COST
+    size_t posting_reads = 0;
+    std::chrono::microseconds elapsed{0};
+};
+
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan);
+
+std::ostream& operator<<(std::ostream& out, const QueryExplanation& explanation);
@@ -0,0 +1,151 @@
+#include "request_stats.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+double RequestWindowStats::NoResultRate() const {
+    return requests == 0 ? 0.0 : no_result_requests * 1.0 / requests;
+}
+
+ostream& operator<<(ostream& out, const RequestWindowStats& stats) {
+    out << "{ "s
+        << "requests = "s << stats.requests << ", "s
+        << "no_result_rate = "s << stats.NoResultRate() << ", "s
+        << "qps = "s << stats.queries_per_second << ", "s
+        << "p50 = "s << stats.latency_p50.count() << " us, "s
+        << "p90 = "s << stats.latency_p90.count() << " us, "s
+        << "p99 = "s << stats.latency_p99.count() << " us }"s;
+    return out;
+}
+
+void RequestStats::Record(chrono::microseconds latency, size_t result_count) {
+    Record(Clock::now(), latency, result_count);
+}
+
+void RequestStats::Record(Clock::time_point now, chrono::microseconds latency, size_t result_count) {
+    const int latency_bucket = GetLatencyBucket(latency);
+    RecordToTier(seconds_, now, latency_bucket, result_count > 0);
+    RecordToTier(minutes_, now, latency_bucket, result_count > 0);
+    RecordToTier(hours_, now, latency_bucket, result_count > 0);
+}
+
+RequestWindowStats RequestStats::GetStats(StatsWindow window) const {
+    return GetStats(window, Clock::now());
+}
+
+RequestWindowStats RequestStats::GetStats(StatsWindow window, Clock::time_point now) const {
+    switch (window) {
+        case StatsWindow::MINUTE:
+            return CollectTier(seconds_, now);
+        case StatsWindow::HOUR:
+            return CollectTier(minutes_, now);
+        case StatsWindow::DAY:
+            return CollectTier(hours_, now);
+    }
+    return {};
+}
+
+int RequestStats::GetLatencyBucket(chrono::microseconds latency) {
+    const uint64_t value = static_cast<uint64_t>(max<int64_t>(latency.count(), 0));
+    if (value < LATENCY_BUCKETS_PER_OCTAVE) {
+        return static_cast<int>(value);
+    }
+    // старший бит задаёт степень двойки, два следующих - корзину внутри неё
+    const int octave = 63 - __builtin_clzll(value);
+    if (octave >= LATENCY_OCTAVES) {
+        // всё, что длиннее последней степени двойки, попадает в последнюю корзину
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+    const int sub_bucket = static_cast<int>((value >> (octave - 2)) & (LATENCY_BUCKETS_PER_OCTAVE - 1));
+    return octave * LATENCY_BUCKETS_PER_OCTAVE + sub_bucket;
+}
+
+chrono::microseconds RequestStats::GetLatencyBucketBound(int latency_bucket) {
+    if (latency_bucket < LATENCY_BUCKETS_PER_OCTAVE) {
+        return chrono::microseconds(latency_bucket + 1);
+    }
+    const int octave = latency_bucket / LATENCY_BUCKETS_PER_OCTAVE;
+    const int sub_bucket = latency_bucket % LATENCY_BUCKETS_PER_OCTAVE;
+    return chrono::microseconds(static_cast<int64_t>(LATENCY_BUCKETS_PER_OCTAVE + sub_bucket + 1) << (octave - 2));
+}
+
+template <size_t BucketCount>
+void RequestStats::RecordToTier(Tier<BucketCount>& tier, Clock::time_point now, int latency_bucket, bool has_results) {
+    const uint64_t epoch = now.time_since_epoch() / tier.bucket_duration;
+    Bucket& bucket = tier.buckets[epoch % BucketCount];
+
+    uint64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+    while (bucket_epoch != epoch) {
+        if (bucket_epoch == RESETTING_EPOCH) {
+            // другой поток обнуляет корзину; счёт до публикации отрезка был бы стёрт
+            this_thread::yield();
+            bucket_epoch = bucket.epoch.load(memory_order_acquire);
+            continue;
+        }
+        if (bucket_epoch != EMPTY_EPOCH && bucket_epoch > epoch) {
+            // корзину уже занял более поздний отрезок - запрос слишком старый
+            return;
+        }
+        // корзина хранит устаревший отрезок: её обнуляет поток, выигравший обмен, и только
+        // потом публикует новый отрезок, чтобы остальные считали уже в обнулённые счётчики
+        if (bucket.epoch.compare_exchange_weak(bucket_epoch, RESETTING_EPOCH, memory_order_acquire)) {
+            bucket.requests.store(0, memory_order_relaxed);
+            bucket.no_result_requests.store(0, memory_order_relaxed);
+            for (auto& latency_count : bucket.latencies) {
+                latency_count.store(0, memory_order_relaxed);
+            }
+            bucket.epoch.store(epoch, memory_order_release);
+            break;
+        }
+    }
+
+    bucket.requests.fetch_add(1, memory_order_relaxed);
+    if (!has_results) {
+        bucket.no_result_requests.fetch_add(1, memory_order_relaxed);
+    }
+    bucket.latencies[latency_bucket].fetch_add(1, memory_order_relaxed);
+}
+
+template <size_t BucketCount>
+RequestWindowStats RequestStats::CollectTier(const Tier<BucketCount>& tier, Clock::time_point now) {
+    const uint64_t epoch = now.time_since_epoch() / tier.bucket_duration;
+    RequestWindowStats stats;
+    array<uint64_t, LATENCY_BUCKET_COUNT> latencies{};
+    for (const Bucket& bucket : tier.buckets) {
+        const uint64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+        // в окно входят текущий отрезок и BucketCount - 1 предыдущих; обнуляемая
+        // корзина (RESETTING_EPOCH больше любого отрезка) пропускается
+        if (bucket_epoch == EMPTY_EPOCH || bucket_epoch > epoch || epoch - bucket_epoch >= BucketCount) {
+            continue;
+        }
+        stats.requests += bucket.requests.load(memory_order_relaxed);
+        stats.no_result_requests += bucket.no_result_requests.load(memory_order_relaxed);
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            latencies[i] += bucket.latencies[i].load(memory_order_relaxed);
+        }
+    }
+
+    const chrono::duration<double> window_duration = tier.bucket_duration * BucketCount;
+    stats.queries_per_second = stats.requests / window_duration.count();
+
+    const auto percentile = [&latencies, &stats](uint64_t percent) {
+        // ранг запроса, время которого не меньше percent% остальных
+        const uint64_t rank = max<uint64_t>(1, (stats.requests * percent + 99) / 100);
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            seen += latencies[i];
+            if (seen >= rank) {
+                return GetLatencyBucketBound(i);
+            }
+        }
+        return chrono::microseconds(0);
+    };
+    if (stats.requests > 0) {
+        stats.latency_p50 = percentile(50);
+        stats.latency_p90 = percentile(90);
+        stats.latency_p99 = percentile(99);
+    }
+    return stats;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Окно, за которое собирается статистика запросов
+enum class StatsWindow {
+    MINUTE,
+    HOUR,
+    DAY,
+};
+
+// Статистика запросов за окно. Время ответа - верхняя граница корзины гистограммы,
+// поэтому процентили завышены не более чем на четверть
+struct RequestWindowStats {
+    uint64_t requests = 0;
+    uint64_t no_result_requests = 0;
+    double queries_per_second = 0.0;
+    std::chrono::microseconds latency_p50{0};
+    std::chrono::microseconds latency_p90{0};
+    std::chrono::microseconds latency_p99{0};
+
+    double NoResultRate() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const RequestWindowStats& stats);
+
+// Счётчик запросов по реальному монотонному времени. Хранит три кольца корзин:
+// 60 секундных, 60 минутных и 24 часовых, поэтому память не зависит от числа
+// запросов. Record можно вызывать из многих потоков одновременно: счётчики
+// атомарные, а корзину, у которой истекло время, обнуляет поток, который первым её
+// занял. Пока корзина обнуляется, остальные потоки ждут, поэтому запросы не теряются
+class RequestStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Record(std::chrono::microseconds latency, size_t result_count);
+
+    void Record(Clock::time_point now, std::chrono::microseconds latency, size_t result_count);
+
+    RequestWindowStats GetStats(StatsWindow window) const;
+
+    RequestWindowStats GetStats(StatsWindow window, Clock::time_point now) const;
+
+private:
+    // четыре корзины на каждую степень двойки микросекунд
+    static const int LATENCY_BUCKETS_PER_OCTAVE = 4;
+    static const int LATENCY_OCTAVES = 32;
+    static const int LATENCY_BUCKET_COUNT = LATENCY_BUCKETS_PER_OCTAVE * LATENCY_OCTAVES;
+    static const uint64_t EMPTY_EPOCH = UINT64_MAX;
+    // корзина обнуляется, её отрезок ещё не опубликован
+    static const uint64_t RESETTING_EPOCH = UINT64_MAX - 1;
+
+    struct Bucket {
+        // номер отрезка времени, который сейчас хранит корзина
+        std::atomic<uint64_t> epoch{EMPTY_EPOCH};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latencies{};
+    };
+
+    template <size_t BucketCount>
+    struct Tier {
+        std::chrono::seconds bucket_duration;
+        std::array<Bucket, BucketCount> buckets;
+    };
+
+    Tier<60> seconds_{std::chrono::seconds(1), {}};
+    Tier<60> minutes_{std::chrono::minutes(1), {}};
+    Tier<24> hours_{std::chrono::hours(1), {}};
+
+    static int GetLatencyBucket(std::chrono::microseconds latency);
+
+    static std::chrono::microseconds GetLatencyBucketBound(int latency_bucket);
+
+    template <size_t BucketCount>
+    static void RecordToTier(Tier<BucketCount>& tier, Clock::time_point now, int latency_bucket, bool has_results);
+
+    template <size_t BucketCount>
+    static RequestWindowStats CollectTier(const Tier<BucketCount>& tier, Clock::time_point now);
+};
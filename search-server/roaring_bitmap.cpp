@@ -0,0 +1,442 @@
+#include "roaring_bitmap.h"
+#include "impact_kernel.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ROARING_BITMAP_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Операция над двумя битовыми картами на месте; возвращает число единичных бит результата.
+// count кратно 4
+using WordsOperation = size_t (*)(uint64_t* words, const uint64_t* other, size_t count);
+
+size_t AndWordsScalar(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        words[i] &= other[i];
+        bit_count += __builtin_popcountll(words[i]);
+    }
+    return bit_count;
+}
+
+size_t OrWordsScalar(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        words[i] |= other[i];
+        bit_count += __builtin_popcountll(words[i]);
+    }
+    return bit_count;
+}
+
+size_t AndNotWordsScalar(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        words[i] &= ~other[i];
+        bit_count += __builtin_popcountll(words[i]);
+    }
+    return bit_count;
+}
+
+#ifdef ROARING_BITMAP_X86
+
+__attribute__((target("avx2,popcnt"))) size_t CountWordsAvx2(__m256i words) {
+    return _mm_popcnt_u64(_mm256_extract_epi64(words, 0)) + _mm_popcnt_u64(_mm256_extract_epi64(words, 1))
+           + _mm_popcnt_u64(_mm256_extract_epi64(words, 2)) + _mm_popcnt_u64(_mm256_extract_epi64(words, 3));
+}
+
+__attribute__((target("avx2,popcnt"))) size_t AndWordsAvx2(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; i += 4) {
+        auto* target = reinterpret_cast<__m256i*>(words + i);
+        const __m256i result = _mm256_and_si256(_mm256_loadu_si256(target),
+                                                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i)));
+        _mm256_storeu_si256(target, result);
+        bit_count += CountWordsAvx2(result);
+    }
+    return bit_count;
+}
+
+__attribute__((target("avx2,popcnt"))) size_t OrWordsAvx2(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; i += 4) {
+        auto* target = reinterpret_cast<__m256i*>(words + i);
+        const __m256i result = _mm256_or_si256(_mm256_loadu_si256(target),
+                                               _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i)));
+        _mm256_storeu_si256(target, result);
+        bit_count += CountWordsAvx2(result);
+    }
+    return bit_count;
+}
+
+// _mm256_andnot_si256(a, b) вычисляет ~a & b
+__attribute__((target("avx2,popcnt"))) size_t AndNotWordsAvx2(uint64_t* words, const uint64_t* other, size_t count) {
+    size_t bit_count = 0;
+    for (size_t i = 0; i < count; i += 4) {
+        auto* target = reinterpret_cast<__m256i*>(words + i);
+        const __m256i result = _mm256_andnot_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i)),
+                                                   _mm256_loadu_si256(target));
+        _mm256_storeu_si256(target, result);
+        bit_count += CountWordsAvx2(result);
+    }
+    return bit_count;
+}
+
+#endif
+
+struct WordsOperations {
+    WordsOperation and_words;
+    WordsOperation or_words;
+    WordsOperation and_not_words;
+};
+
+// Набор инструкций определяется один раз при первом обращении
+const WordsOperations& GetWordsOperations() {
+    static const WordsOperations operations = [] {
+#ifdef ROARING_BITMAP_X86
+        if (IsKernelIsaSupported(KernelIsa::AVX2)) {
+            return WordsOperations{AndWordsAvx2, OrWordsAvx2, AndNotWordsAvx2};
+        }
+#endif
+        return WordsOperations{AndWordsScalar, OrWordsScalar, AndNotWordsScalar};
+    }();
+    return operations;
+}
+
+bool TestBit(const pmr::vector<uint64_t>& words, uint16_t low) {
+    return words[low / 64] >> (low % 64) & 1;
+}
+
+} // namespace
+
+RoaringBitmap::RoaringBitmap(pmr::memory_resource* memory)
+        : memory_(memory)
+        , containers_(memory) {
+}
+
+RoaringBitmap::RoaringBitmap(const RoaringBitmap& other, pmr::memory_resource* memory)
+        : memory_(memory)
+        , containers_(memory) {
+    containers_.reserve(other.containers_.size());
+    for (const Container& container : other.containers_) {
+        containers_.push_back(CopyContainer(container));
+    }
+}
+
+RoaringBitmap::RoaringBitmap(const RoaringBitmap& other)
+        : RoaringBitmap(other, pmr::get_default_resource()) {
+}
+
+RoaringBitmap& RoaringBitmap::operator=(const RoaringBitmap& other) {
+    if (this != &other) {
+        RoaringBitmap copy(other, memory_);
+        containers_.swap(copy.containers_);
+    }
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator=(RoaringBitmap&& other) {
+    if (memory_ == other.memory_) {
+        containers_.swap(other.containers_);
+    } else {
+        *this = static_cast<const RoaringBitmap&>(other);
+    }
+    return *this;
+}
+
+void RoaringBitmap::Add(int document_id) {
+    if (document_id < 0) {
+        throw invalid_argument("Отрицательный id документа в множестве документов"s);
+    }
+    const uint16_t key = GetKey(document_id);
+    // множества обычно строятся по возрастанию id, и блок оказывается последним
+    auto it = containers_.end();
+    if (containers_.empty() || containers_.back().key < key) {
+        containers_.push_back(MakeContainer(key));
+        it = prev(containers_.end());
+    } else if (containers_.back().key == key) {
+        it = prev(containers_.end());
+    } else {
+        it = lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+            return container.key < key;
+        });
+        if (it->key != key) {
+            it = containers_.insert(it, MakeContainer(key));
+        }
+    }
+
+    Container& container = *it;
+    const uint16_t low = GetLow(document_id);
+    if (container.IsBitmap()) {
+        uint64_t& word = container.words[low / BITS_PER_WORD];
+        const uint64_t bit = uint64_t{1} << (low % BITS_PER_WORD);
+        container.cardinality += (word & bit) == 0;
+        word |= bit;
+        return;
+    }
+    if (container.values.empty() || container.values.back() < low) {
+        container.values.push_back(low);
+    } else {
+        const auto position = lower_bound(container.values.begin(), container.values.end(), low);
+        if (*position == low) {
+            return;
+        }
+        container.values.insert(position, low);
+    }
+    ++container.cardinality;
+    Normalize(container);
+}
+
+bool RoaringBitmap::Remove(int document_id) {
+    if (document_id < 0) {
+        return false;
+    }
+    const uint16_t key = GetKey(document_id);
+    const auto it = lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+        return container.key < key;
+    });
+    if (it == containers_.end() || it->key != key) {
+        return false;
+    }
+
+    Container& container = *it;
+    const uint16_t low = GetLow(document_id);
+    if (container.IsBitmap()) {
+        uint64_t& word = container.words[low / BITS_PER_WORD];
+        const uint64_t bit = uint64_t{1} << (low % BITS_PER_WORD);
+        if ((word & bit) == 0) {
+            return false;
+        }
+        word &= ~bit;
+    } else {
+        const auto position = lower_bound(container.values.begin(), container.values.end(), low);
+        if (position == container.values.end() || *position != low) {
+            return false;
+        }
+        container.values.erase(position);
+    }
+    --container.cardinality;
+    if (container.cardinality == 0) {
+        containers_.erase(it);
+    } else {
+        Normalize(container);
+    }
+    return true;
+}
+
+size_t RoaringBitmap::Cardinality() const {
+    size_t cardinality = 0;
+    for (const Container& container : containers_) {
+        cardinality += container.cardinality;
+    }
+    return cardinality;
+}
+
+void RoaringBitmap::Clear() {
+    containers_.clear();
+}
+
+void RoaringBitmap::And(const RoaringBitmap& other) {
+    auto it_other = other.containers_.begin();
+    for (Container& container : containers_) {
+        while (it_other != other.containers_.end() && it_other->key < container.key) {
+            ++it_other;
+        }
+        if (it_other == other.containers_.end() || it_other->key != container.key) {
+            container.cardinality = 0;
+            continue;
+        }
+        const Container& other_container = *it_other;
+        if (container.IsBitmap() && other_container.IsBitmap()) {
+            container.cardinality = GetWordsOperations().and_words(container.words.data(), other_container.words.data(), BLOCK_WORD_COUNT);
+        } else if (container.IsBitmap()) {
+            // пересечение не больше массива другого блока
+            container.values.clear();
+            for (const uint16_t low : other_container.values) {
+                if (TestBit(container.words, low)) {
+                    container.values.push_back(low);
+                }
+            }
+            container.words.clear();
+            container.words.shrink_to_fit();
+            container.cardinality = container.values.size();
+        } else if (other_container.IsBitmap()) {
+            container.values.erase(remove_if(container.values.begin(), container.values.end(),
+                                             [&other_container](uint16_t low) {
+                                                 return !TestBit(other_container.words, low);
+                                             }),
+                                   container.values.end());
+            container.cardinality = container.values.size();
+        } else {
+            const auto last = set_intersection(container.values.begin(), container.values.end(),
+                                               other_container.values.begin(), other_container.values.end(),
+                                               container.values.begin());
+            container.values.erase(last, container.values.end());
+            container.cardinality = container.values.size();
+        }
+        Normalize(container);
+    }
+    RemoveEmptyContainers();
+}
+
+void RoaringBitmap::Or(const RoaringBitmap& other) {
+    pmr::vector<Container> result(memory_);
+    result.reserve(containers_.size() + other.containers_.size());
+    auto it = containers_.begin();
+    auto it_other = other.containers_.begin();
+    while (it != containers_.end() || it_other != other.containers_.end()) {
+        if (it_other == other.containers_.end() || (it != containers_.end() && it->key < it_other->key)) {
+            result.push_back(move(*it++));
+            continue;
+        }
+        if (it == containers_.end() || it_other->key < it->key) {
+            result.push_back(CopyContainer(*it_other++));
+            continue;
+        }
+
+        Container& container = *it;
+        const Container& other_container = *it_other;
+        if (!container.IsBitmap() && !other_container.IsBitmap()) {
+            pmr::vector<uint16_t> values(memory_);
+            values.reserve(container.values.size() + other_container.values.size());
+            set_union(container.values.begin(), container.values.end(),
+                      other_container.values.begin(), other_container.values.end(),
+                      back_inserter(values));
+            container.values.swap(values);
+            container.cardinality = container.values.size();
+        } else {
+            if (!container.IsBitmap()) {
+                container.words.assign(BLOCK_WORD_COUNT, 0);
+                for (const uint16_t low : container.values) {
+                    container.words[low / BITS_PER_WORD] |= uint64_t{1} << (low % BITS_PER_WORD);
+                }
+                container.values.clear();
+                container.values.shrink_to_fit();
+            }
+            if (other_container.IsBitmap()) {
+                container.cardinality = GetWordsOperations().or_words(container.words.data(), other_container.words.data(), BLOCK_WORD_COUNT);
+            } else {
+                for (const uint16_t low : other_container.values) {
+                    uint64_t& word = container.words[low / BITS_PER_WORD];
+                    const uint64_t bit = uint64_t{1} << (low % BITS_PER_WORD);
+                    container.cardinality += (word & bit) == 0;
+                    word |= bit;
+                }
+            }
+        }
+        Normalize(container);
+        result.push_back(move(container));
+        ++it;
+        ++it_other;
+    }
+    containers_.swap(result);
+}
+
+void RoaringBitmap::AndNot(const RoaringBitmap& other) {
+    auto it_other = other.containers_.begin();
+    for (Container& container : containers_) {
+        while (it_other != other.containers_.end() && it_other->key < container.key) {
+            ++it_other;
+        }
+        if (it_other == other.containers_.end() || it_other->key != container.key) {
+            continue;
+        }
+        const Container& other_container = *it_other;
+        if (container.IsBitmap() && other_container.IsBitmap()) {
+            container.cardinality = GetWordsOperations().and_not_words(container.words.data(), other_container.words.data(), BLOCK_WORD_COUNT);
+        } else if (container.IsBitmap()) {
+            for (const uint16_t low : other_container.values) {
+                uint64_t& word = container.words[low / BITS_PER_WORD];
+                const uint64_t bit = uint64_t{1} << (low % BITS_PER_WORD);
+                container.cardinality -= (word & bit) != 0;
+                word &= ~bit;
+            }
+        } else if (other_container.IsBitmap()) {
+            container.values.erase(remove_if(container.values.begin(), container.values.end(),
+                                             [&other_container](uint16_t low) {
+                                                 return TestBit(other_container.words, low);
+                                             }),
+                                   container.values.end());
+            container.cardinality = container.values.size();
+        } else {
+            const auto last = set_difference(container.values.begin(), container.values.end(),
+                                             other_container.values.begin(), other_container.values.end(),
+                                             container.values.begin());
+            container.values.erase(last, container.values.end());
+            container.cardinality = container.values.size();
+        }
+        Normalize(container);
+    }
+    RemoveEmptyContainers();
+}
+
+vector<int> RoaringBitmap::ToVector() const {
+    vector<int> document_ids;
+    document_ids.reserve(Cardinality());
+    ForEach([&document_ids](int document_id) {
+        document_ids.push_back(document_id);
+    });
+    return document_ids;
+}
+
+size_t RoaringBitmap::GetMemoryBytes() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& other) const {
+    // вид блока однозначно определяется числом документов в нём
+    return equal(containers_.begin(), containers_.end(), other.containers_.begin(), other.containers_.end(),
+                 [](const Container& lhs, const Container& rhs) {
+                     return lhs.key == rhs.key && lhs.cardinality == rhs.cardinality
+                            && lhs.values == rhs.values && lhs.words == rhs.words;
+                 });
+}
+
+RoaringBitmap::Container RoaringBitmap::MakeContainer(uint16_t key) const {
+    return {key, 0, pmr::vector<uint16_t>(memory_), pmr::vector<uint64_t>(memory_)};
+}
+
+RoaringBitmap::Container RoaringBitmap::CopyContainer(const Container& other) const {
+    return {other.key, other.cardinality, pmr::vector<uint16_t>(other.values, memory_),
+            pmr::vector<uint64_t>(other.words, memory_)};
+}
+
+void RoaringBitmap::Normalize(Container& container) {
+    if (!container.IsBitmap() && container.cardinality > ARRAY_MAX_SIZE) {
+        container.words.assign(BLOCK_WORD_COUNT, 0);
+        for (const uint16_t low : container.values) {
+            container.words[low / BITS_PER_WORD] |= uint64_t{1} << (low % BITS_PER_WORD);
+        }
+        container.values.clear();
+        container.values.shrink_to_fit();
+    } else if (container.IsBitmap() && container.cardinality <= ARRAY_MAX_SIZE) {
+        container.values.clear();
+        container.values.reserve(container.cardinality);
+        for (size_t i = 0; i < BLOCK_WORD_COUNT; ++i) {
+            for (uint64_t word = container.words[i]; word != 0; word &= word - 1) {
+                container.values.push_back(static_cast<uint16_t>(i * BITS_PER_WORD + __builtin_ctzll(word)));
+            }
+        }
+        container.words.clear();
+        container.words.shrink_to_fit();
+    }
+}
+
+void RoaringBitmap::RemoveEmptyContainers() {
+    containers_.erase(remove_if(containers_.begin(), containers_.end(),
+                                [](const Container& container) {
+                                    return container.cardinality == 0;
+                                }),
+                      containers_.end());
+}
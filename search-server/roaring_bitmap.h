@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Сжатое множество документов в духе Roaring: id делятся на блоки по старшим 16 битам.
+// Блок хранит младшие 16 бит отсортированным массивом, пока в нём не больше
+// ARRAY_MAX_SIZE документов, и битовой картой на 65536 бит, когда больше.
+// Поэтому редкое множество занимает 2 байта на документ, а плотное - бит. Проверка
+// принадлежности - поиск блока и двоичный поиск в массиве или сдвиг с маской.
+// Пересечение, объединение и разность двух битовых карт выполняются векторными
+// инструкциями, если процессор их поддерживает. id документов неотрицательны
+class RoaringBitmap {
+public:
+    explicit RoaringBitmap(std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    // Копия в памяти memory
+    RoaringBitmap(const RoaringBitmap& other, std::pmr::memory_resource* memory);
+
+    // Копия, как и у контейнеров pmr, размещается в памяти по умолчанию
+    RoaringBitmap(const RoaringBitmap& other);
+
+    RoaringBitmap(RoaringBitmap&& other) = default;
+
+    // Присваивание не меняет память, в которой размещено множество
+    RoaringBitmap& operator=(const RoaringBitmap& other);
+
+    RoaringBitmap& operator=(RoaringBitmap&& other);
+
+    // Бросает std::invalid_argument для отрицательного id
+    void Add(int document_id);
+
+    // false, если документа в множестве не было
+    bool Remove(int document_id);
+
+    bool Contains(int document_id) const {
+        if (document_id < 0) {
+            return false;
+        }
+        const Container* container = FindContainer(GetKey(document_id));
+        if (container == nullptr) {
+            return false;
+        }
+        const uint16_t low = GetLow(document_id);
+        if (container->IsBitmap()) {
+            return container->words[low / BITS_PER_WORD] >> (low % BITS_PER_WORD) & 1;
+        }
+        return std::binary_search(container->values.begin(), container->values.end(), low);
+    }
+
+    size_t Cardinality() const;
+
+    bool Empty() const {
+        return containers_.empty();
+    }
+
+    void Clear();
+
+    // Операции на месте: пересечение, объединение и разность с other
+    void And(const RoaringBitmap& other);
+
+    void Or(const RoaringBitmap& other);
+
+    void AndNot(const RoaringBitmap& other);
+
+    // Вызывает function(document_id) для документов множества по возрастанию id
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    std::vector<int> ToVector() const;
+
+    size_t GetMemoryBytes() const;
+
+    bool operator==(const RoaringBitmap& other) const;
+
+    bool operator!=(const RoaringBitmap& other) const {
+        return !(*this == other);
+    }
+
+    // в блоке с большим числом документов битовая карта (8 КБ) не больше массива
+    static const size_t ARRAY_MAX_SIZE = 4096;
+
+private:
+    static const int BITS_PER_WORD = 64;
+    static const size_t BLOCK_WORD_COUNT = 65536 / BITS_PER_WORD;
+
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality;
+        // младшие 16 бит по возрастанию, если words пуст
+        std::pmr::vector<uint16_t> values;
+        std::pmr::vector<uint64_t> words;
+
+        bool IsBitmap() const {
+            return !words.empty();
+        }
+    };
+
+    std::pmr::memory_resource* memory_;
+    // блоки по возрастанию старших бит; пустых блоков нет
+    std::pmr::vector<Container> containers_;
+
+    static uint16_t GetKey(int document_id) {
+        return static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+    }
+
+    static uint16_t GetLow(int document_id) {
+        return static_cast<uint16_t>(document_id & 0xFFFF);
+    }
+
+    const Container* FindContainer(uint16_t key) const {
+        const auto it = std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+            return container.key < key;
+        });
+        return it == containers_.end() || it->key != key ? nullptr : &*it;
+    }
+
+    Container MakeContainer(uint16_t key) const;
+
+    Container CopyContainer(const Container& other) const;
+
+    // Массив становится битовой картой, если документов больше ARRAY_MAX_SIZE, и наоборот
+    static void Normalize(Container& container);
+
+    void RemoveEmptyContainers();
+};
+
+template <typename Function>
+void RoaringBitmap::ForEach(Function function) const {
+    for (const Container& container : containers_) {
+        const int high = static_cast<int>(container.key) << 16;
+        if (!container.IsBitmap()) {
+            for (const uint16_t low : container.values) {
+                function(high | low);
+            }
+            continue;
+        }
+        for (size_t i = 0; i < BLOCK_WORD_COUNT; ++i) {
+            for (uint64_t word = container.words[i]; word != 0; word &= word - 1) {
+                function(high | static_cast<int>(i * BITS_PER_WORD + __builtin_ctzll(word)));
+            }
+        }
+    }
+}
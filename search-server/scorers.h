@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// Характеристики коллекции документов, нужные для вычисления релевантности
+struct CollectionStats {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// Политики ранжирования передаются в FindTopDocuments параметром шаблона:
+// TermWeight вычисляется один раз на слово запроса, Score - для каждой пары (слово, документ).
+// Если USES_DOCUMENT_LENGTH == false, в Score вместо длины документа передаётся 0.
+// term_freq - доля слова среди слов документа, document_length - число слов документа без стоп-слов
+
+// Классический TF-IDF
+struct TfIdfScorer {
+    // длина документа не нужна - при обходе списков можно не читать данные документа
+    static constexpr bool USES_DOCUMENT_LENGTH = false;
+
+    static double TermWeight(const CollectionStats& stats, size_t document_freq) {
+        return std::log(stats.document_count * 1.0 / document_freq);
+    }
+
+    static double Score(double term_freq, double term_weight, int /*document_length*/, const CollectionStats& /*stats*/) {
+        return term_freq * term_weight;
+    }
+};
+
+// Okapi BM25 с параметрами k1 = 1.2 и b = 0.75
+struct Bm25Scorer {
+    static constexpr bool USES_DOCUMENT_LENGTH = true;
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    static double TermWeight(const CollectionStats& stats, size_t document_freq) {
+        return std::log(1.0 + (stats.document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    static double Score(double term_freq, double term_weight, int document_length, const CollectionStats& stats) {
+        const double term_count = term_freq * document_length;
+        const double length_norm = K1 * (1.0 - B + B * document_length / stats.average_document_length);
+        return term_weight * term_count * (K1 + 1.0) / (term_count + length_norm);
+    }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Результаты запроса, выдаваемые страницами по курсору - последнему выданному документу.
+// Каждая страница выбирается из найденных документов заново, поэтому глубокая страница
+// не требует сортировки всех совпадений и хранения предыдущих страниц. Подходит как
+// источник страниц для PaginateLazily
+template <typename Scorer = TfIdfScorer>
+class SearchResultStream {
+public:
+    SearchResultStream(const SearchServer& search_server, std::string_view raw_query,
+                       DocumentStatus status = DocumentStatus::ACTUAL, QueryMode mode = QueryMode::ANY_WORD)
+            : search_server_(&search_server)
+            , query_(search_server.PrepareQuery(raw_query, mode))
+            , status_(status) {
+    }
+
+    std::vector<Document> NextPage(size_t page_size) {
+        std::vector<Document> page = search_server_->template FindTopDocumentsAfter<Scorer>(query_, cursor_, page_size, status_);
+        if (!page.empty()) {
+            cursor_ = page.back();
+        }
+        return page;
+    }
+
+    // Пропускает count документов, например чтобы сразу перейти к странице с номером N
+    void Skip(size_t count) {
+        if (count > 0) {
+            NextPage(count);
+        }
+    }
+
+    const std::optional<Document>& GetCursor() const {
+        return cursor_;
+    }
+
+private:
+    const SearchServer* search_server_;
+    SearchServer::PreparedQuery query_;
+    DocumentStatus status_;
+    std::optional<Document> cursor_;
+};
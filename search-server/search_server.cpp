@@ -1,70 +1,225 @@
 #include "search_server.h"
+#include "impact_kernel.h"
 
 #include <cmath>
+#include <functional>
+#include <limits>
 
 using namespace std;
 
-SearchServer::SearchServer(string_view view_stop_words_text)
-        : SearchServer(SplitIntoWordsView(view_stop_words_text)) {}
+SearchServer::SearchServer(string_view view_stop_words_text, IndexOptions options)
+        : SearchServer(SplitIntoWordsView(view_stop_words_text), options) {}
 
-SearchServer::SearchServer(const string& string_stop_words_text)
-        : SearchServer(SearchServer(string_view(string_stop_words_text))) {}
+SearchServer::SearchServer(const string& string_stop_words_text, IndexOptions options)
+        : SearchServer(SearchServer(string_view(string_stop_words_text), options)) {}
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    CheckMutable();
+    CheckNewDocumentId(document_id);
+    AddDocumentWords(document_id, document, SplitIntoWordsViewNoStop(document), status, ratings);
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw invalid_argument("Недопустимый id документа"s);
     }
-    const auto words = SplitIntoWordsViewNoStop(document);
+}
+
+void SearchServer::CheckMutable() const {
+    if (frozen_index_) {
+        throw logic_error("Индекс заморожен и не может изменяться"s);
+    }
+}
+
+void SearchServer::AddDocumentWords(int document_id, string_view text, const vector<string_view>& words,
+                                    DocumentStatus status, const vector<int>& ratings) {
     const double inv_word_count = 1.0 / words.size();
-    for (string_view word : words) {
-        auto it_word = (dictionary_.emplace(string{word.begin(), word.end()})).first;
+    map<string_view, vector<uint32_t>> word_positions;
+    vector<TermFrequency> word_freqs;
+    word_freqs.reserve(words.size());
+    for (size_t position = 0; position < words.size(); ++position) {
+        const string_view word = words[position];
+        // строка копируется в словарь только при первом появлении слова
+        auto it_word = dictionary_.find(word);
+        if (it_word == dictionary_.end()) {
+            it_word = dictionary_.emplace(word, static_cast<int>(terms_.size())).first;
+            terms_.push_back(it_word->first);
+        }
 
-        word_to_document_freqs_[*it_word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][*it_word] += inv_word_count;
+        word_freqs.push_back({it_word->second, inv_word_count});
+        if (options_.store_positions) {
+            word_positions[it_word->first].push_back(position);
+        }
+    }
+    // повторы слова сливаются в одну запись, чтобы вставлять в каждый список по одному разу
+    stable_sort(word_freqs.begin(), word_freqs.end(),
+                [](const TermFrequency& lhs, const TermFrequency& rhs) { return lhs.term_id < rhs.term_id; });
+    size_t unique_count = 0;
+    for (const TermFrequency& entry : word_freqs) {
+        if (unique_count > 0 && word_freqs[unique_count - 1].term_id == entry.term_id) {
+            word_freqs[unique_count - 1].freq += entry.freq;
+        } else {
+            word_freqs[unique_count++] = entry;
+        }
+    }
+    word_freqs.resize(unique_count);
+    word_freqs.shrink_to_fit();
+
+    for (const auto& [term_id, freq] : word_freqs) {
+        word_to_document_freqs_[terms_[term_id]].Partition(status).Add(document_id, freq);
+    }
+    for (const auto& [word, positions] : word_positions) {
+        word_to_document_positions_[word][document_id] = EncodePositions(positions);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    if (options_.store_documents) {
+        document_store_.Add(document_id, text);
+    }
+    const int rating = ComputeAverageRating(ratings);
+    documents_.emplace(document_id, DocumentData{rating, status, static_cast<int>(words.size()), move(word_freqs)});
+    rating_index_.emplace(rating, document_id);
+    status_documents_[static_cast<int>(status)].Add(document_id);
+    total_word_count_ += words.size();
     document_ids_.insert(document_id);
+    ++index_version_;
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus input_status) const {
-    return FindTopDocuments(execution::seq, raw_query,
-                            [input_status](int document_id, DocumentStatus status, int rating) { return status == input_status; });
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries) const {
+    vector<vector<Document>> results(raw_queries.size());
+    // запросы, которые исполняются общим обходом, и их исключённые документы
+    vector<size_t> batched_queries;
+    vector<RoaringBitmap> excluded_documents;
+    // слова обходятся в алфавитном порядке, поэтому слагаемые релевантности каждого
+    // запроса складываются в том же порядке, что и в FindTopDocuments
+    map<string_view, pair<const StatusPostings*, vector<size_t>>> word_to_queries;
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        const Query query = ParseQuery(raw_queries[i]);
+        if (!query.phrases.empty() || !query.required_words.empty()) {
+            // фразы и обязательные слова проверяются по документам, а не по словам
+            results[i] = FindTopDocuments(raw_queries[i]);
+            continue;
+        }
+        for (const QueryTerm& term : query.plus_words) {
+            if (term.postings != nullptr) {
+                auto& [postings, query_slots] = word_to_queries[term.word];
+                postings = term.postings;
+                query_slots.push_back(batched_queries.size());
+            }
+        }
+        batched_queries.push_back(i);
+        excluded_documents.push_back(BuildExclusionBitmap(query, DocumentStatus::ACTUAL));
+    }
+
+    // Накопители релевантности: строка на запрос группы, в строке ячейка на актуальный
+    // документ по порядку id. Память потока переиспользуется между пакетами, после
+    // группы обнуляются только затронутые ячейки
+    thread_local vector<int> actual_document_ids;
+    thread_local vector<double> relevance;
+    thread_local vector<bool> is_touched;
+    thread_local vector<vector<uint32_t>> touched_ordinals;
+    actual_document_ids.clear();
+    GetStatusDocuments(DocumentStatus::ACTUAL).ForEach([](int document_id) { actual_document_ids.push_back(document_id); });
+    const size_t row_size = max<size_t>(actual_document_ids.size(), 1);
+    const size_t group_size = min(max<size_t>(MAX_BATCH_ACCUMULATORS / row_size, 1), batched_queries.size());
+    if (relevance.size() < group_size * row_size) {
+        relevance.resize(group_size * row_size);
+        is_touched.resize(group_size * row_size);
+    }
+    if (touched_ordinals.size() < group_size) {
+        touched_ordinals.resize(group_size);
+    }
+
+    const CollectionStats stats = GetCollectionStats();
+    for (size_t group_begin = 0; group_begin < batched_queries.size(); group_begin += group_size) {
+        const size_t group_end = min(group_begin + group_size, batched_queries.size());
+        for (const auto& [word, term_queries] : word_to_queries) {
+            const auto& [postings, query_slots] = term_queries;
+            // номера запросов слова возрастают, запросы группы идут подряд
+            const auto slots_begin = lower_bound(query_slots.begin(), query_slots.end(), group_begin);
+            const auto slots_end = lower_bound(slots_begin, query_slots.end(), group_end);
+            if (slots_begin == slots_end) {
+                continue;
+            }
+            const double term_weight = TfIdfScorer::TermWeight(stats, postings->size());
+            // список упорядочен по id, поэтому номер следующего документа ищется правее предыдущего
+            auto ordinal_it = actual_document_ids.begin();
+            for (const auto& [document_id, term_freq] : postings->Partition(DocumentStatus::ACTUAL)) {
+                ordinal_it = lower_bound(ordinal_it, actual_document_ids.end(), document_id);
+                const auto ordinal = static_cast<uint32_t>(ordinal_it - actual_document_ids.begin());
+                const double score = TfIdfScorer::Score(term_freq, term_weight, 0, stats);
+                for (auto slot_it = slots_begin; slot_it != slots_end; ++slot_it) {
+                    const size_t row = *slot_it - group_begin;
+                    const size_t cell = row * row_size + ordinal;
+                    if (!is_touched[cell]) {
+                        is_touched[cell] = true;
+                        touched_ordinals[row].push_back(ordinal);
+                    }
+                    relevance[cell] += score;
+                }
+            }
+        }
+
+        for (size_t slot = group_begin; slot < group_end; ++slot) {
+            const size_t row = slot - group_begin;
+            vector<uint32_t>& ordinals = touched_ordinals[row];
+            sort(ordinals.begin(), ordinals.end());
+            vector<Document>& matched_documents = results[batched_queries[slot]];
+            matched_documents.reserve(ordinals.size());
+            for (const uint32_t ordinal : ordinals) {
+                const size_t cell = row * row_size + ordinal;
+                const int document_id = actual_document_ids[ordinal];
+                // минус-слова проверяются один раз на документ, а не на каждое его слово
+                if (!excluded_documents[slot].Contains(document_id)) {
+                    matched_documents.push_back({document_id, relevance[cell], GetDocumentAttributes(document_id).rating});
+                }
+                relevance[cell] = 0.0;
+                is_touched[cell] = false;
+            }
+            ordinals.clear();
+            SelectTopDocuments(execution::seq, matched_documents);
+        }
+    }
+    return results;
 }
 
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+const RoaringBitmap& SearchServer::GetStatusDocuments(DocumentStatus status) const {
+    return status_documents_[static_cast<int>(status)];
+}
+
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&,
                                                                        string_view raw_query, int document_id) const {
     if (!document_ids_.count(document_id)) {
         throw out_of_range("Недопустимый id документа MatchDocument"s);
     }
 
-    const auto query = ParseQuery(raw_query, true);
+    const auto query = ParseQuery(raw_query);
+    const DocumentStatus status = GetDocumentAttributes(document_id).status;
 
-    for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {vector<string_view>{}, documents_.at(document_id).status};
-        }
+    const auto has_word = [document_id, status](const QueryTerm& term) {
+        return term.postings != nullptr && term.postings->Partition(status).Contains(document_id);
+    };
+    if (any_of(query.minus_words.begin(), query.minus_words.end(), has_word)
+        || !all_of(query.required_words.begin(), query.required_words.end(), has_word)
+        || !MatchesPhrases(query, document_id)) {
+        return {vector<string_view>{}, status};
     }
 
-    vector<string_view> matched_words(query.plus_words.size());
-    auto it = copy_if(execution::par,
-                      query.plus_words.begin(), query.plus_words.end(),
-                      matched_words.begin(),
-                      [this, document_id](string_view word) {
-                                return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-                            });
-
-    sort(execution::par, matched_words.begin(), it);
-    auto last = unique(execution::par, matched_words.begin(), it);
-    matched_words.resize(distance(matched_words.begin(), last));
+    // слова запроса уже без повторов и по алфавиту, найденные ссылаются на словарь сервера
+    vector<QueryTerm> matched_terms(query.plus_words.size());
+    const auto it = copy_if(execution::par,
+                            query.plus_words.begin(), query.plus_words.end(),
+                            matched_terms.begin(),
+                            has_word);
+    vector<string_view> matched_words(distance(matched_terms.begin(), it));
+    transform(execution::par,
+              matched_terms.begin(), it,
+              matched_words.begin(),
+              [](const QueryTerm& term) { return term.word; });
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&,
@@ -72,89 +227,393 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const exe
     if (!document_ids_.count(document_id)) {
         throw out_of_range("Недопустимый id документа MatchDocument"s);
     }
+    return MatchQuery(ParseQuery(raw_query), document_id);
+}
 
-    const auto query = ParseQuery(raw_query);
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& prepared_query, int document_id) const {
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Недопустимый id документа MatchDocument"s);
+    }
+    optional<Query> refreshed_query;
+    return MatchQuery(GetCurrentQuery(prepared_query, refreshed_query), document_id);
+}
 
-    for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQuery(const Query& query, int document_id) const {
+    const DocumentStatus status = GetDocumentAttributes(document_id).status;
+    const auto has_word = [document_id, status](const QueryTerm& term) {
+        return term.postings != nullptr && term.postings->Partition(status).Contains(document_id);
+    };
+
+    for (const QueryTerm& term : query.minus_words) {
+        if (has_word(term)) {
+            return {vector<string_view>{}, status};
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {vector<string_view>{}, documents_.at(document_id).status};
+    }
+
+    for (const QueryTerm& term : query.required_words) {
+        if (!has_word(term)) {
+            return {vector<string_view>{}, status};
         }
     }
 
+    if (!MatchesPhrases(query, document_id)) {
+        return {vector<string_view>{}, status};
+    }
+
     vector<string_view> matched_words;
-    for (string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const QueryTerm& term : query.plus_words) {
+        if (has_word(term)) {
+            matched_words.push_back(term.word);
         }
     }
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
     return MatchDocument(execution::seq, raw_query, document_id);
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double> null_result;
-    auto iter = document_to_word_freqs_.find(document_id);
-    if (iter != document_to_word_freqs_.end()) {
-        return iter->second;
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it_document = documents_.find(document_id);
+    if (it_document == documents_.end()) {
+        return {};
     }
-    return null_result;
+    return {it_document->second.word_freqs, terms_};
 }
 
-void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
+string SearchServer::GetDocumentText(int document_id) const {
+    if (!options_.store_documents) {
+        throw invalid_argument("Тексты документов не хранятся в индексе"s);
+    }
     if (!document_ids_.count(document_id)) {
-        throw out_of_range("Недопустимый id документа при удалении"s);
+        throw out_of_range("Недопустимый id документа GetDocumentText"s);
     }
+    return document_store_.Get(document_id);
+}
 
-    const auto& word_to_freqs = document_to_word_freqs_[document_id];
-    vector<string_view> words;
-    words.reserve(word_to_freqs.size());
-    for (const auto& word_pair : word_to_freqs) {
-        words.push_back(word_pair.first);
+Snippet SearchServer::GetSnippet(string_view raw_query, int document_id, size_t window_size) const {
+    const string text = GetDocumentText(document_id);
+    const Query query = ParseQuery(raw_query);
+    const vector<string_view> matched_words = get<0>(MatchQuery(query, document_id));
+
+    // найденные слова идут в порядке plus_words; вес на единицу больше IDF, чтобы
+    // слово, встречающееся во всех документах, всё же было лучше отсутствующего
+    const CollectionStats stats = GetCollectionStats();
+    vector<double> weights;
+    weights.reserve(matched_words.size());
+    auto it_word = matched_words.begin();
+    for (const QueryTerm& term : query.plus_words) {
+        if (it_word != matched_words.end() && term.word == *it_word) {
+            weights.push_back(1.0 + TfIdfScorer::TermWeight(stats, term.postings->size()));
+            ++it_word;
+        }
+    }
+    return BuildSnippet(text, matched_words, weights, window_size);
+}
+
+void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
+    CheckMutable();
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Недопустимый id документа при удалении"s);
     }
 
+    const DocumentData& document = documents_.at(document_id);
+    const DocumentStatus status = document.status;
     for_each(std::execution::par,
-             words.begin(), words.end(),
-             [this, document_id](string_view word) {
-                    word_to_document_freqs_[word].erase(document_id);
+             document.word_freqs.begin(), document.word_freqs.end(),
+             [this, document_id, status](const TermFrequency& entry) {
+                    const string_view word = terms_[entry.term_id];
+                    word_to_document_freqs_.find(word)->second.Partition(status).Erase(document_id);
+                    const auto it_positions = word_to_document_positions_.find(word);
+                    if (it_positions != word_to_document_positions_.end()) {
+                        it_positions->second.erase(document_id);
+                    }
                 });
 
-    document_to_word_freqs_.erase(document_id);
+    total_word_count_ -= document.word_count;
+    rating_index_.erase({document.rating, document_id});
+    status_documents_[static_cast<int>(status)].Remove(document_id);
+    document_store_.Erase(document_id);
     documents_.erase(document_id);
     document_ids_.erase(document_id);
+    ++index_version_;
 }
 
 void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
-    const auto iter_document_to_word_freqs_ = document_to_word_freqs_.find(document_id);
+    CheckMutable();
+    const auto it_document = documents_.find(document_id);
 
-    if (iter_document_to_word_freqs_ == document_to_word_freqs_.end()) {
+    if (it_document == documents_.end()) {
         throw out_of_range("Недопустимый id документа при удалении"s);
     }
 
-    const map<string_view, double>& word_to_freqs = iter_document_to_word_freqs_->second;
-    for (const auto& [word, freq] : word_to_freqs) {
-        auto& document_freqs = word_to_document_freqs_.find(word)->second;
-        document_freqs.erase(document_id);
+    const DocumentData& document = it_document->second;
+    const DocumentStatus status = document.status;
+    for (const TermFrequency& entry : document.word_freqs) {
+        const string_view word = terms_[entry.term_id];
+        auto& document_freqs = word_to_document_freqs_.find(word)->second.Partition(status);
+        document_freqs.Erase(document_id);
+        const auto it_positions = word_to_document_positions_.find(word);
+        if (it_positions != word_to_document_positions_.end()) {
+            it_positions->second.erase(document_id);
+        }
     }
 
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
+    total_word_count_ -= document.word_count;
+    rating_index_.erase({document.rating, document_id});
+    status_documents_[static_cast<int>(status)].Remove(document_id);
+    document_store_.Erase(document_id);
+    documents_.erase(it_document);
     document_ids_.erase(document_id);
+    ++index_version_;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(execution::seq, document_id);
 }
 
+void SearchServer::Freeze(FreezeOptions options) {
+    if (frozen_index_) {
+        return;
+    }
+    size_t posting_list_count = 0;
+    size_t posting_count = 0;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        for (int status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index) {
+            const size_t size = postings.Partition(static_cast<DocumentStatus>(status_index)).size();
+            posting_list_count += size > 0;
+            posting_count += size;
+        }
+    }
+
+    auto frozen_index = make_unique<FrozenIndex>(word_to_document_freqs_.size(), posting_list_count, posting_count,
+                                                 documents_.size(), options.use_huge_pages, options.impact_precision);
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        frozen_index->AddTerm(word, dictionary_.find(word)->second, postings);
+    }
+    for (const auto& [document_id, document] : documents_) {
+        frozen_index->AddDocument(document_id, {document.rating, document.status, document.word_count}, document.word_freqs);
+    }
+    frozen_index->BuildRatingOrder();
+    frozen_index->BuildImpacts();
+    frozen_index_ = move(frozen_index);
+    // Поиск читает списки документов, рейтинги и статусы из замороженного индекса. Прямой индекс
+    // и строки словаря остаются: на них ссылаются слова результатов и GetWordFrequencies.
+    // Остаётся и document_ids_: по нему перебирают документы begin() и end() и проверяют id
+    word_to_document_freqs_.clear();
+    rating_index_.clear();
+    ++index_version_;
+}
+
+bool SearchServer::IsFrozen() const {
+    return frozen_index_ != nullptr;
+}
+
+IndexStats SearchServer::GetIndexStats(size_t top_term_count) const {
+    IndexStats stats;
+    stats.document_count = documents_.size();
+
+    // слова с наибольшей памятью отбираются кучей из top_term_count элементов
+    const auto is_heavier = [](const TermStats& lhs, const TermStats& rhs) {
+        return lhs.bytes > rhs.bytes || (lhs.bytes == rhs.bytes && lhs.word < rhs.word);
+    };
+    const auto add_term = [&](string_view word, size_t document_count, size_t postings_bytes) {
+        ++stats.term_count;
+        stats.posting_count += document_count;
+        if (document_count > 0) {
+            size_t bucket = 0;
+            while ((document_count >> (bucket + 1)) > 0) {
+                ++bucket;
+            }
+            if (stats.posting_length_histogram.size() <= bucket) {
+                stats.posting_length_histogram.resize(bucket + 1);
+            }
+            ++stats.posting_length_histogram[bucket];
+        }
+
+        size_t positions_bytes = 0;
+        if (const auto it = word_to_document_positions_.find(word); it != word_to_document_positions_.end()) {
+            positions_bytes = TreeNodeBytes<pair<const string_view, map<int, vector<uint8_t>>>>();
+            for (const auto& [document_id, positions] : it->second) {
+                positions_bytes += TreeNodeBytes<pair<const int, vector<uint8_t>>>() + positions.capacity();
+            }
+        }
+        stats.positions_bytes += positions_bytes;
+
+        if (top_term_count == 0) {
+            return;
+        }
+        TermStats term{string(word), document_count, postings_bytes + positions_bytes};
+        if (stats.heaviest_terms.size() < top_term_count) {
+            stats.heaviest_terms.push_back(move(term));
+            push_heap(stats.heaviest_terms.begin(), stats.heaviest_terms.end(), is_heavier);
+        } else if (is_heavier(term, stats.heaviest_terms.front())) {
+            pop_heap(stats.heaviest_terms.begin(), stats.heaviest_terms.end(), is_heavier);
+            stats.heaviest_terms.back() = move(term);
+            push_heap(stats.heaviest_terms.begin(), stats.heaviest_terms.end(), is_heavier);
+        }
+    };
+
+    if (frozen_index_) {
+        // списки лежат в арене замороженного индекса и учитываются в frozen_index_bytes
+        for (size_t term_index = 0; term_index < frozen_index_->TermCount(); ++term_index) {
+            const StatusPostings& postings = frozen_index_->Postings(term_index);
+            add_term(frozen_index_->Term(term_index), postings.size(), postings.GetMemoryBytes());
+        }
+        stats.frozen_index_bytes = frozen_index_->GetMemoryBytes();
+        stats.impact_bytes = frozen_index_->GetImpactBytes();
+    } else {
+        stats.postings_bytes = word_to_document_freqs_.size() * TreeNodeBytes<pair<const string_view, StatusPostings>>();
+        for (const auto& [word, postings] : word_to_document_freqs_) {
+            const size_t postings_bytes = postings.GetMemoryBytes();
+            stats.postings_bytes += postings_bytes;
+            add_term(word, postings.size(), postings_bytes);
+        }
+    }
+    sort_heap(stats.heaviest_terms.begin(), stats.heaviest_terms.end(), is_heavier);
+
+    size_t dictionary_strings_bytes = 0;
+    for (const auto& [word, term_id] : dictionary_) {
+        dictionary_strings_bytes += StringHeapBytes(word);
+    }
+    stats.dictionary_bytes = dictionary_.size() * TreeNodeBytes<pair<const pmr::string, int>>() + dictionary_strings_bytes
+                             + terms_.capacity() * sizeof(string_view);
+    stats.forward_index_bytes = documents_.size() * TreeNodeBytes<pair<const int, DocumentData>>();
+    for (const auto& [document_id, document] : documents_) {
+        stats.forward_index_bytes += document.word_freqs.capacity() * sizeof(TermFrequency);
+    }
+    stats.document_ids_bytes = document_ids_.size() * TreeNodeBytes<int>();
+    stats.rating_index_bytes = rating_index_.size() * TreeNodeBytes<pair<int, int>>();
+    for (const RoaringBitmap& documents : status_documents_) {
+        stats.status_documents_bytes += documents.GetMemoryBytes();
+    }
+    stats.document_store_bytes = document_store_.GetMemoryBytes();
+
+    // узлы и длинные строки словаря, узлы списков, документов, их id и рейтингов выделяются из пула
+    stats.index_pool_bytes = index_upstream_memory_->GetAllocatedBytes();
+    const size_t pool_nodes_bytes = dictionary_.size() * TreeNodeBytes<pair<const pmr::string, int>>() + dictionary_strings_bytes
+                                    + word_to_document_freqs_.size() * TreeNodeBytes<pair<const string_view, StatusPostings>>()
+                                    + documents_.size() * TreeNodeBytes<pair<const int, DocumentData>>()
+                                    + stats.document_ids_bytes + stats.rating_index_bytes;
+    stats.index_pool_overhead_bytes = stats.index_pool_bytes > pool_nodes_bytes ? stats.index_pool_bytes - pool_nodes_bytes : 0;
+
+    stats.total_bytes = stats.dictionary_bytes + stats.postings_bytes + stats.positions_bytes + stats.forward_index_bytes
+                        + stats.document_ids_bytes + stats.rating_index_bytes + stats.status_documents_bytes
+                        + stats.document_store_bytes + stats.frozen_index_bytes + stats.index_pool_overhead_bytes;
+    return stats;
+}
+
+void SearchServer::SaveSnapshot(ByteWriter& out) const {
+    out.WriteVarint(options_.store_positions);
+    out.WriteVarint(options_.store_documents);
+    out.WriteVarint(stop_words_.size());
+    for (const string& stop_word : stop_words_) {
+        out.WriteString(stop_word);
+    }
+    out.WriteVarint(terms_.size());
+    for (const string_view term : terms_) {
+        out.WriteString(term);
+    }
+
+    out.WriteVarint(documents_.size());
+    for (const auto& [document_id, document] : documents_) {
+        out.WriteInt(document_id);
+        out.WriteInt(document.rating);
+        out.WriteVarint(static_cast<int>(document.status));
+        out.WriteVarint(document.word_count);
+        out.WriteVarint(document.word_freqs.size());
+        for (const auto& [term_id, freq] : document.word_freqs) {
+            out.WriteVarint(term_id);
+            out.WriteDouble(freq);
+        }
+    }
+
+    if (options_.store_positions) {
+        out.WriteVarint(word_to_document_positions_.size());
+        for (const auto& [word, document_positions] : word_to_document_positions_) {
+            out.WriteVarint(dictionary_.find(word)->second);
+            out.WriteVarint(document_positions.size());
+            for (const auto& [document_id, positions] : document_positions) {
+                out.WriteInt(document_id);
+                out.WriteString({reinterpret_cast<const char*>(positions.data()), positions.size()});
+            }
+        }
+    }
+    if (options_.store_documents) {
+        document_store_.Save(out);
+    }
+}
+
+SearchServer SearchServer::LoadSnapshot(ByteReader& in) {
+    IndexOptions options;
+    options.store_positions = in.ReadVarint() != 0;
+    options.store_documents = in.ReadVarint() != 0;
+    vector<string> stop_words(in.ReadVarint());
+    for (string& stop_word : stop_words) {
+        stop_word = in.ReadString();
+    }
+    SearchServer search_server(stop_words, options);
+
+    const size_t term_count = in.ReadVarint();
+    search_server.terms_.reserve(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        const auto [it_word, is_inserted] = search_server.dictionary_.emplace(in.ReadString(), static_cast<int>(term_id));
+        if (!is_inserted) {
+            throw invalid_argument("Повторное слово в снимке индекса"s);
+        }
+        search_server.terms_.push_back(it_word->first);
+    }
+    const auto read_term_id = [&in, term_count] {
+        const uint64_t term_id = in.ReadVarint();
+        if (term_id >= term_count) {
+            throw invalid_argument("Некорректный номер слова в снимке индекса"s);
+        }
+        return static_cast<int>(term_id);
+    };
+
+    const size_t document_count = in.ReadVarint();
+    for (size_t i = 0; i < document_count; ++i) {
+        const int document_id = in.ReadInt();
+        const int rating = in.ReadInt();
+        const uint64_t status_index = in.ReadVarint();
+        if (document_id < 0 || search_server.documents_.count(document_id) > 0 || status_index >= DOCUMENT_STATUS_COUNT) {
+            throw invalid_argument("Некорректный документ в снимке индекса"s);
+        }
+        const auto status = static_cast<DocumentStatus>(status_index);
+        const int word_count = static_cast<int>(in.ReadVarint());
+        vector<TermFrequency> word_freqs(in.ReadVarint());
+        for (TermFrequency& entry : word_freqs) {
+            entry.term_id = read_term_id();
+            entry.freq = in.ReadDouble();
+            // списки строятся в том же виде, что и при добавлении документа
+            search_server.word_to_document_freqs_[search_server.terms_[entry.term_id]].Partition(status).Add(document_id, entry.freq);
+        }
+        search_server.documents_.emplace(document_id, DocumentData{rating, status, word_count, move(word_freqs)});
+        search_server.rating_index_.emplace(rating, document_id);
+        search_server.status_documents_[static_cast<int>(status)].Add(document_id);
+        search_server.total_word_count_ += word_count;
+        search_server.document_ids_.insert(document_id);
+    }
+
+    if (options.store_positions) {
+        const size_t word_count = in.ReadVarint();
+        for (size_t i = 0; i < word_count; ++i) {
+            auto& document_positions = search_server.word_to_document_positions_[search_server.terms_[read_term_id()]];
+            const size_t position_count = in.ReadVarint();
+            for (size_t j = 0; j < position_count; ++j) {
+                const int document_id = in.ReadInt();
+                const string_view positions = in.ReadString();
+                document_positions[document_id].assign(positions.begin(), positions.end());
+            }
+        }
+    }
+    if (options.store_documents) {
+        search_server.document_store_ = DocumentStore::Load(in);
+    }
+    return search_server;
+}
+
 bool SearchServer::IsStopWord(string_view word) const {
     return stop_words_.count(word) > 0;
 }
@@ -205,51 +664,591 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         throw invalid_argument("Пустая строка в запросе"s);
     }
     bool is_minus = false;
+    bool is_required = false;
     if (text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
+    } else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    if (text.empty() || text[0] == '-' || text[0] == '+' || !IsValidWord(text)) {
         throw invalid_argument("Запрос "s + string(text) + " не вылидный");
     }
 
-    return {text, is_minus, IsStopWord(text)};
+    return {text, is_minus, is_required, IsStopWord(text)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text, bool is_parallel) const {
-    vector<string_view> words = SplitIntoWordsView(text);
-    Query query;
+pmr::memory_resource* SearchServer::GetQueryMemory() {
+    thread_local pmr::unsynchronized_pool_resource query_memory;
+    return &query_memory;
+}
+
+SearchServer::Query SearchServer::ParseQuery(string_view text, pmr::memory_resource* memory) const {
+    const pmr::vector<string_view> words = SplitIntoWordsView(text, memory);
+    Query query(memory);
     query.minus_words.reserve(words.size());
     query.plus_words.reserve(words.size());
 
+    pmr::vector<string_view> phrase_words(memory);
+    bool is_phrase = false;
     for (string_view word : words) {
+        if (!is_phrase && word[0] == '"') {
+            is_phrase = true;
+            word.remove_prefix(1);
+        }
+        if (is_phrase) {
+            const size_t closing_quote = word.find('"');
+            phrase_words.push_back(word.substr(0, closing_quote));
+            if (closing_quote != word.npos) {
+                Phrase phrase = ParsePhrase(phrase_words, word.substr(closing_quote + 1));
+                // слова фразы участвуют в ранжировании как обычные плюс-слова
+                for (string_view phrase_word : phrase.words) {
+                    query.plus_words.push_back({phrase_word});
+                }
+                if (phrase.words.size() > 1) {
+                    query.phrases.push_back(move(phrase));
+                }
+                phrase_words.clear();
+                is_phrase = false;
+            }
+            continue;
+        }
+
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+            if (const auto pattern = ParseTermPattern(query_word.data)) {
+                if (query_word.is_required) {
+                    throw invalid_argument("Шаблон не может быть обязательным словом "s + string(word));
+                }
+                query.patterns.push_back({*pattern, query_word.is_minus});
+            } else if (query_word.is_minus) {
+                query.minus_words.push_back({query_word.data});
             } else {
-                query.plus_words.push_back(query_word.data);
+                query.plus_words.push_back({query_word.data});
+                if (query_word.is_required) {
+                    query.required_words.push_back({query_word.data});
+                }
             }
         }
     }
 
-    if (is_parallel) {
-        return query;
+    if (is_phrase) {
+        throw invalid_argument("Незакрытая кавычка в запросе "s + string(text));
     }
 
-    sort(query.minus_words.begin(), query.minus_words.end());
-    auto last_m = unique(query.minus_words.begin(), query.minus_words.end());
-    query.minus_words.resize(distance(query.minus_words.begin(), last_m));
+    ResolveQuery(query);
+    return query;
+}
 
-    sort(query.plus_words.begin(), query.plus_words.end());
-    auto last_p = unique(query.plus_words.begin(), query.plus_words.end());
-    query.plus_words.resize(distance(query.plus_words.begin(), last_p));
+void SearchServer::ResolveQuery(Query& query) const {
+    // после изменения индекса под шаблоны могут подходить другие слова, поэтому они раскрываются заново
+    const auto is_expansion = [](const QueryTerm& term) { return term.is_expansion; };
+    for (pmr::vector<QueryTerm>* terms : {&query.minus_words, &query.plus_words}) {
+        terms->erase(remove_if(terms->begin(), terms->end(), is_expansion), terms->end());
+    }
+    for (const auto& [pattern, is_minus] : query.patterns) {
+        ExpandPattern(pattern, is_minus ? query.minus_words : query.plus_words);
+    }
 
-    return query;
+    // слово, заданное явно, остаётся явным, даже если подходит и под шаблон
+    const auto by_word = [](const QueryTerm& lhs, const QueryTerm& rhs) {
+        return std::tie(lhs.word, lhs.is_expansion) < std::tie(rhs.word, rhs.is_expansion);
+    };
+    const auto same_word = [](const QueryTerm& lhs, const QueryTerm& rhs) { return lhs.word == rhs.word; };
+    for (pmr::vector<QueryTerm>* terms : {&query.minus_words, &query.plus_words, &query.required_words}) {
+        sort(terms->begin(), terms->end(), by_word);
+        terms->erase(unique(terms->begin(), terms->end(), same_word), terms->end());
+    }
+
+    ResolveQueryTerms(query);
+    SortByDocumentFrequency(query.required_words);
+}
+
+void SearchServer::ResolveQueryTerms(Query& query) const {
+    for (pmr::vector<QueryTerm>* terms : {&query.minus_words, &query.plus_words, &query.required_words}) {
+        for (QueryTerm& term : *terms) {
+            const QueryTerm found_term = FindQueryTerm(term.word);
+            term.word = found_term.word;
+            term.postings = found_term.postings;
+        }
+    }
+}
+
+void SearchServer::ExpandPattern(const TermPattern& pattern, pmr::vector<QueryTerm>& terms) const {
+    struct Expansion {
+        int edits;
+        size_t document_count;
+        string_view word;
+        const StatusPostings* postings;
+    };
+    // лучшее подставленное слово ближе к шаблону, а при равном расстоянии чаще встречается,
+    // поэтому само слово шаблона из словаря не вытесняется дальними и редкими словами
+    const auto is_better = [](const Expansion& lhs, const Expansion& rhs) {
+        return tie(lhs.edits, rhs.document_count, lhs.word) < tie(rhs.edits, lhs.document_count, rhs.word);
+    };
+    // куча с худшим из MAX_PATTERN_EXPANSIONS лучших слов на вершине
+    pmr::vector<Expansion> expansions(terms.get_allocator());
+    expansions.reserve(MAX_PATTERN_EXPANSIONS + 1);
+    // слова, все документы которых удалены, остаются в словаре, но не подставляются
+    const auto add_term = [&expansions, &is_better](string_view word, const StatusPostings& postings, int edits) {
+        if (postings.empty()) {
+            return true;
+        }
+        expansions.push_back({edits, postings.size(), word, &postings});
+        push_heap(expansions.begin(), expansions.end(), is_better);
+        if (expansions.size() > static_cast<size_t>(MAX_PATTERN_EXPANSIONS)) {
+            pop_heap(expansions.begin(), expansions.end(), is_better);
+            expansions.pop_back();
+        }
+        return true;
+    };
+
+    if (frozen_index_) {
+        const FrozenIndex& index = *frozen_index_;
+        ForEachPatternTerm(
+                pattern,
+                [&index](string_view word) { return index.LowerBound(word); },
+                index.TermCount(),
+                [&index](size_t position) { return index.Term(position); },
+                [&index, &add_term](size_t position, int edits) {
+                    return add_term(index.Term(position), index.Postings(position), edits);
+                });
+    } else {
+        ForEachPatternTerm(
+                pattern,
+                [this](string_view word) { return word_to_document_freqs_.lower_bound(word); },
+                word_to_document_freqs_.end(),
+                [](auto position) { return position->first; },
+                [&add_term](auto position, int edits) { return add_term(position->first, position->second, edits); });
+    }
+    for (const Expansion& expansion : expansions) {
+        terms.push_back({expansion.word, expansion.postings, true});
+    }
+}
+
+SearchServer::QueryTerm SearchServer::FindQueryTerm(string_view word) const {
+    // найденное слово ссылается на словарь сервера, а не на строку запроса
+    if (frozen_index_) {
+        const size_t index = frozen_index_->FindTerm(word);
+        if (index == frozen_index_->TermCount()) {
+            return {word, nullptr};
+        }
+        return {frozen_index_->Term(index), &frozen_index_->Postings(index)};
+    }
+    const auto it_word = word_to_document_freqs_.find(word);
+    if (it_word == word_to_document_freqs_.end()) {
+        return {word, nullptr};
+    }
+    return {it_word->first, &it_word->second};
+}
+
+void SearchServer::SortByDocumentFrequency(pmr::vector<QueryTerm>& terms) {
+    // отсутствующие в индексе слова идут первыми: с ними пересечение сразу пусто
+    stable_sort(terms.begin(), terms.end(), [](const QueryTerm& lhs, const QueryTerm& rhs) {
+        const size_t lhs_size = lhs.postings == nullptr ? 0 : lhs.postings->size();
+        const size_t rhs_size = rhs.postings == nullptr ? 0 : rhs.postings->size();
+        return lhs_size < rhs_size;
+    });
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(string_view raw_query, QueryMode mode) const {
+    auto text = make_shared<const string>(raw_query);
+    // подготовленный запрос живёт дольше вызова и может выполняться в других потоках,
+    // поэтому его память берётся из общей кучи, а не из пула потока
+    Query query = ParseQuery(*text, pmr::get_default_resource());
+    ApplyQueryMode(query, mode);
+    return {move(text), move(query), index_version_};
+}
+
+const SearchServer::Query& SearchServer::GetCurrentQuery(const PreparedQuery& prepared_query,
+                                                         optional<Query>& refreshed_query) const {
+    if (prepared_query.index_version_ == index_version_) {
+        return prepared_query.query_;
+    }
+    // после подготовки в индексе могли появиться слова запроса
+    refreshed_query.emplace(prepared_query.query_);
+    ResolveQuery(*refreshed_query);
+    return *refreshed_query;
+}
+
+void SearchServer::ApplyQueryMode(Query& query, QueryMode mode) {
+    if (mode == QueryMode::ALL_WORDS) {
+        // слова, подставленные вместо шаблонов, в обязательные не входят
+        query.required_words.clear();
+        copy_if(query.plus_words.begin(), query.plus_words.end(), back_inserter(query.required_words),
+                [](const QueryTerm& term) { return !term.is_expansion; });
+        SortByDocumentFrequency(query.required_words);
+    }
+}
+
+bool SearchServer::IsStatusSelected(DocumentStatus selected_status, DocumentStatus status) {
+    return status == selected_status;
+}
+
+bool SearchServer::IsStatusSelected(const DocumentFilter& filter, DocumentStatus status) {
+    return filter.HasStatus(status);
+}
+
+bool SearchServer::MatchesPredicate(DocumentStatus selected_status, int, DocumentStatus status, int) {
+    return status == selected_status;
+}
+
+optional<vector<int>> SearchServer::GetFilterCandidates(const Query& query, const DocumentFilter& filter) const {
+    const RoaringBitmap* allowed_documents = filter.GetAllowedDocuments();
+    if (!filter.HasRatingRange() && allowed_documents == nullptr) {
+        return nullopt;
+    }
+    // столько записей списков пришлось бы просмотреть при обходе по словам
+    size_t posting_count = 0;
+    for (const QueryTerm& term : query.plus_words) {
+        if (term.postings == nullptr) {
+            continue;
+        }
+        ForEachSelectedStatus(filter, [&posting_count, &term](DocumentStatus status) {
+            posting_count += term.postings->Partition(status).size();
+        });
+    }
+
+    vector<int> candidates;
+    if (allowed_documents != nullptr && allowed_documents->Cardinality() * RATING_INDEX_SELECTIVITY <= posting_count) {
+        // статус и существование документа проверяются пересечением множеств, без обращения к данным документов
+        RoaringBitmap selected_documents(GetQueryMemory());
+        ForEachSelectedStatus(filter, [this, allowed_documents, &selected_documents](DocumentStatus status) {
+            RoaringBitmap status_documents(*allowed_documents, GetQueryMemory());
+            status_documents.And(status_documents_[static_cast<int>(status)]);
+            selected_documents.Or(status_documents);
+        });
+        candidates.reserve(selected_documents.Cardinality());
+        selected_documents.ForEach([this, &filter, &candidates](int document_id) {
+            if (!filter.HasRatingRange() || filter.HasRating(GetDocumentAttributes(document_id).rating)) {
+                candidates.push_back(document_id);
+            }
+        });
+        return candidates;
+    }
+    if (!filter.HasRatingRange()) {
+        return nullopt;
+    }
+
+    // в предел входят и отброшенные по статусу записи: широкий диапазон рейтинга с редким
+    // статусом не должен превращаться в обход всего индекса рейтингов
+    size_t visited_count = 0;
+    const auto is_selective = [&visited_count, posting_count] {
+        return ++visited_count * RATING_INDEX_SELECTIVITY <= posting_count;
+    };
+    if (frozen_index_) {
+        const auto [first, last] = frozen_index_->RatingRange(filter.GetMinRating(), filter.GetMaxRating());
+        for (const uint32_t* it = first; it != last; ++it) {
+            if (!is_selective()) {
+                return nullopt;
+            }
+            const int document_id = frozen_index_->DocumentId(*it);
+            if (filter.HasDocument(document_id) && filter.HasStatus(frozen_index_->DocumentAt(*it).status)) {
+                candidates.push_back(document_id);
+            }
+        }
+    } else {
+        const auto first = rating_index_.lower_bound({filter.GetMinRating(), numeric_limits<int>::min()});
+        for (auto it = first; it != rating_index_.end() && it->first <= filter.GetMaxRating(); ++it) {
+            if (!is_selective()) {
+                return nullopt;
+            }
+            if (filter.HasDocument(it->second) && filter.HasStatus(GetDocumentAttributes(it->second).status)) {
+                candidates.push_back(it->second);
+            }
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    return candidates;
+}
+
+vector<const PostingList*> SearchServer::GetRequiredPostings(const Query& query, DocumentStatus status) const {
+    vector<const PostingList*> required_postings;
+    required_postings.reserve(query.required_words.size());
+    for (const QueryTerm& term : query.required_words) {
+        if (term.postings == nullptr || term.postings->Partition(status).empty()) {
+            return {};
+        }
+        required_postings.push_back(&term.postings->Partition(status));
+    }
+    // пересечение начинается с самого редкого слова: его длина ограничивает всю работу
+    sort(required_postings.begin(), required_postings.end(),
+         [](const PostingList* lhs, const PostingList* rhs) { return lhs->size() < rhs->size(); });
+    return required_postings;
+}
+
+SearchServer::Phrase SearchServer::ParsePhrase(const pmr::vector<string_view>& words, string_view closing_token) const {
+    Phrase phrase;
+    if (!closing_token.empty()) {
+        // "фраза"~N - слова в том же порядке, между ними не более N посторонних слов
+        const string_view slop = closing_token.substr(1);
+        if (closing_token[0] != '~' || slop.empty() || slop.size() > 4
+            || !all_of(slop.begin(), slop.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            throw invalid_argument("Некорректное окончание фразы "s + string(closing_token));
+        }
+        phrase.slop = stoi(string(slop));
+    }
+
+    for (string_view word : words) {
+        if (word.empty()) {
+            continue;
+        }
+        const QueryWord query_word = ParseQueryWord(word);
+        if (query_word.is_minus) {
+            throw invalid_argument("Минус-слово внутри фразы "s + string(word));
+        }
+        if (!query_word.is_stop) {
+            phrase.words.push_back(query_word.data);
+        }
+    }
+
+    if (phrase.words.size() > 1 && !options_.store_positions) {
+        throw invalid_argument("Фразовые запросы требуют хранения позиций слов в индексе"s);
+    }
+    return phrase;
+}
+
+bool SearchServer::MatchesPhrase(const Phrase& phrase, int document_id) const {
+    vector<vector<uint32_t>> word_positions;
+    word_positions.reserve(phrase.words.size());
+    for (string_view word : phrase.words) {
+        const auto it_word = word_to_document_positions_.find(word);
+        if (it_word == word_to_document_positions_.end()) {
+            return false;
+        }
+        const auto it_document = it_word->second.find(document_id);
+        if (it_document == it_word->second.end()) {
+            return false;
+        }
+        word_positions.push_back(DecodePositions(it_document->second));
+    }
+    return MatchesPositions(word_positions, phrase.slop);
+}
+
+bool SearchServer::MatchesPhrases(const Query& query, int document_id) const {
+    return all_of(query.phrases.begin(), query.phrases.end(),
+                  [this, document_id](const Phrase& phrase) { return MatchesPhrase(phrase, document_id); });
+}
+
+vector<int> SearchServer::FindPhraseDocuments(const Query& query, size_t* posting_reads) const {
+    vector<int> result;
+    bool is_first_phrase = true;
+    for (const Phrase& phrase : query.phrases) {
+        vector<const StatusPostings*> phrase_postings;
+        for (string_view word : phrase.words) {
+            const QueryTerm term = FindQueryTerm(word);
+            if (term.postings == nullptr) {
+                return {};
+            }
+            phrase_postings.push_back(term.postings);
+        }
+
+        vector<int> phrase_documents;
+        // документ находится в частях одного статуса во всех списках, поэтому части пересекаются независимо
+        for (int status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index) {
+            const auto status = static_cast<DocumentStatus>(status_index);
+            const auto* shortest_postings = *min_element(phrase_postings.begin(), phrase_postings.end(),
+                                                         [status](const auto* lhs, const auto* rhs) {
+                                                             return lhs->Partition(status).size() < rhs->Partition(status).size();
+                                                         });
+            AddPostingReads(posting_reads, shortest_postings->Partition(status).size());
+            for (const auto& [document_id, _] : shortest_postings->Partition(status)) {
+                if (!is_first_phrase && !binary_search(result.begin(), result.end(), document_id)) {
+                    continue;
+                }
+                // позиции раскодируются только для документов, содержащих все слова фразы
+                const bool has_all_words = all_of(phrase_postings.begin(), phrase_postings.end(),
+                                                  [document_id, status, posting_reads](const auto* postings) {
+                                                      AddPostingReads(posting_reads, 1);
+                                                      return postings->Partition(status).Contains(document_id);
+                                                  });
+                if (has_all_words && MatchesPhrase(phrase, document_id)) {
+                    phrase_documents.push_back(document_id);
+                }
+            }
+        }
+        sort(phrase_documents.begin(), phrase_documents.end());
+        result = move(phrase_documents);
+        is_first_phrase = false;
+    }
+    return result;
+}
+
+namespace {
+
+template <typename Impact, typename Terms>
+pmr::vector<ImpactList<Impact>> GetImpactLists(const FrozenIndex& index, const Terms& terms, DocumentStatus status) {
+    pmr::vector<ImpactList<Impact>> lists(terms.get_allocator());
+    for (const auto& term : terms) {
+        if (term.postings != nullptr) {
+            lists.push_back(index.Impacts<Impact>(index.TermIndex(term.postings), status));
+        }
+    }
+    return lists;
+}
+
+// Отбирает кандидатов в top_count лучших документов по квантованным вкладам. Сначала
+// складываются только блоки, наибольший вклад которых не меньше порога пропуска, поэтому
+// счёт документа занижен не больше чем на сумму наибольших пропущенных вкладов его слов.
+// Если k-й счёт слишком мал, чтобы это не влияло на отбор, складываются все блоки.
+// tie_units - EPSILON в единицах вкладов. Счета scores после вызова снова нулевые.
+// Возвращает число сложенных вкладов
+template <typename Impact, typename IsExcluded>
+size_t SelectImpactCandidates(const pmr::vector<ImpactList<Impact>>& lists, size_t top_count, uint32_t tie_units,
+                              IsExcluded is_excluded, uint32_t* scores, pmr::vector<pair<uint32_t, uint32_t>>& candidates) {
+    const uint32_t term_count = lists.size();
+    uint32_t max_impact = 0;
+    size_t posting_count = 0;
+    for (const ImpactList<Impact>& list : lists) {
+        for (size_t block = 0; block < list.BlockCount(); ++block) {
+            max_impact = max<uint32_t>(max_impact, list.block_maxima[block]);
+        }
+        posting_count += list.size;
+    }
+    // после резервирования добавление не бросает исключений и счета всегда обнуляются
+    candidates.reserve(posting_count);
+
+    // пропуск занижает счёт не больше чем на половину наибольшего вклада
+    uint32_t skip_below = term_count == 0 ? 0 : max_impact / (2 * term_count);
+    size_t added_count = 0;
+    while (true) {
+        uint32_t slack = 0;
+        // блок с нулевым наибольшим вкладом не увеличивает slack, но его документы тоже найдены
+        // и без повторного обхода пропали бы из результата
+        bool is_any_skipped = false;
+        for (const ImpactList<Impact>& list : lists) {
+            uint32_t skipped_max = 0;
+            for (size_t block = 0; block < list.BlockCount(); ++block) {
+                if (list.block_maxima[block] < skip_below) {
+                    skipped_max = max<uint32_t>(skipped_max, list.block_maxima[block]);
+                    is_any_skipped = true;
+                    continue;
+                }
+                const size_t begin = block * IMPACT_BLOCK_SIZE;
+                AddImpacts(list.document_indices + begin, list.impacts + begin, min(IMPACT_BLOCK_SIZE, list.size - begin), scores);
+                added_count += min(IMPACT_BLOCK_SIZE, list.size - begin);
+            }
+            slack += skipped_max;
+        }
+
+        // затронутые документы собираются повторным обходом сложенных блоков
+        candidates.clear();
+        for (const ImpactList<Impact>& list : lists) {
+            for (size_t block = 0; block < list.BlockCount(); ++block) {
+                if (list.block_maxima[block] < skip_below) {
+                    continue;
+                }
+                const size_t end = min(list.size, (block + 1) * IMPACT_BLOCK_SIZE);
+                for (size_t i = block * IMPACT_BLOCK_SIZE; i < end; ++i) {
+                    uint32_t& score = scores[list.document_indices[i]];
+                    if (score != 0) {
+                        if (!is_excluded(list.document_indices[i])) {
+                            candidates.emplace_back(score & ~IMPACT_TOUCHED_BIT, list.document_indices[i]);
+                        }
+                        score = 0;
+                    }
+                }
+            }
+        }
+
+        // ошибка каждого вклада не больше половины единицы, поэтому документ из точных лучших
+        // отстаёт от k-го по полному приближённому счёту не больше чем на term_count единиц
+        // плюс EPSILON, в пределах которого порядок решает рейтинг
+        const uint32_t margin = term_count + tie_units + 1;
+        if (candidates.size() > top_count) {
+            const auto kth = candidates.begin() + (top_count - 1);
+            nth_element(candidates.begin(), kth, candidates.end(), greater<>());
+            // документ только из пропущенных блоков набирает не больше slack и не проходит порог
+            if (kth->first > margin + slack) {
+                const uint32_t threshold = kth->first - margin - slack;
+                candidates.erase(remove_if(candidates.begin(), candidates.end(),
+                                           [threshold](const auto& candidate) { return candidate.first < threshold; }),
+                                 candidates.end());
+                return added_count;
+            }
+            if (!is_any_skipped) {
+                return added_count;
+            }
+        } else if (!is_any_skipped) {
+            return added_count;
+        }
+        skip_below = 0;
+    }
+}
+
+} // namespace
+
+bool SearchServer::CanUseImpacts(const Query& query) const {
+    return frozen_index_ && frozen_index_->GetImpactPrecision() != ImpactPrecision::NONE
+           && query.phrases.empty() && query.required_words.empty();
+}
+
+vector<Document> SearchServer::FindTopImpactDocuments(const Query& query, DocumentStatus status, size_t* candidate_count,
+                                                      size_t* posting_reads) const {
+    const FrozenIndex& index = *frozen_index_;
+    // счета всех документов индекса; после запроса обнуляются только затронутые
+    thread_local vector<uint32_t> scores;
+    if (scores.size() < index.DocumentCount()) {
+        scores.resize(index.DocumentCount());
+    }
+
+    const RoaringBitmap excluded_documents = BuildExclusionBitmap(query, status, posting_reads);
+    const auto is_excluded = [&index, &excluded_documents](uint32_t document_index) {
+        return excluded_documents.Contains(index.DocumentId(document_index));
+    };
+    const auto tie_units = static_cast<uint32_t>(ceil(EPSILON * index.GetImpactScale()));
+    pmr::vector<pair<uint32_t, uint32_t>> candidates(GetQueryMemory());
+    size_t impact_reads = 0;
+    if (index.GetImpactPrecision() == ImpactPrecision::BITS_8) {
+        impact_reads = SelectImpactCandidates(GetImpactLists<uint8_t>(index, query.plus_words, status), MAX_RESULT_DOCUMENT_COUNT,
+                                              tie_units, is_excluded, scores.data(), candidates);
+    } else {
+        impact_reads = SelectImpactCandidates(GetImpactLists<uint16_t>(index, query.plus_words, status), MAX_RESULT_DOCUMENT_COUNT,
+                                              tie_units, is_excluded, scores.data(), candidates);
+    }
+    AddPostingReads(posting_reads, impact_reads);
+
+    if (candidate_count != nullptr) {
+        *candidate_count = candidates.size();
+    }
+
+    // точная релевантность складывается в том же порядке слов, что и при обычном поиске
+    const CollectionStats stats = GetCollectionStats();
+    pmr::vector<double> term_weights(GetQueryMemory());
+    term_weights.reserve(query.plus_words.size());
+    for (const QueryTerm& term : query.plus_words) {
+        term_weights.push_back(term.postings == nullptr ? 0.0 : TfIdfScorer::TermWeight(stats, term.postings->size()));
+    }
+    vector<Document> matched_documents;
+    matched_documents.reserve(candidates.size());
+    // tf кандидата читается из прямого индекса документа, а не из списков слов
+    pmr::vector<int> term_ids(GetQueryMemory());
+    term_ids.reserve(query.plus_words.size());
+    for (const QueryTerm& term : query.plus_words) {
+        term_ids.push_back(term.postings == nullptr ? -1 : index.TermId(index.TermIndex(term.postings)));
+    }
+    for (const auto& [score, document_index] : candidates) {
+        double relevance = 0.0;
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            if (term_ids[i] < 0) {
+                continue;
+            }
+            AddPostingReads(posting_reads, 1);
+            if (const TermFrequency* entry = index.FindDocumentTerm(document_index, term_ids[i])) {
+                relevance += TfIdfScorer::Score(entry->freq, term_weights[i], 0, stats);
+            }
+        }
+        const int document_id = index.DocumentId(document_index);
+        matched_documents.push_back({document_id, relevance, index.DocumentRating(document_index)});
+    }
+    SelectTopDocuments(execution::seq, matched_documents);
+    return matched_documents;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+CollectionStats SearchServer::GetCollectionStats() const {
+    const int document_count = GetDocumentCount();
+    return {document_count, document_count == 0 ? 0.0 : total_word_count_ * 1.0 / document_count};
 }
 
 void AddDocument(SearchServer& search_server, int document_id, string_view document, DocumentStatus status,
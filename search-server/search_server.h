@@ -1,9 +1,25 @@
 #pragma once
 
+#include "binary_io.h"
 #include "document.h"
+#include "document_filter.h"
+#include "document_store.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "frozen_index.h"
+#include "index_stats.h"
+#include "memory_usage.h"
+#include "positions.h"
+#include "posting_list.h"
+#include "query_plan.h"
+#include "roaring_bitmap.h"
+#include "scorers.h"
+#include "snippet.h"
+#include "term_expansion.h"
+#include "word_frequencies.h"
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -11,40 +27,171 @@
 #include <map>
 #include <algorithm>
 #include <utility>
+#include <chrono>
+#include <cmath>
 #include <execution>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <thread>
 
 using namespace std::string_literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const int CONCURRENT_MAP_BUCKET_COUNT = 100;
+const int MIN_INTERSECTION_CHUNK_SIZE = 1024;
+// Индекс рейтингов и множество допустимых документов фильтра используются, если записей
+// в диапазоне рейтинга или документов в множестве хотя бы во столько раз меньше, чем
+// записей в списках слов запроса
+const int RATING_INDEX_SELECTIVITY = 8;
 const double EPSILON = 1e-6;
+// Наибольшее число накопителей релевантности пакетного поиска: запросы пакета, которым
+// не хватает ячеек на все актуальные документы, исполняются следующими группами
+const size_t MAX_BATCH_ACCUMULATORS = 1 << 20;
+
+// Настройки индекса. Дополнительные структуры включаются явно, чтобы
+// расходовать память только там, где они нужны
+struct IndexOptions {
+    // хранить позиции слов: нужны для запросов "фраза" и "фраза"~N
+    bool store_positions = false;
+    // хранить сжатые тексты документов: нужны для GetDocumentText и GetSnippet
+    bool store_documents = false;
+};
+
+// Настройки замороженного индекса
+struct FreezeOptions {
+    // просить ядро разместить блок списков документов на страницах по 2 МБ (madvise MADV_HUGEPAGE)
+    bool use_huge_pages = false;
+    // квантованные вклады слов для поиска TF-IDF с фильтром по статусу: кандидаты отбираются
+    // сложением целых вкладов, а лучшие из них пересчитываются точно, поэтому результат не меняется.
+    // Вклад занимает на документ списка 4 байта номера в столбцах и 1 или 2 байта вместо 8 байт tf:
+    // tf читается из прямого индекса документов, который остаётся после заморозки. Поэтому другие
+    // виды поиска по такому индексу ищут tf каждого документа списка в прямом индексе и медленнее
+    ImpactPrecision impact_precision = ImpactPrecision::NONE;
+};
+
+// Способ объединения плюс-слов запроса. Слова с префиксом + обязательны в любом режиме
+enum class QueryMode {
+    ANY_WORD,   // документ должен содержать хотя бы одно плюс-слово
+    ALL_WORDS,  // документ должен содержать все плюс-слова
+};
 
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, IndexOptions options = {});
 
-    explicit SearchServer(std::string_view view_stop_words_text);
+    explicit SearchServer(std::string_view view_stop_words_text, IndexOptions options = {});
 
-    explicit SearchServer(const std::string& string_stop_words_text);
+    explicit SearchServer(const std::string& string_stop_words_text, IndexOptions options = {});
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    template <class ExecutionPolicy, typename DocumentPredicate>
+    // Пакетное добавление документов: разбиение на слова выполняется с заданной политикой,
+    // вставка в индекс - последовательно в порядке контейнера. Элементы контейнера должны
+    // иметь поля id, text, status и ratings
+    template <class ExecutionPolicy, typename DocumentContainer>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents);
+
+    // Scorer - политика ранжирования из scorers.h, например FindTopDocuments<Bm25Scorer>(raw_query).
+    // Слово запроса слово* заменяется словами индекса с этим префиксом, слово~N (N = 1 или 2) -
+    // словами на расстоянии Левенштейна в буквах не больше N. На шаблон подставляются не больше
+    // MAX_PATTERN_EXPANSIONS ближайших к нему слов, при равном расстоянии - самых частых.
+    // Подставленные слова ранжируются как обычные плюс- или минус-слова
+    template <typename Scorer = TfIdfScorer, class ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate, QueryMode mode = QueryMode::ANY_WORD) const;
+
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           QueryMode mode = QueryMode::ANY_WORD) const;
+
+    template <typename Scorer = TfIdfScorer, class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                           DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                           QueryMode mode = QueryMode::ANY_WORD) const;
+
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                           QueryMode mode = QueryMode::ANY_WORD) const;
+
+    // Запрос, разобранный один раз для многократного выполнения: слова без повторов
+    // сопоставлены спискам документов индекса, поэтому при выполнении строки не обрабатываются
+    class PreparedQuery;
+
+    PreparedQuery PrepareQuery(std::string_view raw_query, QueryMode mode = QueryMode::ANY_WORD) const;
+
+    template <typename Scorer = TfIdfScorer, class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
                                            DocumentPredicate document_predicate) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const;
 
-    template <class ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+    template <typename Scorer = TfIdfScorer, class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
                                            DocumentStatus input_status = DocumentStatus::ACTUAL) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query,
+                                           DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+
+    // Постраничный поиск: до count лучших документов, следующих в порядке ранжирования за документом
+    // after (последним документом предыдущей страницы), без ограничения MAX_RESULT_DOCUMENT_COUNT.
+    // Документы с равными релевантностью и рейтингом упорядочены по id, поэтому страницы не
+    // пересекаются и не пропускают документов. Сортируются только выбранные count документов
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsAfter(const PreparedQuery& prepared_query, const std::optional<Document>& after,
+                                                size_t count, DocumentPredicate document_predicate) const;
+
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocumentsAfter(const PreparedQuery& prepared_query, const std::optional<Document>& after,
+                                                size_t count, DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+
+    // План запроса: слова по возрастанию числа документов и оценка каждого способа выполнения
+    // в чтениях элементов списков документов; выбирается самый дешёвый. Порядок слов в плане
+    // только показывает избирательность: слагаемые релевантности по-прежнему складываются
+    // в алфавитном порядке слов, поэтому все способы, кроме параллельного, дают одинаковый результат
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    QueryPlan PlanQuery(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const;
+
+    template <typename Scorer = TfIdfScorer>
+    QueryPlan PlanQuery(const PreparedQuery& prepared_query, DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+
+    // Поиск способом, выбранным PlanQuery. Результат совпадает с FindTopDocuments, если план не
+    // выбрал параллельный обход. При параллельном обходе, как и у FindTopDocuments(par), релевантность
+    // совпадает лишь с точностью EPSILON, поэтому документы с почти равной релевантностью могут
+    // идти в другом порядке, а на границе MAX_RESULT_DOCUMENT_COUNT - смениться
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPlanned(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const;
+
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocumentsPlanned(const PreparedQuery& prepared_query,
+                                                  DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+
+    // EXPLAIN: план запроса вместе с результатом его выполнения, числом документов,
+    // для которых вычислена релевантность, числом прочитанных элементов списков и временем выполнения
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    QueryExplanation ExplainQuery(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const;
+
+    template <typename Scorer = TfIdfScorer>
+    QueryExplanation ExplainQuery(const PreparedQuery& prepared_query, DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+
+    // Пакетный поиск: результат для каждого запроса совпадает с FindTopDocuments(raw_query).
+    // Запросы группируются по словам, и список документов каждого слова обходится один раз
+    // на весь пакет, а вклад слова раздаётся всем запросам, где оно встречается. Релевантность
+    // копится в плотных массивах по порядковому номеру документа, минус-слова проверяются
+    // один раз на каждый найденный документ
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries) const;
 
     int GetDocumentCount() const;
 
+    // Документы с данным статусом; множества можно пересекать и передавать в
+    // DocumentFilter::SetAllowedDocuments вместо предиката по id
+    const RoaringBitmap& GetStatusDocuments(DocumentStatus status) const;
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&,
                                                                             std::string_view raw_query, int document_id) const;
 
@@ -53,7 +200,18 @@ public:
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& prepared_query, int document_id) const;
+
+    // Пустой результат для неизвестного id
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // Исходный текст документа. Требует IndexOptions::store_documents
+    std::string GetDocumentText(int document_id) const;
+
+    // Фрагмент документа из window_size слов, где найденные слова запроса (как в MatchDocument)
+    // весят больше всего, с позициями этих слов. Редкие слова весят больше частых.
+    // Раскодируется только блок хранилища с документом. Требует IndexOptions::store_documents
+    Snippet GetSnippet(std::string_view raw_query, int document_id, size_t window_size = DEFAULT_SNIPPET_WORD_COUNT) const;
 
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
@@ -61,6 +219,28 @@ public:
 
     void RemoveDocument(int document_id);
 
+    // Переводит индекс в режим только для чтения: списки документов копируются подряд
+    // в один выровненный блок, словарь становится отсортированным массивом, данные
+    // документов - столбцами, индекс рейтингов - массивом номеров документов, упорядоченным
+    // по рейтингу. Результаты всех методов поиска не меняются, а добавление
+    // и удаление документов после этого бросают std::logic_error. Повторный вызов ничего не делает
+    void Freeze(FreezeOptions options = {});
+
+    bool IsFrozen() const;
+
+    // Состав индекса, память по структурам и top_term_count слов с наибольшей памятью.
+    // Время линейно по числу слов, документов и пар (слово, документ) с позициями;
+    // тексты документов и списки документов поэлементно не обходятся
+    IndexStats GetIndexStats(size_t top_term_count = 10) const;
+
+    // Снимок индекса: стоп-слова, настройки, словарь и прямой индекс документов, а также
+    // позиции слов и тексты, если они хранятся. Списки документов не записываются -
+    // при загрузке они строятся по прямому индексу без разбора текстов. Загруженный
+    // индекс не заморожен. LoadSnapshot бросает std::invalid_argument для повреждённых данных
+    void SaveSnapshot(ByteWriter& out) const;
+
+    static SearchServer LoadSnapshot(ByteReader& in);
+
     const auto begin() const {
         return document_ids_.begin();
     }
@@ -73,14 +253,48 @@ private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        int word_count;
+        // прямой индекс: слова документа по возрастанию номера
+        std::vector<TermFrequency> word_freqs;
     };
 
-    std::set<std::string, std::less<>> dictionary_;
+    // Пул для узлов деревьев индекса и строк словаря: узлы одного размера берутся из общих
+    // блоков, а освободившиеся при удалении документов переиспользуются. Пул и счётчик взятой
+    // им памяти объявлены первыми, чтобы разрушаться последними, и хранятся по указателю,
+    // чтобы переживать перемещение сервера
+    std::unique_ptr<CountingMemoryResource> index_upstream_memory_ = std::make_unique<CountingMemoryResource>();
+    std::unique_ptr<std::pmr::unsynchronized_pool_resource> index_memory_ =
+            std::make_unique<std::pmr::unsynchronized_pool_resource>(index_upstream_memory_.get());
+    const IndexOptions options_;
+    // слово словаря -> его номер; строки слов принадлежат словарю
+    std::pmr::map<std::pmr::string, int, std::less<>> dictionary_{index_memory_.get()};
+    // номер слова -> слово
+    std::vector<std::string_view> terms_;
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    std::pmr::map<std::string_view, StatusPostings> word_to_document_freqs_{index_memory_.get()};
+    std::map<std::string_view, std::map<int, std::vector<uint8_t>>> word_to_document_positions_;
+    DocumentStore document_store_;
+    std::pmr::map<int, DocumentData> documents_{index_memory_.get()};
+    std::pmr::set<int> document_ids_{index_memory_.get()};
+    // пары (рейтинг, id) для отбора документов по диапазону рейтинга
+    std::pmr::set<std::pair<int, int>> rating_index_{index_memory_.get()};
+    // id документов по статусам
+    std::array<RoaringBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    int64_t total_word_count_ = 0;
+    // растёт при каждом изменении индекса; по нему подготовленный запрос узнаёт, что устарел
+    uint64_t index_version_ = 0;
+    // после Freeze заменяет word_to_document_freqs_ и данные документов при поиске
+    std::unique_ptr<const FrozenIndex> frozen_index_;
+
+    void CheckMutable() const;
+
+    DocumentAttributes GetDocumentAttributes(int document_id) const {
+        if (frozen_index_) {
+            return frozen_index_->GetDocument(document_id);
+        }
+        const DocumentData& document = documents_.at(document_id);
+        return {document.rating, document.status, document.word_count};
+    }
 
     bool IsStopWord(std::string_view word) const;
 
@@ -90,33 +304,268 @@ private:
 
     std::vector<std::string_view> SplitIntoWordsViewNoStop(std::string_view text) const;
 
+    struct TokenizedDocument {
+        std::vector<std::string_view> words;
+        std::exception_ptr error;
+    };
+
+    void CheckNewDocumentId(int document_id) const;
+
+    void AddDocumentWords(int document_id, std::string_view text, const std::vector<std::string_view>& words,
+                          DocumentStatus status, const std::vector<int>& ratings);
+
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Слова фразы в порядке следования и допустимое число посторонних слов между ними
+    struct Phrase {
+        std::vector<std::string_view> words;
+        int slop = 0;
+    };
+
+    // Слово запроса и его списки документов; postings равен nullptr, если слова нет в индексе
+    struct QueryTerm {
+        std::string_view word;
+        const StatusPostings* postings = nullptr;
+        // слово словаря, подставленное вместо шаблона
+        bool is_expansion = false;
+    };
+
+    struct QueryPattern {
+        TermPattern pattern;
+        bool is_minus;
+    };
+
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* memory)
+                : plus_words(memory)
+                , minus_words(memory)
+                , required_words(memory)
+                , phrases(memory)
+                , patterns(memory) {
+        }
+
+        // плюс- и минус-слова упорядочены по алфавиту: в этом порядке складываются слагаемые релевантности
+        std::pmr::vector<QueryTerm> plus_words;
+        std::pmr::vector<QueryTerm> minus_words;
+        // обязательные слова входят и в plus_words; упорядочены по возрастанию числа документов
+        std::pmr::vector<QueryTerm> required_words;
+        std::pmr::vector<Phrase> phrases;
+        // шаблоны слово* и слово~N; подставленные вместо них слова входят в plus_words и minus_words
+        std::pmr::vector<QueryPattern> patterns;
     };
 
-    Query ParseQuery(std::string_view text, bool is_parallel = false) const;
+    // Память для временных структур запроса. Пул принадлежит потоку и не возвращает
+    // блоки в кучу, поэтому после первых запросов разбор запроса и обход списков
+    // документов обходятся без выделений памяти. Выделенное из пула должно
+    // освобождаться в том же потоке
+    static std::pmr::memory_resource* GetQueryMemory();
+
+    // Слова запроса без повторов, сопоставленные спискам документов
+    Query ParseQuery(std::string_view text, std::pmr::memory_resource* memory = GetQueryMemory()) const;
+
+    // Раскрывает шаблоны, убирает повторы слов и сопоставляет слова спискам документов
+    void ResolveQuery(Query& query) const;
+
+    void ResolveQueryTerms(Query& query) const;
+
+    // Добавляет в terms не больше MAX_PATTERN_EXPANSIONS подходящих под шаблон слов словаря
+    // с наименьшим расстоянием до шаблона, при равном расстоянии - с наибольшим числом документов
+    void ExpandPattern(const TermPattern& pattern, std::pmr::vector<QueryTerm>& terms) const;
+
+    // Слово со ссылкой на строку словаря и его списки документов
+    QueryTerm FindQueryTerm(std::string_view word) const;
+
+    static void SortByDocumentFrequency(std::pmr::vector<QueryTerm>& terms);
+
+    static void ApplyQueryMode(Query& query, QueryMode mode);
+
+    // Запрос подготовленного запроса, обновлённый, если индекс изменился после подготовки
+    const Query& GetCurrentQuery(const PreparedQuery& prepared_query, std::optional<Query>& refreshed_query) const;
+
+    template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopQueryDocuments(const ExecutionPolicy& policy, const Query& query,
+                                                DocumentPredicate document_predicate) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Квантованные вклады применимы: индекс заморожен с ними, в запросе нет фраз и обязательных слов
+    bool CanUseImpacts(const Query& query) const;
+
+    // Лучшие документы по квантованным вкладам с точным пересчётом релевантности кандидатов.
+    // Результат совпадает с поиском TfIdfScorer по статусу. В candidate_count, если он задан,
+    // записывается число пересчитанных кандидатов. Здесь и ниже к posting_reads, если он задан,
+    // прибавляется число прочитанных элементов списков документов (см. AddPostingReads)
+    std::vector<Document> FindTopImpactDocuments(const Query& query, DocumentStatus status,
+                                                 size_t* candidate_count = nullptr, size_t* posting_reads = nullptr) const;
+
+    // Все документы запроса с учётом фраз, в порядке возрастания id
+    template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllQueryDocuments(const ExecutionPolicy& policy, const Query& query,
+                                                DocumentPredicate document_predicate, size_t* posting_reads = nullptr) const;
+
+    // Элемент списка, прочитанный при обходе, и поиск документа в списке (двоичный или
+    // с переходом вперёд) считаются одним чтением
+    static void AddPostingReads(size_t* posting_reads, size_t count) {
+        if (posting_reads != nullptr) {
+            *posting_reads += count;
+        }
+    }
+
+    template <typename Scorer, typename DocumentPredicate>
+    QueryPlan BuildQueryPlan(const Query& query, const DocumentPredicate& document_predicate) const;
+
+    // Лучшие документы способом из плана; в scored_documents записывается число документов,
+    // для которых вычислена релевантность
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> ExecuteQueryPlan(const QueryPlan& plan, const Query& query, DocumentPredicate document_predicate,
+                                           size_t& scored_documents, size_t* posting_reads = nullptr) const;
+
+    // Все документы запроса с учётом фраз, найденные через битовую карту подходящих документов
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllBitmapQueryDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                      size_t* posting_reads = nullptr) const;
+
+    // Все документы запроса с обязательными словами и фразами, найденные пересечением списков
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllRequiredQueryDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                        size_t* posting_reads = nullptr) const;
+
+    // Предикат и минус-слова проверяются один раз для каждого документа индекса, после чего
+    // при обходе списков плюс-слов данные документа не читаются
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllBitmapDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                 size_t* posting_reads = nullptr) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQuery(const Query& query, int document_id) const;
+
+    Phrase ParsePhrase(const std::pmr::vector<std::string_view>& words, std::string_view closing_token) const;
+
+    bool MatchesPhrase(const Phrase& phrase, int document_id) const;
+
+    bool MatchesPhrases(const Query& query, int document_id) const;
+
+    std::vector<int> FindPhraseDocuments(const Query& query, size_t* posting_reads = nullptr) const;
+
+    CollectionStats GetCollectionStats() const;
+
+    // Порядок ранжирования: по убыванию релевантности, затем рейтинга, затем по возрастанию id
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+            return lhs.relevance > rhs.relevance;
+        }
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+
+    // Оставляет count лучших найденных документов и сортирует только их
+    template <class ExecutionPolicy>
+    static void SelectTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& matched_documents,
+                                   size_t count = MAX_RESULT_DOCUMENT_COUNT);
+
+    // Документы выбранных статусов, содержащие хотя бы одно минус-слово запроса
+    template <typename DocumentPredicate>
+    RoaringBitmap BuildExclusionBitmap(const Query& query, const DocumentPredicate& document_predicate,
+                                       size_t* posting_reads = nullptr) const;
+
+    // Фильтр по фразам поверх пользовательского предиката
+    template <typename DocumentPredicate>
+    struct PhrasePredicate {
+        const std::vector<int>& phrase_documents;
+        DocumentPredicate document_predicate;
+    };
+
+    // Предикат определяет, какие части списков по статусам нужно обходить:
+    // для фильтра по статусу - одну, для произвольного предиката - все
+    template <typename DocumentPredicate>
+    static bool IsStatusSelected(const DocumentPredicate& document_predicate, DocumentStatus status);
+
+    static bool IsStatusSelected(DocumentStatus selected_status, DocumentStatus status);
+
+    static bool IsStatusSelected(const DocumentFilter& filter, DocumentStatus status);
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    static bool IsStatusSelected(const PhrasePredicate<DocumentPredicate>& phrase_predicate, DocumentStatus status);
+
+    template <typename DocumentPredicate, typename Function>
+    static void ForEachSelectedStatus(const DocumentPredicate& document_predicate, Function function);
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    static bool MatchesPredicate(const DocumentPredicate& document_predicate, int document_id, DocumentStatus status, int rating);
+
+    static bool MatchesPredicate(DocumentStatus selected_status, int document_id, DocumentStatus status, int rating);
 
     template <typename DocumentPredicate>
+    static bool MatchesPredicate(const PhrasePredicate<DocumentPredicate>& phrase_predicate, int document_id,
+                                 DocumentStatus status, int rating);
+
+    // Нужно ли при обходе списков читать данные документа: не нужно, если документы уже
+    // отобраны выбором части по статусу, а политика ранжирования не использует длину документа
+    template <typename Scorer, typename DocumentPredicate>
+    static constexpr bool NeedsDocumentData();
+
+    // Отсортированные id документов, подходящих под фильтр, если по множеству допустимых
+    // документов или диапазону рейтинга их достаточно мало, чтобы проверить каждый вместо
+    // обхода списков слов запроса
+    std::optional<std::vector<int>> GetFilterCandidates(const Query& query, const DocumentFilter& filter) const;
+
+    // Поиск по документу за раз: для каждого кандидата проверяются слова запроса
+    template <typename Scorer>
+    std::vector<Document> FindCandidateDocuments(const Query& query, const std::vector<int>& candidates,
+                                                 size_t* posting_reads = nullptr) const;
+
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+                                           size_t* posting_reads = nullptr) const;
+
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+                                           size_t* posting_reads = nullptr) const;
+
+    template <typename Scorer, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+
+    // Части списков обязательных слов для данного статуса от самой короткой к самой длинной;
+    // пустой результат, если в какой-то части нет документов
+    std::vector<const PostingList*> GetRequiredPostings(const Query& query, DocumentStatus status) const;
+
+    // К posting_reads прибавляется число прочитанных элементов списков
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindRequiredDocuments(DocumentStatus status, const std::vector<const PostingList*>& required_postings,
+                                                size_t first, size_t last, const Query& query,
+                                                DocumentPredicate document_predicate, size_t& posting_reads) const;
+
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllRequiredDocuments(const std::execution::parallel_policy&, const Query& query,
+                                                   DocumentPredicate document_predicate, size_t* posting_reads = nullptr) const;
+
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindAllRequiredDocuments(const std::execution::sequenced_policy&, const Query& query,
+                                                   DocumentPredicate document_predicate, size_t* posting_reads = nullptr) const;
+};
+
+class SearchServer::PreparedQuery {
+private:
+    friend class SearchServer;
+
+    PreparedQuery(std::shared_ptr<const std::string> text, Query query, uint64_t index_version)
+            : text_(std::move(text))
+            , query_(std::move(query))
+            , index_version_(index_version) {
+    }
+
+    // слова запроса ссылаются на этот текст, поэтому он не перемещается вместе с объектом
+    std::shared_ptr<const std::string> text_;
+    Query query_;
+    uint64_t index_version_;
 };
 
 void AddDocument(SearchServer& search_server, int document_id, std::string_view document, DocumentStatus status,
@@ -127,123 +576,773 @@ void FindTopDocuments(const SearchServer& search_server, std::string_view raw_qu
 void MatchDocuments(const SearchServer& search_server, std::string_view query);
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-        : stop_words_(std::move(MakeUniqueNonEmptyStrings(stop_words)))
+SearchServer::SearchServer(const StringContainer& stop_words, IndexOptions options)
+        : options_(options)
+        , stop_words_(std::move(MakeUniqueNonEmptyStrings(stop_words)))
 {
     if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Недопустимые символы в стоп словах"s);
     }
 }
 
-template <class ExecutionPolicy, typename DocumentPredicate>
+template <class ExecutionPolicy, typename DocumentContainer>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents) {
+    CheckMutable();
+    std::vector<TokenizedDocument> tokenized_documents(documents.size());
+    // исключения внутри параллельного алгоритма приводят к std::terminate,
+    // поэтому ошибки разбора сохраняются и пробрасываются на этапе вставки
+    std::transform(policy,
+                   documents.begin(), documents.end(),
+                   tokenized_documents.begin(),
+                   [this](const auto& document) {
+                       TokenizedDocument result;
+                       try {
+                           result.words = SplitIntoWordsViewNoStop(document.text);
+                       } catch (...) {
+                           result.error = std::current_exception();
+                       }
+                       return result;
+                   });
+
+    auto it_document = documents.begin();
+    for (const TokenizedDocument& tokenized_document : tokenized_documents) {
+        CheckNewDocumentId(it_document->id);
+        if (tokenized_document.error) {
+            std::rethrow_exception(tokenized_document.error);
+        }
+        AddDocumentWords(it_document->id, it_document->text, tokenized_document.words, it_document->status, it_document->ratings);
+        ++it_document;
+    }
+}
+
+template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                     DocumentPredicate document_predicate, QueryMode mode) const {
+    Query query = ParseQuery(raw_query);
+    ApplyQueryMode(query, mode);
+    return FindTopQueryDocuments<Scorer>(policy, query, document_predicate);
+}
+
+template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
                                                      DocumentPredicate document_predicate) const {
-    const Query query = ParseQuery(raw_query); // sequenced_policy ParseQuery
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-    sort(policy,
-         matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    std::optional<Query> refreshed_query;
+    return FindTopQueryDocuments<Scorer>(policy, GetCurrentQuery(prepared_query, refreshed_query), document_predicate);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, prepared_query, document_predicate);
+}
+
+template <typename Scorer, class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
+                                                     DocumentStatus input_status) const {
+    return FindTopDocuments<Scorer, ExecutionPolicy, DocumentStatus>(policy, prepared_query, input_status);
+}
+
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& prepared_query, DocumentStatus input_status) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, prepared_query, input_status);
+}
+
+template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopQueryDocuments(const ExecutionPolicy& policy, const Query& query,
+                                                          DocumentPredicate document_predicate) const {
+    if constexpr (std::is_same_v<Scorer, TfIdfScorer> && std::is_same_v<DocumentPredicate, DocumentStatus>) {
+        if (CanUseImpacts(query)) {
+            return FindTopImpactDocuments(query, document_predicate);
+        }
+    }
+    std::vector<Document> matched_documents = FindAllQueryDocuments<Scorer>(policy, query, document_predicate);
+    SelectTopDocuments(policy, matched_documents);
+    return matched_documents;
+}
+
+template <typename Scorer, class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllQueryDocuments(const ExecutionPolicy& policy, const Query& query,
+                                                          DocumentPredicate document_predicate, size_t* posting_reads) const {
+    if (query.phrases.empty()) {
+        return FindAllDocuments<Scorer>(policy, query, document_predicate, posting_reads);
     }
+    // фразы проверяются заранее: по позициям только тех документов, где есть все слова фраз
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query, posting_reads);
+    return FindAllDocuments<Scorer>(policy, query, PhrasePredicate<DocumentPredicate>{phrase_documents, document_predicate},
+                                    posting_reads);
+}
 
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const PreparedQuery& prepared_query, const std::optional<Document>& after,
+                                                          size_t count, DocumentPredicate document_predicate) const {
+    std::optional<Query> refreshed_query;
+    // последовательный подсчёт даёт одинаковую релевантность при каждом вызове, и курсор
+    // предыдущей страницы точно разделяет выданные и оставшиеся документы
+    std::vector<Document> matched_documents =
+            FindAllQueryDocuments<Scorer>(std::execution::seq, GetCurrentQuery(prepared_query, refreshed_query), document_predicate);
+    if (after) {
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+                                               [&after](const Document& document) {
+                                                   return !IsRankedBefore(*after, document);
+                                               }),
+                                matched_documents.end());
+    }
+    SelectTopDocuments(std::execution::seq, matched_documents, count);
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const PreparedQuery& prepared_query, const std::optional<Document>& after,
+                                                          size_t count, DocumentStatus input_status) const {
+    return FindTopDocumentsAfter<Scorer, DocumentStatus>(prepared_query, after, count, input_status);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+QueryPlan SearchServer::PlanQuery(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+    std::optional<Query> refreshed_query;
+    return BuildQueryPlan<Scorer>(GetCurrentQuery(prepared_query, refreshed_query), document_predicate);
+}
+
+template <typename Scorer>
+QueryPlan SearchServer::PlanQuery(const PreparedQuery& prepared_query, DocumentStatus input_status) const {
+    return PlanQuery<Scorer, DocumentStatus>(prepared_query, input_status);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsPlanned(const PreparedQuery& prepared_query,
+                                                            DocumentPredicate document_predicate) const {
+    std::optional<Query> refreshed_query;
+    const Query& query = GetCurrentQuery(prepared_query, refreshed_query);
+    size_t scored_documents = 0;
+    return ExecuteQueryPlan<Scorer>(BuildQueryPlan<Scorer>(query, document_predicate), query, document_predicate, scored_documents);
+}
+
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocumentsPlanned(const PreparedQuery& prepared_query, DocumentStatus input_status) const {
+    return FindTopDocumentsPlanned<Scorer, DocumentStatus>(prepared_query, input_status);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+QueryExplanation SearchServer::ExplainQuery(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+    std::optional<Query> refreshed_query;
+    const Query& query = GetCurrentQuery(prepared_query, refreshed_query);
+    QueryExplanation explanation;
+    explanation.plan = BuildQueryPlan<Scorer>(query, document_predicate);
+    const auto start = std::chrono::steady_clock::now();
+    explanation.documents = ExecuteQueryPlan<Scorer>(explanation.plan, query, document_predicate, explanation.scored_documents,
+                                                     &explanation.posting_reads);
+    explanation.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return explanation;
+}
+
+template <typename Scorer>
+QueryExplanation SearchServer::ExplainQuery(const PreparedQuery& prepared_query, DocumentStatus input_status) const {
+    return ExplainQuery<Scorer, DocumentStatus>(prepared_query, input_status);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+QueryPlan SearchServer::BuildQueryPlan(const Query& query, const DocumentPredicate& document_predicate) const {
+    QueryPlan plan;
+    plan.document_count = GetDocumentCount();
+    plan.reads_document_data = NeedsDocumentData<Scorer, DocumentPredicate>();
+    const auto selected_postings = [&document_predicate](const StatusPostings* postings) {
+        size_t count = 0;
+        if (postings != nullptr) {
+            ForEachSelectedStatus(document_predicate, [postings, &count](DocumentStatus status) {
+                count += postings->Partition(status).size();
+            });
+        }
+        return count;
+    };
+
+    size_t plus_list_count = 0;
+    for (const QueryTerm& term : query.plus_words) {
+        const size_t count = selected_postings(term.postings);
+        plan.terms.push_back({std::string(term.word), TermRole::PLUS, term.is_expansion, count});
+        plan.plus_postings += count;
+        plus_list_count += count > 0;
+    }
+    for (const QueryTerm& term : query.required_words) {
+        for (PlannedTerm& planned_term : plan.terms) {
+            if (planned_term.word == term.word) {
+                planned_term.role = TermRole::REQUIRED;
+            }
+        }
+    }
+    for (const QueryTerm& term : query.minus_words) {
+        const size_t count = selected_postings(term.postings);
+        plan.terms.push_back({std::string(term.word), TermRole::MINUS, term.is_expansion, count});
+        plan.minus_postings += count;
+    }
+    std::stable_sort(plan.terms.begin(), plan.terms.end(), [](const PlannedTerm& lhs, const PlannedTerm& rhs) {
+        return lhs.document_count < rhs.document_count;
+    });
+
+    // чтение данных документа - поиск по дереву документов или столбцам замороженного индекса
+    const double document_count = std::max<size_t>(plan.document_count, 1);
+    const double lookup_cost = plan.reads_document_data ? std::log2(document_count) + 1.0 : 0.0;
+    // минус-слова и фразы проверяются заранее при любом способе
+    double common_cost = plan.minus_postings;
+    for (const Phrase& phrase : query.phrases) {
+        for (const std::string_view word : phrase.words) {
+            const QueryTerm term = FindQueryTerm(word);
+            common_cost += term.postings == nullptr ? 0 : term.postings->size();
+        }
+    }
+    const double plus_postings = plan.plus_postings;
+    plan.estimated_matches = std::min(plan.plus_postings, plan.document_count);
+
+    if (!query.required_words.empty()) {
+        // обходится самый короткий список обязательных слов, в остальных списках документ ищется
+        // с переходом вперёд за логарифм от отношения длин
+        size_t rarest_count = plan.document_count;
+        for (const QueryTerm& term : query.required_words) {
+            rarest_count = std::min(rarest_count, selected_postings(term.postings));
+        }
+        double probe_cost = 1.0 + lookup_cost;
+        for (const QueryTerm& term : query.plus_words) {
+            probe_cost += std::log2(selected_postings(term.postings) / std::max<double>(rarest_count, 1.0) + 1.0);
+        }
+        plan.estimated_matches = rarest_count;
+        plan.alternatives.emplace_back(QueryStrategy::INTERSECTION, common_cost + rarest_count * probe_cost);
+    } else {
+        const double exhaustive_cost = plus_postings * (1.0 + lookup_cost);
+        plan.alternatives.emplace_back(QueryStrategy::SEQUENTIAL, common_cost + exhaustive_cost);
+        // списки плюс-слов делятся между потоками целиком
+        const size_t worker_count = std::min<size_t>(std::thread::hardware_concurrency(), plus_list_count);
+        if (worker_count > 1) {
+            plan.alternatives.emplace_back(QueryStrategy::PARALLEL,
+                                           common_cost + exhaustive_cost / worker_count + PLANNER_PARALLEL_OVERHEAD);
+        }
+        // битовая карта выгодна, только если данные документа нужны лишь предикату:
+        // длину документа для политики ранжирования всё равно пришлось бы читать
+        if (plan.reads_document_data && !Scorer::USES_DOCUMENT_LENGTH) {
+            plan.alternatives.emplace_back(QueryStrategy::BITMAP,
+                                           common_cost + document_count * (1.0 + lookup_cost) + plus_postings);
+        }
+        if constexpr (std::is_same_v<Scorer, TfIdfScorer> && std::is_same_v<DocumentPredicate, DocumentStatus>) {
+            if (CanUseImpacts(query)) {
+                plan.alternatives.emplace_back(QueryStrategy::IMPACT_PRUNING,
+                                               common_cost + plus_postings * PLANNER_IMPACT_POSTING_COST);
+            }
+        }
+    }
+
+    const auto cheapest = std::min_element(plan.alternatives.begin(), plan.alternatives.end(),
+                                           [](const auto& lhs, const auto& rhs) {
+                                               return lhs.second < rhs.second;
+                                           });
+    plan.strategy = cheapest->first;
+    plan.estimated_cost = cheapest->second;
+    return plan;
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::ExecuteQueryPlan(const QueryPlan& plan, const Query& query, DocumentPredicate document_predicate,
+                                                     size_t& scored_documents, size_t* posting_reads) const {
+    if constexpr (std::is_same_v<Scorer, TfIdfScorer> && std::is_same_v<DocumentPredicate, DocumentStatus>) {
+        if (plan.strategy == QueryStrategy::IMPACT_PRUNING && CanUseImpacts(query)) {
+            return FindTopImpactDocuments(query, document_predicate, &scored_documents, posting_reads);
+        }
+    }
+    std::vector<Document> matched_documents;
+    if (plan.strategy == QueryStrategy::INTERSECTION) {
+        matched_documents = FindAllRequiredQueryDocuments<Scorer>(query, document_predicate, posting_reads);
+    } else if (plan.strategy == QueryStrategy::PARALLEL) {
+        matched_documents = FindAllQueryDocuments<Scorer>(std::execution::par, query, document_predicate, posting_reads);
+    } else if (plan.strategy == QueryStrategy::BITMAP) {
+        matched_documents = FindAllBitmapQueryDocuments<Scorer>(query, document_predicate, posting_reads);
+    } else {
+        matched_documents = FindAllQueryDocuments<Scorer>(std::execution::seq, query, document_predicate, posting_reads);
+    }
+    scored_documents = matched_documents.size();
+    SelectTopDocuments(std::execution::seq, matched_documents);
+    return matched_documents;
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllBitmapQueryDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                                size_t* posting_reads) const {
+    if (query.phrases.empty()) {
+        return FindAllBitmapDocuments<Scorer>(query, document_predicate, posting_reads);
+    }
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query, posting_reads);
+    return FindAllBitmapDocuments<Scorer>(query, PhrasePredicate<DocumentPredicate>{phrase_documents, document_predicate},
+                                          posting_reads);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllRequiredQueryDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                                  size_t* posting_reads) const {
+    if (query.phrases.empty()) {
+        return FindAllRequiredDocuments<Scorer>(std::execution::seq, query, document_predicate, posting_reads);
+    }
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query, posting_reads);
+    return FindAllRequiredDocuments<Scorer>(std::execution::seq, query,
+                                            PhrasePredicate<DocumentPredicate>{phrase_documents, document_predicate}, posting_reads);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllBitmapDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                           size_t* posting_reads) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>) {
+        if (const auto candidates = GetFilterCandidates(query, document_predicate)) {
+            return FindCandidateDocuments<Scorer>(query, *candidates, posting_reads);
+        }
+    }
+
+    if (!query.required_words.empty()) {
+        return FindAllRequiredDocuments<Scorer>(std::execution::seq, query, document_predicate, posting_reads);
+    }
+
+    const RoaringBitmap excluded_documents = BuildExclusionBitmap(query, document_predicate, posting_reads);
+    RoaringBitmap selected_documents(GetQueryMemory());
+    const auto select_document = [&](int document_id, const DocumentAttributes& current_document) {
+        if (!excluded_documents.Contains(document_id)
+            && MatchesPredicate(document_predicate, document_id, current_document.status, current_document.rating)) {
+            selected_documents.Add(document_id);
+        }
+    };
+    if (frozen_index_) {
+        // столбцы замороженного индекса упорядочены по id, как и document_ids_
+        for (size_t index = 0; index < frozen_index_->DocumentCount(); ++index) {
+            select_document(frozen_index_->DocumentId(index), frozen_index_->DocumentAt(index));
+        }
+    } else {
+        for (const int document_id : document_ids_) {
+            select_document(document_id, GetDocumentAttributes(document_id));
+        }
+    }
+
+    std::pmr::map<int, double> document_to_relevance(GetQueryMemory());
+    const CollectionStats stats = GetCollectionStats();
+    for (const QueryTerm& term : query.plus_words) {
+        if (term.postings == nullptr) {
+            continue;
+        }
+        const double term_weight = Scorer::TermWeight(stats, term.postings->size());
+        ForEachSelectedStatus(document_predicate, [&](DocumentStatus status) {
+            AddPostingReads(posting_reads, term.postings->Partition(status).size());
+            for (const auto& [document_id, term_freq] : term.postings->Partition(status)) {
+                if (!selected_documents.Contains(document_id)) {
+                    continue;
+                }
+                if constexpr (Scorer::USES_DOCUMENT_LENGTH) {
+                    document_to_relevance[document_id] +=
+                            Scorer::Score(term_freq, term_weight, GetDocumentAttributes(document_id).word_count, stats);
+                } else {
+                    document_to_relevance[document_id] += Scorer::Score(term_freq, term_weight, 0, stats);
+                }
+            }
+        });
+    }
+
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto& [document_id, relevance] : document_to_relevance) {
+        matched_documents.push_back({
+                                            document_id,
+                                            relevance,
+                                            GetDocumentAttributes(document_id).rating
+                                    });
+    }
+    return matched_documents;
 }
 
 template <class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                                     DocumentStatus input_status) const {
-    return FindTopDocuments(policy, raw_query,
-                            [input_status](int document_id, DocumentStatus status, int rating) { return status == input_status; });
+void SearchServer::SelectTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& matched_documents, size_t count) {
+    if (matched_documents.size() > count) {
+        // лучшие count документов отделяются за линейное время, остальные не сортируются
+        nth_element(policy,
+                    matched_documents.begin(), matched_documents.begin() + count, matched_documents.end(),
+                    IsRankedBefore);
+        matched_documents.resize(count);
+    }
+    sort(policy, matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     QueryMode mode) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, document_predicate, mode);
+}
+
+template <typename Scorer, class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                     DocumentStatus input_status, QueryMode mode) const {
+    // статус передаётся дальше как есть: поиск обойдёт только часть списков с этим статусом
+    return FindTopDocuments<Scorer, ExecutionPolicy, DocumentStatus>(policy, raw_query, input_status, mode);
+}
+
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus input_status, QueryMode mode) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, input_status, mode);
+}
+
+template <typename DocumentPredicate>
+RoaringBitmap SearchServer::BuildExclusionBitmap(const Query& query, const DocumentPredicate& document_predicate,
+                                                 size_t* posting_reads) const {
+    RoaringBitmap excluded_documents(GetQueryMemory());
+    for (const QueryTerm& term : query.minus_words) {
+        if (term.postings == nullptr) {
+            continue;
+        }
+        ForEachSelectedStatus(document_predicate, [&excluded_documents, &term, posting_reads](DocumentStatus status) {
+            // id списка идут по возрастанию и дописываются в конец блоков, а списки объединяются поблочно
+            const PostingList& postings = term.postings->Partition(status);
+            AddPostingReads(posting_reads, postings.size());
+            RoaringBitmap term_documents(GetQueryMemory());
+            for (size_t i = 0; i < postings.size(); ++i) {
+                term_documents.Add(postings.DocumentId(i));
+            }
+            excluded_documents.Or(term_documents);
+        });
+    }
+    return excluded_documents;
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::IsStatusSelected(const DocumentPredicate&, DocumentStatus) {
+    return true;
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::IsStatusSelected(const PhrasePredicate<DocumentPredicate>& phrase_predicate, DocumentStatus status) {
+    return IsStatusSelected(phrase_predicate.document_predicate, status);
+}
+
+template <typename DocumentPredicate, typename Function>
+void SearchServer::ForEachSelectedStatus(const DocumentPredicate& document_predicate, Function function) {
+    for (int status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index) {
+        const auto status = static_cast<DocumentStatus>(status_index);
+        if (IsStatusSelected(document_predicate, status)) {
+            function(status);
+        }
+    }
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
+bool SearchServer::MatchesPredicate(const DocumentPredicate& document_predicate, int document_id, DocumentStatus status, int rating) {
+    return document_predicate(document_id, status, rating);
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::MatchesPredicate(const PhrasePredicate<DocumentPredicate>& phrase_predicate, int document_id,
+                                    DocumentStatus status, int rating) {
+    return std::binary_search(phrase_predicate.phrase_documents.begin(), phrase_predicate.phrase_documents.end(), document_id)
+           && MatchesPredicate(phrase_predicate.document_predicate, document_id, status, rating);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+constexpr bool SearchServer::NeedsDocumentData() {
+    return Scorer::USES_DOCUMENT_LENGTH || !std::is_same_v<DocumentPredicate, DocumentStatus>;
+}
+
+template <typename Scorer>
+std::vector<Document> SearchServer::FindCandidateDocuments(const Query& query, const std::vector<int>& candidates,
+                                                          size_t* posting_reads) const {
+    struct TermPostings {
+        const StatusPostings* postings;
+        double term_weight;
+    };
+
+    const CollectionStats stats = GetCollectionStats();
+    std::vector<TermPostings> plus_postings;
+    for (const QueryTerm& term : query.plus_words) {
+        if (term.postings != nullptr) {
+            plus_postings.push_back({term.postings, Scorer::TermWeight(stats, term.postings->size())});
+        }
+    }
+    std::vector<const StatusPostings*> required_postings;
+    for (const QueryTerm& term : query.required_words) {
+        if (term.postings == nullptr) {
+            return {};
+        }
+        required_postings.push_back(term.postings);
+    }
+    std::vector<const StatusPostings*> minus_postings;
+    for (const QueryTerm& term : query.minus_words) {
+        if (term.postings != nullptr) {
+            minus_postings.push_back(term.postings);
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    size_t probe_count = 0;
+    for (const int document_id : candidates) {
+        const DocumentAttributes current_document = GetDocumentAttributes(document_id);
+        const DocumentStatus status = current_document.status;
+        const auto contains_document = [document_id, status, &probe_count](const StatusPostings* postings) {
+            ++probe_count;
+            return postings->Partition(status).Contains(document_id);
+        };
+        if (!std::all_of(required_postings.begin(), required_postings.end(), contains_document)
+            || std::any_of(minus_postings.begin(), minus_postings.end(), contains_document)) {
+            continue;
+        }
+
+        // слагаемые релевантности добавляются в порядке plus_words, как при обходе по словам
+        double relevance = 0.0;
+        bool has_plus_word = false;
+        probe_count += plus_postings.size();
+        for (const auto& [postings, term_weight] : plus_postings) {
+            const PostingList& partition = postings->Partition(status);
+            const size_t index = partition.Find(document_id);
+            if (index != partition.size()) {
+                relevance += Scorer::Score(partition.TermFreq(index), term_weight, current_document.word_count, stats);
+                has_plus_word = true;
+            }
+        }
+        if (has_plus_word) {
+            matched_documents.push_back({document_id, relevance, current_document.rating});
+        }
+    }
+    AddPostingReads(posting_reads, probe_count);
+    return matched_documents;
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+                                                     size_t* posting_reads) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>) {
+        if (const auto candidates = GetFilterCandidates(query, document_predicate)) {
+            return FindCandidateDocuments<Scorer>(query, *candidates, posting_reads);
+        }
+    }
+
+    if (!query.required_words.empty()) {
+        return FindAllRequiredDocuments<Scorer>(std::execution::par, query, document_predicate, posting_reads);
+    }
+
     ConcurrentMap<int, double> document_to_relevance(std::max(GetDocumentCount() / CONCURRENT_MAP_BUCKET_COUNT, 1));
+    const CollectionStats stats = GetCollectionStats();
+    // документы с минус-словами отсекаются до подсчёта релевантности, без блокировок
+    const RoaringBitmap excluded_documents = BuildExclusionBitmap(query, document_predicate, posting_reads);
+    std::atomic<size_t> plus_reads = 0;
     std::for_each(std::execution::par,
                   query.plus_words.begin(),  query.plus_words.end(),
-                  [this, &document_to_relevance, document_predicate](std::string_view word) {
-                      if (word_to_document_freqs_.count(word)) {
-                          for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                              const DocumentData& current_document = documents_.at(document_id);
-                              if (document_predicate(document_id, current_document.status, current_document.rating)) {
-                                  const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                                  document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                  [this, &document_to_relevance, &stats, &excluded_documents, &document_predicate, &plus_reads](const QueryTerm& term) {
+                      if (term.postings == nullptr) {
+                          return;
+                      }
+                      const double term_weight = Scorer::TermWeight(stats, term.postings->size());
+                      ForEachSelectedStatus(document_predicate, [&](DocumentStatus status) {
+                          plus_reads.fetch_add(term.postings->Partition(status).size(), std::memory_order_relaxed);
+                          for (const auto& [document_id, term_freq] : term.postings->Partition(status)) {
+                              if (excluded_documents.Contains(document_id)) {
+                                  continue;
+                              }
+                              if constexpr (NeedsDocumentData<Scorer, DocumentPredicate>()) {
+                                  const DocumentAttributes current_document = GetDocumentAttributes(document_id);
+                                  if (MatchesPredicate(document_predicate, document_id, current_document.status, current_document.rating)) {
+                                      document_to_relevance[document_id].ref_to_value +=
+                                              Scorer::Score(term_freq, term_weight, current_document.word_count, stats);
+                                  }
+                              } else {
+                                  document_to_relevance[document_id].ref_to_value += Scorer::Score(term_freq, term_weight, 0, stats);
                               }
                           }
-                      }
-                  });
-
-    std::for_each(std::execution::par,
-                  query.minus_words.begin(),  query.minus_words.end(),
-                  [this, &document_to_relevance](std::string_view word) {
-                      for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-                          document_to_relevance.Erase(document_id);
-                      }
+                      });
                   });
+    AddPostingReads(posting_reads, plus_reads);
 
     std::vector<Document> matched_documents;
     for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
         matched_documents.push_back({
                                             document_id,
                                             relevance,
-                                            documents_.at(document_id).rating
+                                            GetDocumentAttributes(document_id).rating
                                     });
     }
 
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const DocumentData& current_document = documents_.at(document_id);
-            if (document_predicate(document_id, current_document.status, current_document.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+                                                     size_t* posting_reads) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>) {
+        if (const auto candidates = GetFilterCandidates(query, document_predicate)) {
+            return FindCandidateDocuments<Scorer>(query, *candidates, posting_reads);
         }
     }
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    if (!query.required_words.empty()) {
+        return FindAllRequiredDocuments<Scorer>(std::execution::seq, query, document_predicate, posting_reads);
+    }
+
+    std::pmr::map<int, double> document_to_relevance(GetQueryMemory());
+    const CollectionStats stats = GetCollectionStats();
+    const RoaringBitmap excluded_documents = BuildExclusionBitmap(query, document_predicate, posting_reads);
+    for (const QueryTerm& term : query.plus_words) {
+        if (term.postings == nullptr) {
             continue;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
+        const double term_weight = Scorer::TermWeight(stats, term.postings->size());
+        ForEachSelectedStatus(document_predicate, [&](DocumentStatus status) {
+            AddPostingReads(posting_reads, term.postings->Partition(status).size());
+            for (const auto& [document_id, term_freq] : term.postings->Partition(status)) {
+                if (excluded_documents.Contains(document_id)) {
+                    continue;
+                }
+                if constexpr (NeedsDocumentData<Scorer, DocumentPredicate>()) {
+                    const DocumentAttributes current_document = GetDocumentAttributes(document_id);
+                    if (MatchesPredicate(document_predicate, document_id, current_document.status, current_document.rating)) {
+                        document_to_relevance[document_id] += Scorer::Score(term_freq, term_weight, current_document.word_count, stats);
+                    }
+                } else {
+                    document_to_relevance[document_id] += Scorer::Score(term_freq, term_weight, 0, stats);
+                }
+            }
+        });
     }
 
     std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
     for (const auto& [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({
                                             document_id,
                                             relevance,
-                                            documents_.at(document_id).rating
+                                            GetDocumentAttributes(document_id).rating
                                     });
     }
 
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
+template <typename Scorer, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+    return FindAllDocuments<Scorer>(std::execution::seq, query, document_predicate);
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindRequiredDocuments(DocumentStatus status, const std::vector<const PostingList*>& required_postings,
+                                                          size_t first, size_t last, const Query& query,
+                                                          DocumentPredicate document_predicate, size_t& posting_reads) const {
+    struct ScoredPostings {
+        const PostingList* postings;
+        double term_weight;
+        size_t cursor;
+    };
+
+    const CollectionStats stats = GetCollectionStats();
+    // слагаемые релевантности добавляются в порядке plus_words, как при обходе по словам.
+    // Документ со статусом status может встретиться только в части списка с этим статусом
+    std::vector<ScoredPostings> scored_postings;
+    for (const QueryTerm& term : query.plus_words) {
+        if (term.postings != nullptr && !term.postings->Partition(status).empty()) {
+            scored_postings.push_back({&term.postings->Partition(status), Scorer::TermWeight(stats, term.postings->size()), 0});
+        }
+    }
+    std::vector<std::pair<const PostingList*, size_t>> minus_postings;
+    for (const QueryTerm& term : query.minus_words) {
+        if (term.postings != nullptr) {
+            minus_postings.push_back({&term.postings->Partition(status), 0});
+        }
+    }
+    std::vector<size_t> required_cursors(required_postings.size(), 0);
+
+    std::vector<Document> matched_documents;
+    const PostingList& rarest_postings = *required_postings.front();
+    for (size_t index = first; index < last; ++index) {
+        const int document_id = rarest_postings.DocumentId(index);
+        ++posting_reads;
+
+        bool is_matched = true;
+        for (size_t i = 1; i < required_postings.size() && is_matched; ++i) {
+            ++posting_reads;
+            required_cursors[i] = required_postings[i]->Advance(required_cursors[i], document_id);
+            if (required_cursors[i] == required_postings[i]->size()) {
+                // более длинный список закончился - дальше совпадений нет
+                return matched_documents;
+            }
+            is_matched = required_postings[i]->DocumentId(required_cursors[i]) == document_id;
+        }
+        for (auto& [postings, cursor] : minus_postings) {
+            if (!is_matched) {
+                break;
+            }
+            ++posting_reads;
+            cursor = postings->Advance(cursor, document_id);
+            is_matched = cursor == postings->size() || postings->DocumentId(cursor) != document_id;
+        }
+        if (!is_matched) {
+            continue;
+        }
+
+        const DocumentAttributes current_document = GetDocumentAttributes(document_id);
+        if (!MatchesPredicate(document_predicate, document_id, current_document.status, current_document.rating)) {
+            continue;
+        }
+        double relevance = 0.0;
+        posting_reads += scored_postings.size();
+        for (ScoredPostings& scored : scored_postings) {
+            scored.cursor = scored.postings->Advance(scored.cursor, document_id);
+            if (scored.cursor < scored.postings->size() && scored.postings->DocumentId(scored.cursor) == document_id) {
+                relevance += Scorer::Score(scored.postings->TermFreq(scored.cursor), scored.term_weight,
+                                           current_document.word_count, stats);
+            }
+        }
+        matched_documents.push_back({document_id, relevance, current_document.rating});
+    }
+    return matched_documents;
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllRequiredDocuments(const std::execution::parallel_policy&, const Query& query,
+                                                             DocumentPredicate document_predicate, size_t* posting_reads) const {
+    struct IntersectionChunk {
+        DocumentStatus status;
+        std::vector<const PostingList*> required_postings;
+        size_t first;
+        size_t last;
+    };
+
+    // самый короткий список каждой части делится на куски, каждый пересекается с остальными независимо
+    std::vector<IntersectionChunk> chunks;
+    ForEachSelectedStatus(document_predicate, [this, &query, &chunks](DocumentStatus status) {
+        const std::vector<const PostingList*> required_postings = GetRequiredPostings(query, status);
+        if (required_postings.empty()) {
+            return;
+        }
+        const size_t rarest_size = required_postings.front()->size();
+        const size_t chunk_count = std::max<size_t>(1, rarest_size / MIN_INTERSECTION_CHUNK_SIZE);
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            chunks.push_back({status, required_postings, rarest_size * chunk / chunk_count, rarest_size * (chunk + 1) / chunk_count});
+        }
+    });
+
+    std::vector<std::vector<Document>> chunk_documents(chunks.size());
+    std::vector<size_t> chunk_reads(chunks.size());
+    std::transform(std::execution::par,
+                   chunks.begin(), chunks.end(),
+                   chunk_documents.begin(),
+                   [this, &query, &document_predicate, &chunks, &chunk_reads](const IntersectionChunk& chunk) {
+                       return FindRequiredDocuments<Scorer>(chunk.status, chunk.required_postings, chunk.first, chunk.last,
+                                                            query, document_predicate, chunk_reads[&chunk - chunks.data()]);
+                   });
+    AddPostingReads(posting_reads, std::accumulate(chunk_reads.begin(), chunk_reads.end(), size_t{0}));
+
+    std::vector<Document> matched_documents;
+    for (const std::vector<Document>& documents : chunk_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    return matched_documents;
+}
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllRequiredDocuments(const std::execution::sequenced_policy&, const Query& query,
+                                                             DocumentPredicate document_predicate, size_t* posting_reads) const {
+    std::vector<Document> matched_documents;
+    size_t read_count = 0;
+    ForEachSelectedStatus(document_predicate, [&](DocumentStatus status) {
+        const std::vector<const PostingList*> required_postings = GetRequiredPostings(query, status);
+        if (required_postings.empty()) {
+            return;
+        }
+        const std::vector<Document> documents = FindRequiredDocuments<Scorer>(status, required_postings, 0, required_postings.front()->size(),
+                                                                              query, document_predicate, read_count);
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    });
+    AddPostingReads(posting_reads, read_count);
+    return matched_documents;
 }
@@ -0,0 +1,67 @@
+#include "snippet.h"
+#include "string_processing.h"
+
+#include <algorithm>
+
+using namespace std;
+
+Snippet BuildSnippet(string_view text, const vector<string_view>& words, const vector<double>& weights, size_t window_size) {
+    const vector<string_view> tokens = SplitIntoWordsView(text);
+    if (tokens.empty() || window_size == 0) {
+        return {};
+    }
+    // номер слова из words для каждого слова текста или words.size(), если слово не искали
+    vector<size_t> token_words(tokens.size());
+    transform(tokens.begin(), tokens.end(), token_words.begin(), [&words](string_view token) {
+        return static_cast<size_t>(find(words.begin(), words.end(), token) - words.begin());
+    });
+
+    // окно [first, first + window_size) сдвигается по словам, для слов в окне считается число вхождений
+    vector<int> counts(words.size(), 0);
+    double weight = 0.0;
+    const auto add_token = [&](size_t token, int delta) {
+        const size_t word = token_words[token];
+        if (word == words.size()) {
+            return;
+        }
+        if ((counts[word] == 0 && delta > 0) || (counts[word] == 1 && delta < 0)) {
+            weight += delta * weights[word];
+        }
+        counts[word] += delta;
+    };
+    const size_t window_end = min(window_size, tokens.size());
+    for (size_t token = 0; token < window_end; ++token) {
+        add_token(token, 1);
+    }
+    size_t best_first = 0;
+    double best_weight = weight;
+    for (size_t first = 1; first + window_size <= tokens.size(); ++first) {
+        add_token(first - 1, -1);
+        add_token(first + window_size - 1, 1);
+        if (weight > best_weight) {
+            best_weight = weight;
+            best_first = first;
+        }
+    }
+
+    const size_t best_last = min(best_first + window_size, tokens.size()) - 1;
+    const size_t begin_offset = tokens[best_first].data() - text.data();
+    const size_t end_offset = tokens[best_last].data() + tokens[best_last].size() - text.data();
+    Snippet snippet{string(text.substr(begin_offset, end_offset - begin_offset)), {}};
+    for (size_t token = best_first; token <= best_last; ++token) {
+        if (token_words[token] != words.size()) {
+            snippet.highlights.push_back({static_cast<size_t>(tokens[token].data() - text.data()) - begin_offset, tokens[token].size()});
+        }
+    }
+    return snippet;
+}
+
+ostream& operator<<(ostream& out, const Snippet& snippet) {
+    size_t position = 0;
+    for (const auto& [offset, length] : snippet.highlights) {
+        out << snippet.text.substr(position, offset - position) << '[' << snippet.text.substr(offset, length) << ']';
+        position = offset + length;
+    }
+    out << snippet.text.substr(position);
+    return out;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t DEFAULT_SNIPPET_WORD_COUNT = 20;
+
+// Найденное слово внутри фрагмента: смещение и длина в байтах
+struct Highlight {
+    size_t offset;
+    size_t length;
+};
+
+struct Snippet {
+    std::string text;
+    std::vector<Highlight> highlights;
+};
+
+// Окно из window_size слов текста, в котором сумма весов различных встретившихся слов
+// words максимальна (weights[i] - вес words[i]); при равенстве выбирается более раннее.
+// Если ни одно слово не встречается, возвращается начало текста без выделений
+Snippet BuildSnippet(std::string_view text, const std::vector<std::string_view>& words, const std::vector<double>& weights,
+                     size_t window_size);
+
+// Фрагмент, в котором найденные слова заключены в квадратные скобки
+std::ostream& operator<<(std::ostream& out, const Snippet& snippet);
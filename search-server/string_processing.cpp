@@ -21,8 +21,10 @@ vector<string> SplitIntoWords(const string& text) {
     return words;
 }
 
-vector<string_view> SplitIntoWordsView(string_view str) {
-    vector<string_view> result;
+namespace {
+
+template <typename WordContainer>
+void SplitIntoWordsViewTo(string_view str, WordContainer& result) {
     str.remove_prefix(min(str.find_first_not_of(" "), str.size()));
     const int64_t pos_end = str.npos;
 
@@ -31,6 +33,18 @@ vector<string_view> SplitIntoWordsView(string_view str) {
         result.push_back(space == pos_end ? str.substr() : str.substr(0, space));
         str.remove_prefix(min(str.find_first_not_of(" ", space), str.size()));
     }
+}
+
+} // namespace
+
+vector<string_view> SplitIntoWordsView(string_view str) {
+    vector<string_view> result;
+    SplitIntoWordsViewTo(str, result);
+    return result;
+}
 
+pmr::vector<string_view> SplitIntoWordsView(string_view str, pmr::memory_resource* memory) {
+    pmr::vector<string_view> result(memory);
+    SplitIntoWordsViewTo(str, result);
     return result;
 }
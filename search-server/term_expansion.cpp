@@ -0,0 +1,67 @@
+#include "term_expansion.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+optional<TermPattern> ParseTermPattern(string_view word) {
+    if (!word.empty() && word.back() == '*') {
+        word.remove_suffix(1);
+        if (word.empty()) {
+            throw invalid_argument("Пустой префикс в запросе"s);
+        }
+        return TermPattern{word, PatternType::PREFIX, 0};
+    }
+
+    const size_t tilde = word.rfind('~');
+    if (tilde == word.npos) {
+        return nullopt;
+    }
+    const string_view edits = word.substr(tilde + 1);
+    if (edits.empty() || !all_of(edits.begin(), edits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        // тильда внутри слова - часть слова
+        return nullopt;
+    }
+    const int max_edits = edits.size() == 1 ? edits[0] - '0' : MAX_FUZZY_EDITS + 1;
+    if (tilde == 0 || max_edits < 1 || max_edits > MAX_FUZZY_EDITS) {
+        throw invalid_argument("Некорректный нечёткий поиск "s + string(word));
+    }
+    return TermPattern{word.substr(0, tilde), PatternType::FUZZY, max_edits};
+}
+
+void DecodeUtf8(string_view word, vector<Utf8Letter>& letters) {
+    // некорректные байты получают значения за последним code point Unicode
+    const char32_t invalid_byte_base = 0x110000;
+    letters.clear();
+    size_t position = 0;
+    while (position < word.size()) {
+        const unsigned char lead = static_cast<unsigned char>(word[position]);
+        size_t size = 1;
+        char32_t code_point = lead;
+        if (lead >= 0xC0 && lead < 0xE0) {
+            size = 2;
+            code_point = lead & 0x1F;
+        } else if (lead >= 0xE0 && lead < 0xF0) {
+            size = 3;
+            code_point = lead & 0x0F;
+        } else if (lead >= 0xF0 && lead < 0xF8) {
+            size = 4;
+            code_point = lead & 0x07;
+        } else if (lead >= 0x80) {
+            code_point = invalid_byte_base + lead;
+        }
+        bool is_valid = position + size <= word.size();
+        for (size_t i = 1; is_valid && i < size; ++i) {
+            const unsigned char continuation = static_cast<unsigned char>(word[position + i]);
+            is_valid = (continuation & 0xC0) == 0x80;
+            code_point = code_point << 6 | (continuation & 0x3F);
+        }
+        if (!is_valid) {
+            size = 1;
+            code_point = invalid_byte_base + lead;
+        }
+        position += size;
+        letters.push_back({code_point, position});
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Наибольшее число слов словаря, которыми заменяется один шаблон запроса.
+// Ограничивает время запроса с коротким префиксом или большим расстоянием;
+// остаются ближайшие к шаблону слова, поэтому слово самого шаблона не отбрасывается
+const int MAX_PATTERN_EXPANSIONS = 64;
+const int MAX_FUZZY_EDITS = 2;
+
+enum class PatternType {
+    PREFIX,  // слово* - слова словаря с этим префиксом
+    FUZZY,   // слово~N - слова словаря на расстоянии Левенштейна не больше N
+};
+
+struct TermPattern {
+    std::string_view text;
+    PatternType type = PatternType::PREFIX;
+    int max_edits = 0;
+};
+
+// Шаблон, если слово запроса оканчивается на * или ~N; для некорректного шаблона
+// (пустое слово или N вне [1, MAX_FUZZY_EDITS]) бросает std::invalid_argument
+std::optional<TermPattern> ParseTermPattern(std::string_view word);
+
+// Буква слова в UTF-8: code point и смещение байта за ней. Байт, не начинающий
+// корректную последовательность, - отдельная буква, не равная ни одному code point
+struct Utf8Letter {
+    char32_t code_point = 0;
+    size_t end = 0;
+};
+
+// Заменяет содержимое letters буквами word
+void DecodeUtf8(std::string_view word, std::vector<Utf8Letter>& letters);
+
+// Обходит в алфавитном порядке слова отсортированного словаря, подходящие под шаблон.
+// seek(word) возвращает позицию первого слова не меньше word, end - конец словаря,
+// word_at(position) - слово в позиции. callback(position, edits) получает расстояние
+// Левенштейна в буквах от шаблона до слова (для префикса - число букв после него),
+// обход останавливается, когда callback вернёт false. Слова с префиксом обходятся начиная
+// с поиска префикса. Для нечёткого шаблона строки таблицы расстояний общего префикса
+// соседних слов считаются один раз, а если все значения строки больше max_edits, ни одно
+// слово с этим префиксом не подходит - обход переходит к первому слову за ними, как
+// автомат Левенштейна по словарю-дереву. Буквы сравниваются по code point, поэтому
+// замена или удаление кириллической буквы - одна правка, а не две
+template <typename Seek, typename Position, typename WordAt, typename Callback>
+void ForEachPatternTerm(const TermPattern& pattern, Seek seek, Position end, WordAt word_at, Callback callback) {
+    std::vector<Utf8Letter> target;
+    DecodeUtf8(pattern.text, target);
+    std::vector<Utf8Letter> letters;
+    if (pattern.type == PatternType::PREFIX) {
+        for (Position position = seek(pattern.text); position != end; ++position) {
+            const std::string_view word = word_at(position);
+            if (word.substr(0, pattern.text.size()) != pattern.text) {
+                return;
+            }
+            DecodeUtf8(word.substr(pattern.text.size()), letters);
+            if (!callback(position, static_cast<int>(letters.size()))) {
+                return;
+            }
+        }
+        return;
+    }
+
+    const size_t row_size = target.size() + 1;
+    // rows[d * row_size + j] - расстояние между первыми d буквами слова и первыми j буквами target
+    std::vector<int> rows(row_size);
+    for (size_t j = 0; j < row_size; ++j) {
+        rows[j] = static_cast<int>(j);
+    }
+    std::vector<Utf8Letter> previous_letters;
+    Position position = seek(std::string_view());
+    while (position != end) {
+        const std::string_view word = word_at(position);
+        DecodeUtf8(word, letters);
+        size_t depth = 0;
+        const size_t computed_depth = rows.size() / row_size - 1;
+        while (depth < computed_depth && depth < letters.size() && depth < previous_letters.size()
+               && letters[depth].code_point == previous_letters[depth].code_point) {
+            ++depth;
+        }
+        rows.resize((depth + 1) * row_size);
+
+        bool is_pruned = false;
+        for (; depth < letters.size(); ++depth) {
+            rows.resize((depth + 2) * row_size);
+            const int* row = rows.data() + depth * row_size;
+            int* next_row = rows.data() + (depth + 1) * row_size;
+            next_row[0] = row[0] + 1;
+            int row_min = next_row[0];
+            for (size_t j = 1; j < row_size; ++j) {
+                const int substitution = row[j - 1] + (target[j - 1].code_point == letters[depth].code_point ? 0 : 1);
+                next_row[j] = std::min({row[j] + 1, next_row[j - 1] + 1, substitution});
+                row_min = std::min(row_min, next_row[j]);
+            }
+            if (row_min > pattern.max_edits) {
+                is_pruned = true;
+                break;
+            }
+        }
+
+        std::swap(previous_letters, letters);
+        if (!is_pruned) {
+            const int edits = rows[previous_letters.size() * row_size + target.size()];
+            if (edits <= pattern.max_edits && !callback(position, edits)) {
+                return;
+            }
+            ++position;
+            continue;
+        }
+        // следующее слово, не начинающееся с первых depth + 1 букв word
+        std::string successor(word.substr(0, previous_letters[depth].end));
+        while (!successor.empty() && static_cast<unsigned char>(successor.back()) == 0xFF) {
+            successor.pop_back();
+        }
+        if (successor.empty()) {
+            return;
+        }
+        successor.back() = static_cast<char>(static_cast<unsigned char>(successor.back()) + 1);
+        position = seek(successor);
+    }
+}
@@ -3,6 +3,27 @@
 #include "paginator.h"
 #include "request_queue.h"
 #include "remove_duplicates.h"
+#include "corpus_reader.h"
+#include "request_stats.h"
+#include "async_search_server.h"
+#include "process_queries.h"
+#include "allocation_counter.h"
+#include "differential_testing.h"
+#include "generators.h"
+#include "persistent_search_server.h"
+#include "search_result_stream.h"
+#include "numa_search_server.h"
+#include "impact_kernel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -76,7 +97,7 @@ void TestMatchDocumentsAndQuery() {
     server.AddDocument(doc_id, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
 
     const auto matched_words = get<0>(server.MatchDocument("cat city"s, doc_id));
-    vector<string_view> expected_result = {"cat"s, "city"s};
+    vector<string_view> expected_result = {"cat"sv, "city"sv};
     ASSERT_EQUAL_HINT(matched_words, expected_result, "Two words expected"s);
 
     const auto matched_words_with_minus = get<0>(server.MatchDocument("cat -city"s, doc_id));
@@ -237,7 +258,7 @@ void TestGetWordFrequencies() {
 
     map<string_view, double> word_frequencies = search_server.GetWordFrequencies(1);
 
-    map<string_view, double> true_word_frequencies = {{"cat"s, 0.25}, {"curly"s, 0.5}, {"tail"s, 0.25}};
+    map<string_view, double> true_word_frequencies = {{"cat"sv, 0.25}, {"curly"sv, 0.5}, {"tail"sv, 0.25}};
 
     ASSERT_EQUAL_HINT(word_frequencies, true_word_frequencies, "{cat: 0.25, curly: 0.5, tail: 0.25}"s);
 }
@@ -282,6 +303,1598 @@ void TestRemoveDuplicates() {
     ASSERT_EQUAL(found_docs[2].id, 5);
 }
 
+void TestLoadCorpus() {
+    const string newline_path = (filesystem::temp_directory_path() / "search_server_corpus.txt"s).string();
+    {
+        ofstream out(newline_path);
+        out << "1\t0\t7 2 7\tcurly cat curly tail\n"s
+            << "2\t0\t1 2 3\tcurly dog and fancy collar\n"s
+            << "3\t2\t\tbig cat fancy collar\n"s;
+    }
+    {
+        const MappedFile file(newline_path);
+        const auto records = ParseCorpus(file.Data(), CorpusFormat::NEWLINE_DELIMITED);
+        ASSERT_EQUAL(records.size(), 3u);
+        ASSERT_EQUAL(records[0].ratings, vector<int>({7, 2, 7}));
+        ASSERT_EQUAL(records[2].text, "big cat fancy collar"sv);
+        ASSERT_HINT(records[2].status == DocumentStatus::BANNED, "Status is parsed from the second field"s);
+        // текст записи указывает в отображённый файл, а не в копию
+        ASSERT(records[0].text.data() >= file.Data().data() && records[0].text.data() < file.Data().data() + file.Data().size());
+
+        SearchServer search_server("and"s);
+        const IngestStats stats = LoadCorpus(search_server, file, CorpusFormat::NEWLINE_DELIMITED);
+        ASSERT_EQUAL(stats.documents, 3u);
+        ASSERT_EQUAL(stats.bytes, file.Data().size());
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+        ASSERT_EQUAL(search_server.FindTopDocuments("collar"s).size(), 1u);
+        ASSERT_EQUAL(search_server.FindTopDocuments("collar"s, DocumentStatus::BANNED).size(), 1u);
+    }
+    filesystem::remove(newline_path);
+
+    const string prefixed_path = (filesystem::temp_directory_path() / "search_server_corpus.bin"s).string();
+    {
+        ofstream out(prefixed_path, ios::binary);
+        for (const string& record : {"5\t0\t4\tsparrow Eugene"s, "6\t0\t\tsparrow Vasiliy"s}) {
+            const uint32_t length = record.size();
+            const char header[] = {static_cast<char>(length & 0xFF), static_cast<char>((length >> 8) & 0xFF),
+                                   static_cast<char>((length >> 16) & 0xFF), static_cast<char>(length >> 24)};
+            out.write(header, sizeof(header));
+            out << record;
+        }
+    }
+    {
+        const MappedFile file(prefixed_path);
+        const auto records = ParseCorpus(execution::par, file.Data(), CorpusFormat::LENGTH_PREFIXED);
+        ASSERT_EQUAL(records.size(), 2u);
+        ASSERT_EQUAL(records[1].id, 6);
+        ASSERT(records[1].ratings.empty());
+
+        SearchServer search_server("and"s);
+        LoadCorpus(search_server, file, CorpusFormat::LENGTH_PREFIXED);
+        ASSERT_EQUAL(search_server.FindTopDocuments("sparrow"s).size(), 2u);
+    }
+    filesystem::remove(prefixed_path);
+
+    try {
+        ParseCorpus("1\tactual\t\ttext"sv, CorpusFormat::NEWLINE_DELIMITED);
+        ASSERT_HINT(false, "Invalid status must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestPhraseQueries() {
+    SearchServer search_server("and in the"s, IndexOptions{true});
+    search_server.AddDocument(1, "big cat in the city"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "city cat is big"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "big fluffy grey cat"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "big dog"s, DocumentStatus::ACTUAL, {4});
+
+    const auto exact = search_server.FindTopDocuments("\"big cat\""s);
+    ASSERT_EQUAL(exact.size(), 1u);
+    ASSERT_EQUAL(exact[0].id, 1);
+
+    // стоп-слова не занимают позиций
+    ASSERT_EQUAL(search_server.FindTopDocuments("\"cat in the city\""s).size(), 1u);
+
+    const auto near = search_server.FindTopDocuments("\"big cat\"~2"s);
+    ASSERT_EQUAL(near.size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("\"big cat\"~1"s).size(), 1u);
+
+    // фраза - обязательное условие, обычные слова - необязательные
+    const auto mixed = search_server.FindTopDocuments("dog \"big cat\" -city"s);
+    ASSERT_EQUAL(mixed.size(), 0u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("grey \"big cat\"~2"s)[0].id, 3);
+
+    const auto [words, status] = search_server.MatchDocument("\"cat big\""s, 2);
+    ASSERT(words.empty());
+    const auto [matched_words, _] = search_server.MatchDocument(execution::par, "\"big cat\" city"s, 1);
+    ASSERT_EQUAL(matched_words.size(), 3u);
+
+    search_server.RemoveDocument(1);
+    ASSERT(search_server.FindTopDocuments("\"big cat\""s).empty());
+
+    try {
+        search_server.FindTopDocuments("\"big cat"s);
+        ASSERT_HINT(false, "Unterminated phrase must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    SearchServer no_positions("and"s);
+    no_positions.AddDocument(1, "big cat"s, DocumentStatus::ACTUAL, {1});
+    try {
+        no_positions.FindTopDocuments("\"big cat\""s);
+        ASSERT_HINT(false, "Phrase queries require stored positions"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(no_positions.FindTopDocuments("\"cat\""s).size(), 1u);
+
+    ASSERT_EQUAL(DecodePositions(EncodePositions({0, 1, 200, 70000})), vector<uint32_t>({0, 1, 200, 70000}));
+}
+
+void TestScorers() {
+    SearchServer search_server("и в на"s);
+    search_server.AddDocument(0, "белый кот и модный ошейник"s,        DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "пушистый кот пушистый хвост"s,       DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    search_server.AddDocument(3, "ухоженный скворец евгений"s,         DocumentStatus::ACTUAL, {9});
+
+    // TF-IDF, вычисленный вручную: слагаемые в алфавитном порядке слов "кот", "пушистый",
+    // "ухоженный"; доли слов и аргументы логарифмов точны, поэтому совпадение побитовое
+    const auto tf_idf_docs = search_server.FindTopDocuments<TfIdfScorer>("пушистый ухоженный кот"s);
+    const vector<pair<int, double>> expected_tf_idf = {{1, 0.25 * log(4.0 / 2) + 0.5 * log(4.0 / 1)},
+                                                       {3, 1.0 / 3 * log(4.0 / 2)},
+                                                       {0, 0.25 * log(4.0 / 2)},
+                                                       {2, 0.25 * log(4.0 / 2)}};
+    ASSERT_EQUAL(tf_idf_docs.size(), expected_tf_idf.size());
+    for (size_t i = 0; i < tf_idf_docs.size(); ++i) {
+        ASSERT_EQUAL(tf_idf_docs[i].id, expected_tf_idf[i].first);
+        ASSERT_EQUAL(tf_idf_docs[i].relevance, expected_tf_idf[i].second);
+    }
+
+    // средняя длина документа (4 + 4 + 4 + 3) / 4 = 3.75, "пушистый" встречается дважды в документе 1 из 4 слов
+    const auto bm25_docs = search_server.FindTopDocuments<Bm25Scorer>(execution::par, "пушистый"s);
+    ASSERT_EQUAL(bm25_docs.size(), 1u);
+    const double idf = log(1.0 + (4 - 1 + 0.5) / (1 + 0.5));
+    const double expected = idf * 2 * (Bm25Scorer::K1 + 1) / (2 + Bm25Scorer::K1 * (1 - Bm25Scorer::B + Bm25Scorer::B * 4 / 3.75));
+    ASSERT(abs(bm25_docs[0].relevance - expected) < EPSILON);
+
+    // при равной частоте BM25 выше оценивает более короткий документ
+    const auto short_first = search_server.FindTopDocuments<Bm25Scorer>("ухоженный"s, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(short_first.size(), 2u);
+    ASSERT_EQUAL(short_first[0].id, 3);
+    ASSERT_EQUAL(search_server.FindTopDocuments<Bm25Scorer>("ухоженный"s, [](int, DocumentStatus, int rating) { return rating < 0; }).size(), 1u);
+}
+
+void TestRequiredWords() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::ACTUAL, {1, 2, 8});
+    search_server.AddDocument(4, "big dog sparrow Eugene"s, DocumentStatus::ACTUAL, {1, 3, 2});
+    search_server.AddDocument(5, "big dog sparrow Vasiliy"s, DocumentStatus::BANNED, {1, 1, 1});
+
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly dog"s).size(), 3u);
+    const auto all_words = search_server.FindTopDocuments("curly dog"s, DocumentStatus::ACTUAL, QueryMode::ALL_WORDS);
+    ASSERT_EQUAL(all_words.size(), 1u);
+    ASSERT_EQUAL(all_words[0].id, 2);
+
+    // релевантность документа не зависит от режима, меняется только набор документов
+    const auto any_word = search_server.FindTopDocuments("curly dog"s);
+    const auto it_document = find_if(any_word.begin(), any_word.end(), [](const Document& document) { return document.id == 2; });
+    ASSERT_EQUAL(it_document->relevance, all_words[0].relevance);
+
+    const auto required = search_server.FindTopDocuments(execution::par, "+big sparrow cat -Vasiliy"s,
+                                                         [](int, DocumentStatus, int) { return true; });
+    ASSERT_EQUAL(required.size(), 2u);
+    ASSERT_EQUAL(required[0].id, 3);
+    ASSERT_EQUAL(required[1].id, 4);
+
+    ASSERT(search_server.FindTopDocuments("+big +curly"s).empty());
+    ASSERT(search_server.FindTopDocuments("+missing cat"s).empty());
+    ASSERT(get<0>(search_server.MatchDocument("+big cat"s, 1)).empty());
+    ASSERT_EQUAL(get<0>(search_server.MatchDocument(execution::par, "+big cat"s, 3)).size(), 2u);
+
+    try {
+        search_server.FindTopDocuments("+-cat"s);
+        ASSERT_HINT(false, "Plus and minus on one word must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // пересечение длинных списков по частям совпадает с последовательным
+    SearchServer large_server("and"s);
+    for (int id = 0; id < 5000; ++id) {
+        string text = id % 2 ? "odd"s : "even"s;
+        text += id % 3 ? " other"s : " third"s;
+        text += id % 7 ? ""s : " seventh"s;
+        // различные рейтинги делают порядок документов с равной релевантностью однозначным
+        large_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    const auto match_all = [](int, DocumentStatus, int) { return true; };
+    const auto seq_documents = large_server.FindTopDocuments(execution::seq, "+odd +third -seventh"s, match_all);
+    const auto par_documents = large_server.FindTopDocuments(execution::par, "+odd +third -seventh"s, match_all);
+    ASSERT_EQUAL(seq_documents.size(), par_documents.size());
+    for (size_t i = 0; i < seq_documents.size(); ++i) {
+        ASSERT_EQUAL(seq_documents[i].id, par_documents[i].id);
+        ASSERT_EQUAL(seq_documents[i].id % 2, 1);
+        ASSERT_EQUAL(seq_documents[i].id % 3, 0);
+        ASSERT(seq_documents[i].id % 7 != 0);
+    }
+
+    PostingList postings;
+    for (int id : {10, 3, 7, 20, 15}) {
+        postings.Add(id, 1.0);
+    }
+    postings.Add(7, 0.5);
+    ASSERT_EQUAL(postings.size(), 5u);
+    ASSERT_EQUAL(postings.TermFreq(postings.Find(7)), 1.5);
+    ASSERT_EQUAL(postings.DocumentId(postings.Advance(0, 11)), 15);
+    ASSERT_EQUAL(postings.Advance(2, 21), postings.size());
+    postings.Erase(10);
+    ASSERT(!postings.Contains(10));
+}
+
+void TestMinusWordsExclusion() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(300, "big cat fancy collar "s, DocumentStatus::ACTUAL, {1, 2, 8});
+    search_server.AddDocument(4, "big dog sparrow Eugene"s, DocumentStatus::ACTUAL, {1, 3, 2});
+
+    for (const auto& documents : {search_server.FindTopDocuments(execution::seq, "curly cat big -collar -missing"s),
+                                  search_server.FindTopDocuments(execution::par, "curly cat big -collar -missing"s)}) {
+        ASSERT_EQUAL(documents.size(), 2u);
+        ASSERT_EQUAL(documents[0].id, 1);
+        ASSERT_EQUAL(documents[1].id, 4);
+    }
+    ASSERT(search_server.FindTopDocuments(execution::par, "cat -cat"s).empty());
+
+    RoaringBitmap bitmap;
+    bitmap.Add(3);
+    bitmap.Add(200);
+    ASSERT(bitmap.Contains(3) && bitmap.Contains(200));
+    ASSERT(!bitmap.Contains(4) && !bitmap.Contains(100000));
+}
+
+void TestStatusPartitionedPostings() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::BANNED, {1, 2, 3});
+    search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::BANNED, {1, 2, 8});
+    search_server.AddDocument(4, "big dog sparrow Eugene"s, DocumentStatus::IRRELEVANT, {1, 3, 2});
+
+    // фильтр по статусу и эквивалентный ему предикат дают одинаковый результат
+    const auto is_banned = [](int, DocumentStatus status, int) { return status == DocumentStatus::BANNED; };
+    for (const string& query : {"curly cat fancy"s, "+fancy collar -dog"s, "big curly"s}) {
+        const auto by_status = search_server.FindTopDocuments(execution::seq, query, DocumentStatus::BANNED);
+        const auto by_predicate = search_server.FindTopDocuments(execution::seq, query, is_banned);
+        ASSERT_EQUAL(by_status.size(), by_predicate.size());
+        for (size_t i = 0; i < by_status.size(); ++i) {
+            ASSERT_EQUAL(by_status[i].id, by_predicate[i].id);
+            ASSERT(abs(by_status[i].relevance - by_predicate[i].relevance) < EPSILON);
+        }
+        ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED).size(), by_status.size());
+    }
+
+    // документ остаётся в своей части после удаления соседних документов
+    search_server.RemoveDocument(2);
+    const auto documents = search_server.FindTopDocuments("+fancy collar"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 3);
+    ASSERT(search_server.FindTopDocuments("fancy"s).empty());
+    ASSERT_EQUAL(get<0>(search_server.MatchDocument(execution::par, "big fancy -curly"s, 3)).size(), 2u);
+}
+
+void TestDocumentFilter() {
+    SearchServer search_server("and in at"s);
+    for (int id = 0; id < 200; ++id) {
+        const string text = (id % 2 == 0 ? "curly cat"s : "fancy dog"s) + (id % 3 == 0 ? " collar"s : " tail"s);
+        search_server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id});
+    }
+
+    // узкий диапазон отбирается по индексу рейтингов, широкий - обходом списков;
+    // оба способа совпадают с эквивалентным предикатом
+    for (const auto& [min_rating, max_rating] : {pair{10, 13}, pair{0, 199}, pair{150, 150}}) {
+        const DocumentFilter filter = DocumentFilter().AddStatus(DocumentStatus::ACTUAL).SetRatingRange(min_rating, max_rating);
+        const auto predicate = [min_rating = min_rating, max_rating = max_rating](int, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && min_rating <= rating && rating <= max_rating;
+        };
+        for (const string& query : {"curly dog collar"s, "cat -collar"s, "+collar dog"s}) {
+            const auto expected = search_server.FindTopDocuments(query, predicate);
+            for (const auto& documents : {search_server.FindTopDocuments(execution::seq, query, filter),
+                                          search_server.FindTopDocuments(execution::par, query, filter)}) {
+                ASSERT_EQUAL(documents.size(), expected.size());
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_EQUAL(documents[i].id, expected[i].id);
+                    ASSERT(abs(documents[i].relevance - expected[i].relevance) < EPSILON);
+                }
+            }
+        }
+    }
+
+    const auto documents = search_server.FindTopDocuments("cat"s, DocumentFilter().SetRatingRange(10, 13));
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 12);
+    ASSERT_EQUAL(documents[1].id, 10);
+    search_server.RemoveDocument(12);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, DocumentFilter().SetRatingRange(10, 13)).size(), 1u);
+
+    try {
+        DocumentFilter().SetRatingRange(5, 4);
+        ASSERT_HINT(false, "Empty rating range must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestRequestStats() {
+    using namespace std::chrono;
+    RequestStats stats;
+    const RequestStats::Clock::time_point start(hours(1000));
+    for (int i = 0; i < 99; ++i) {
+        stats.Record(start, microseconds(100), 5);
+    }
+    stats.Record(start + seconds(1), microseconds(10000), 0);
+
+    const RequestWindowStats minute = stats.GetStats(StatsWindow::MINUTE, start + seconds(1));
+    ASSERT_EQUAL(minute.requests, 100u);
+    ASSERT_EQUAL(minute.no_result_requests, 1u);
+    ASSERT(abs(minute.NoResultRate() - 0.01) < EPSILON);
+    ASSERT(abs(minute.queries_per_second - 100.0 / 60) < EPSILON);
+    ASSERT(minute.latency_p50 >= microseconds(100) && minute.latency_p50 <= microseconds(125));
+    ASSERT(minute.latency_p99 <= microseconds(125));
+
+    // окна разной длины забывают запросы в разное время
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::MINUTE, start + seconds(61)).requests, 0u);
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::HOUR, start + seconds(61)).requests, 100u);
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::HOUR, start + hours(2)).requests, 0u);
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::DAY, start + hours(2)).requests, 100u);
+    stats.Record(start + hours(24), microseconds(3), 1);
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::DAY, start + hours(24)).requests, 1u);
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::DAY, start + hours(24)).latency_p99.count(), 4);
+
+    // задержки длиннее последней корзины попадают в неё, а не в случайную корзину последней степени двойки
+    const RequestStats::Clock::time_point long_requests = start + hours(30);
+    stats.Record(long_requests, microseconds(int64_t{1} << 34), 1);
+    stats.Record(long_requests, microseconds((int64_t{1} << 40) + 12345), 1);
+    const RequestWindowStats long_minute = stats.GetStats(StatsWindow::MINUTE, long_requests);
+    ASSERT_EQUAL(long_minute.latency_p50.count(), int64_t{1} << 32);
+    ASSERT_EQUAL(long_minute.latency_p99.count(), int64_t{1} << 32);
+
+    // одновременная запись из нескольких потоков в уже занятую корзину не теряет запросов
+    const RequestStats::Clock::time_point later = start + hours(48);
+    stats.Record(later, microseconds(1), 1);
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&stats, later] {
+            for (int j = 0; j < 1000; ++j) {
+                stats.Record(later, microseconds(j), j % 2);
+            }
+        });
+    }
+    for (thread& current_thread : threads) {
+        current_thread.join();
+    }
+    const RequestWindowStats concurrent = stats.GetStats(StatsWindow::MINUTE, later);
+    ASSERT_EQUAL(concurrent.requests, 4001u);
+    ASSERT_EQUAL(concurrent.no_result_requests, 2000u);
+
+    // запросы, записанные, пока другой поток занимает и обнуляет корзину, не теряются
+    const RequestStats::Clock::time_point fresh = start + hours(72);
+    threads.clear();
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&stats, fresh] {
+            for (int second = 0; second < 60; ++second) {
+                for (int j = 0; j < 50; ++j) {
+                    stats.Record(fresh + seconds(second), microseconds(j), 1);
+                }
+            }
+        });
+    }
+    for (thread& current_thread : threads) {
+        current_thread.join();
+    }
+    ASSERT_EQUAL(stats.GetStats(StatsWindow::MINUTE, fresh + seconds(59)).requests, 4u * 60 * 50);
+}
+
+void TestAsyncSearchServer() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::ACTUAL, {1, 2, 8});
+    search_server.AddDocument(4, "big dog sparrow Eugene"s, DocumentStatus::ACTUAL, {1, 3, 2});
+
+    const vector<string> queries = {"curly cat"s, "big -dog"s, "fancy collar"s, "sparrow"s, "missing"s};
+    vector<future<vector<Document>>> results;
+    future<vector<Document>> invalid_result;
+    RequestWindowStats request_stats;
+    {
+        AsyncSearchServer async_server(search_server, {3, chrono::milliseconds(1)});
+        vector<thread> threads;
+        vector<future<vector<Document>>> thread_results(queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            threads.emplace_back([&, i] { thread_results[i] = async_server.FindTopDocuments(queries[i]); });
+        }
+        for (thread& current_thread : threads) {
+            current_thread.join();
+        }
+        results = move(thread_results);
+        invalid_result = async_server.FindTopDocuments("cat --dog"s);
+        for (const future<vector<Document>>& result : results) {
+            result.wait();
+        }
+        invalid_result.wait();
+        request_stats = async_server.GetStats(StatsWindow::MINUTE);
+    }
+    // исполненные запросы учтены в статистике, запрос с ошибкой - нет
+    ASSERT_EQUAL(request_stats.requests, queries.size());
+    ASSERT_EQUAL(request_stats.no_result_requests, 1u);
+
+    // ответ совпадает с синхронным поиском, ошибка одного запроса не затрагивает остальные
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const vector<Document> expected = search_server.FindTopDocuments(queries[i]);
+        const vector<Document> documents = results[i].get();
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t j = 0; j < documents.size(); ++j) {
+            ASSERT_EQUAL(documents[j].id, expected[j].id);
+        }
+    }
+    try {
+        invalid_result.get();
+        ASSERT_HINT(false, "Invalid query must be reported through the future"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestFindTopDocumentsBatch() {
+    SearchServer search_server("and in at"s);
+    const vector<string> words = {"curly"s, "cat"s, "tail"s, "dog"s, "fancy"s, "collar"s, "big"s, "sparrow"s};
+    for (int id = 0; id < 60; ++id) {
+        string text;
+        for (int i = 0; i < 4; ++i) {
+            text += words[(id * 7 + i * i * 3) % words.size()] + " "s;
+        }
+        search_server.AddDocument(id, text, id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 9});
+    }
+
+    const vector<string> queries = {"curly cat"s, "cat curly -dog"s, "big sparrow and"s, "fancy +collar"s,
+                                    "missing"s, "tail tail dog -missing"s, "cat"s};
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    const auto batch_results = search_server.FindTopDocumentsBatch(query_views);
+    const auto process_results = ProcessQueries(search_server, queries);
+    ASSERT_EQUAL(batch_results.size(), queries.size());
+    ASSERT_EQUAL(process_results.size(), queries.size());
+    // результат совпадает с FindTopDocuments вплоть до порядка и точного значения релевантности
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = search_server.FindTopDocuments(queries[i]);
+        for (const auto& documents : {batch_results[i], process_results[i]}) {
+            ASSERT_EQUAL(documents.size(), expected.size());
+            for (size_t j = 0; j < documents.size(); ++j) {
+                ASSERT_EQUAL(documents[j].id, expected[j].id);
+                ASSERT(documents[j].relevance == expected[j].relevance);
+                ASSERT_EQUAL(documents[j].rating, expected[j].rating);
+            }
+        }
+    }
+    ASSERT(search_server.FindTopDocumentsBatch({}).empty());
+
+    // накопители следующего пакета чистые, хотя документов и запросов стало другое число
+    search_server.RemoveDocument(1);
+    search_server.RemoveDocument(2);
+    search_server.AddDocument(1'000'000, "curly cat cat"s, DocumentStatus::ACTUAL, {5});
+    const auto next_results = search_server.FindTopDocumentsBatch({"cat -tail"s, "curly cat"s});
+    ASSERT_EQUAL(next_results.size(), 2u);
+    for (size_t i = 0; i < next_results.size(); ++i) {
+        const auto expected = search_server.FindTopDocuments(i == 0 ? "cat -tail"s : "curly cat"s);
+        ASSERT_EQUAL(next_results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(next_results[i][j].id, expected[j].id);
+            ASSERT(next_results[i][j].relevance == expected[j].relevance);
+        }
+    }
+}
+
+void TestQueryAllocations() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::ACTUAL, {1, 2, 8});
+    search_server.AddDocument(4, "big dog sparrow Eugene"s, DocumentStatus::ACTUAL, {1, 3, 2});
+
+    const string query = "curly cat fancy and -dog"s;
+    const auto expected = search_server.FindTopDocuments(query);
+    ASSERT_EQUAL(expected.size(), 2u);
+    if (!IsAllocationCountingEnabled()) {
+        cerr << "TestQueryAllocations: allocation counting is off, build with -DSEARCH_SERVER_COUNT_ALLOCATIONS"s << endl;
+        return;
+    }
+    {
+        // после прогрева временные структуры запроса берутся из пула потока:
+        // в куче выделяется только память под возвращаемый результат
+        AllocationCounter allocations;
+        const auto documents = search_server.FindTopDocuments(query);
+        const uint64_t allocation_count = allocations.Count();
+        ASSERT_EQUAL(allocation_count, 1u);
+        ASSERT_EQUAL(documents.size(), expected.size());
+    }
+    {
+        AllocationCounter allocations;
+        const bool is_empty = search_server.FindTopDocuments("sparrow -big"s).empty();
+        const uint64_t allocation_count = allocations.Count();
+        ASSERT(is_empty);
+        ASSERT_EQUAL(allocation_count, 0u);
+    }
+
+    AllocationCounter allocations;
+    const vector<int> numbers(10);
+    const uint64_t allocation_count = allocations.Count();
+    ASSERT_EQUAL(allocation_count, 1u);
+}
+
+void TestForwardIndex() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "tail and big cat"s, DocumentStatus::ACTUAL, {1, 2, 3});
+
+    // слова идут в порядке номеров словаря - порядке первого появления в индексе
+    vector<pair<string_view, double>> entries;
+    for (const auto& [word, freq] : search_server.GetWordFrequencies(2)) {
+        entries.emplace_back(word, freq);
+    }
+    const vector<pair<string_view, double>> expected = {{"cat"sv, 1.0 / 3}, {"tail"sv, 1.0 / 3}, {"big"sv, 1.0 / 3}};
+    ASSERT_EQUAL(entries.size(), expected.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ASSERT_EQUAL(entries[i].first, expected[i].first);
+        ASSERT(abs(entries[i].second - expected[i].second) < EPSILON);
+    }
+
+    const map<string_view, double> word_frequencies = search_server.GetWordFrequencies(1);
+    ASSERT_EQUAL(word_frequencies.size(), 3u);
+    ASSERT(abs(word_frequencies.at("curly"sv) - 0.5) < EPSILON);
+    ASSERT(search_server.GetWordFrequencies(100).empty());
+
+    search_server.RemoveDocument(1);
+    ASSERT(search_server.GetWordFrequencies(1).empty());
+    ASSERT_EQUAL(search_server.GetWordFrequencies(2).size(), 3u);
+    ASSERT(search_server.FindTopDocuments("curly"s).empty());
+}
+
+void TestPreparedQuery() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::BANNED, {1, 2, 8});
+
+    const auto assert_same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(lhs[i].relevance == rhs[i].relevance);
+        }
+    };
+
+    SearchServer::PreparedQuery prepared = [&search_server] {
+        // подготовленный запрос не зависит от строки, из которой создан
+        const string raw_query = "cat curly cat sparrow -dog"s;
+        return search_server.PrepareQuery(raw_query);
+    }();
+    const string raw_query = "cat curly cat sparrow -dog"s;
+    for (int i = 0; i < 2; ++i) {
+        assert_same(search_server.FindTopDocuments(prepared), search_server.FindTopDocuments(raw_query));
+        assert_same(search_server.FindTopDocuments(execution::par, prepared, DocumentStatus::BANNED),
+                    search_server.FindTopDocuments(execution::par, raw_query, DocumentStatus::BANNED));
+    }
+    const auto [words, status] = search_server.MatchDocument(prepared, 1);
+    const vector<string_view> expected_words = {"cat"sv, "curly"sv};
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT(get<0>(search_server.MatchDocument(prepared, 2)).empty());
+
+    const auto all_words = search_server.PrepareQuery("fancy collar"s, QueryMode::ALL_WORDS);
+    assert_same(search_server.FindTopDocuments(all_words, [](int, DocumentStatus, int) { return true; }),
+                search_server.FindTopDocuments("+fancy +collar"s, [](int, DocumentStatus, int) { return true; }));
+
+    // слово, которого не было в индексе при подготовке, находится после добавления документа
+    search_server.AddDocument(4, "sparrow sparrow"s, DocumentStatus::ACTUAL, {1});
+    const auto documents = search_server.FindTopDocuments(prepared);
+    assert_same(documents, search_server.FindTopDocuments(raw_query));
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 4);
+}
+
+void TestDifferential() {
+    // случайные сценарии сравниваются с эталонным перебором всех документов
+    const int scenario_count = 200;
+    const size_t scenario_length = 400;
+    mt19937 generator(39);
+    for (int i = 0; i < scenario_count; ++i) {
+        const string scenario = GenerateDifferentialScenario(generator, scenario_length);
+        try {
+            RunDifferentialScenario(scenario);
+        } catch (const logic_error& e) {
+            ASSERT_HINT(false, "Scenario "s + to_string(i) + ": "s + e.what());
+        }
+    }
+}
+
+void TestFrozenIndex() {
+    mt19937 generator(40);
+    const vector<string> dictionary = GenerateDictionary(generator, 200, 6);
+    SearchServer search_server("and in at"s, IndexOptions{true});
+    SearchServer frozen_server("and in at"s, IndexOptions{true});
+    for (int i = 0; i < 500; ++i) {
+        // id с пропусками, чтобы поиск по столбцам документов не совпадал с индексом в массиве
+        const int document_id = i * 3 + 1;
+        const string text = GenerateQuery(generator, dictionary, 20);
+        const auto status = static_cast<DocumentStatus>(i % DOCUMENT_STATUS_COUNT);
+        search_server.AddDocument(document_id, text, status, {i % 17, i % 5});
+        frozen_server.AddDocument(document_id, text, status, {i % 17, i % 5});
+    }
+    const auto prepared = frozen_server.PrepareQuery(dictionary[0] + " "s + dictionary[1]);
+    frozen_server.Freeze();
+    frozen_server.Freeze();
+    ASSERT(frozen_server.IsFrozen());
+    ASSERT(!search_server.IsFrozen());
+
+    const auto assert_same = [](const vector<Document>& lhs, const vector<Document>& rhs, const string& query) {
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+            ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, query);
+            ASSERT_HINT(lhs[i].relevance == rhs[i].relevance, query);
+        }
+    };
+    const auto is_even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    const DocumentFilter filter = DocumentFilter().AddStatus(DocumentStatus::ACTUAL).SetRatingRange(2, 4);
+    // узкий диапазон рейтинга отбирается по упорядоченному по рейтингу столбцу
+    const DocumentFilter narrow_filter = DocumentFilter().SetRatingRange(9, 10);
+    ASSERT_EQUAL(frozen_server.GetIndexStats().rating_index_bytes, 0u);
+
+    vector<string> queries = GenerateQueries(generator, dictionary, 100, 4);
+    queries.push_back("+"s + dictionary[2] + " "s + dictionary[3] + " -"s + dictionary[4]);
+    queries.push_back("\""s + dictionary[5] + " "s + dictionary[6] + "\"~3 "s + dictionary[7]);
+    queries.push_back("sparrow"s);
+    for (const string& query : queries) {
+        assert_same(frozen_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        assert_same(frozen_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                    search_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED), query);
+        assert_same(frozen_server.FindTopDocuments<Bm25Scorer>(execution::seq, query, is_even),
+                    search_server.FindTopDocuments<Bm25Scorer>(execution::seq, query, is_even), query);
+        assert_same(frozen_server.FindTopDocuments(execution::par, query, filter),
+                    search_server.FindTopDocuments(execution::par, query, filter), query);
+        assert_same(frozen_server.FindTopDocuments(query, narrow_filter), search_server.FindTopDocuments(query, narrow_filter), query);
+        assert_same(frozen_server.FindTopDocuments(query, DocumentStatus::ACTUAL, QueryMode::ALL_WORDS),
+                    search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, QueryMode::ALL_WORDS), query);
+        assert_same(frozen_server.FindTopDocuments(frozen_server.PrepareQuery(query), DocumentStatus::IRRELEVANT),
+                    search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT), query);
+        assert_same(frozen_server.FindTopDocumentsBatch({query})[0], search_server.FindTopDocuments(query), query);
+        for (const int document_id : {1, 4, 301, 1498}) {
+            ASSERT_EQUAL_HINT(get<0>(frozen_server.MatchDocument(execution::par, query, document_id)),
+                              get<0>(search_server.MatchDocument(execution::par, query, document_id)), query);
+            ASSERT_HINT(get<1>(frozen_server.MatchDocument(query, document_id))
+                        == get<1>(search_server.MatchDocument(query, document_id)), query);
+        }
+    }
+
+    // запрос, подготовленный до заморозки, выполняется по замороженному индексу
+    const string prepared_text = dictionary[0] + " "s + dictionary[1];
+    assert_same(frozen_server.FindTopDocuments(prepared), search_server.FindTopDocuments(prepared_text), prepared_text);
+    ASSERT_EQUAL(frozen_server.GetWordFrequencies(4).size(), search_server.GetWordFrequencies(4).size());
+
+    try {
+        frozen_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "AddDocument must throw on a frozen index"s);
+    } catch (const logic_error&) {
+    }
+    try {
+        frozen_server.RemoveDocument(1);
+        ASSERT_HINT(false, "RemoveDocument must throw on a frozen index"s);
+    } catch (const logic_error&) {
+    }
+    ASSERT_EQUAL(frozen_server.GetDocumentCount(), 500);
+
+    SearchServer huge_pages_server("and"s);
+    huge_pages_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    huge_pages_server.Freeze(FreezeOptions{true});
+    ASSERT_EQUAL(huge_pages_server.FindTopDocuments("cat"s).size(), 1u);
+}
+
+void TestTermExpansion() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7});
+    search_server.AddDocument(2, "category of cats"s, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(3, "big dog fancy collar"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "caterpillar"s, DocumentStatus::ACTUAL, {1});
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("cat*"s)), (vector<int>{1, 2, 4}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("cat* -cats"s)), (vector<int>{1, 4}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("collar -cate*"s)), (vector<int>{3}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("dig~1"s)), (vector<int>{3}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("cot~1"s)), (vector<int>{1}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("cot~2"s)), (vector<int>{1, 2, 3}));
+    ASSERT(search_server.FindTopDocuments("zebra*"s).empty());
+
+    // подставленные слова ранжируются так же, как перечисленные явно
+    const auto expanded = search_server.FindTopDocuments("cat*"s);
+    const auto explicit_words = search_server.FindTopDocuments("cat category caterpillar cats"s);
+    ASSERT_EQUAL(expanded.size(), explicit_words.size());
+    for (size_t i = 0; i < expanded.size(); ++i) {
+        ASSERT_EQUAL(expanded[i].id, explicit_words[i].id);
+        ASSERT(expanded[i].relevance == explicit_words[i].relevance);
+    }
+
+    const auto [words, status] = search_server.MatchDocument("cat* tail~1"s, 1);
+    const vector<string_view> expected_words = {"cat"sv, "tail"sv};
+    ASSERT_EQUAL(words, expected_words);
+
+    // в режиме всех слов шаблон не обязателен
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("curly cat*"s, DocumentStatus::ACTUAL, QueryMode::ALL_WORDS)),
+                 (vector<int>{1}));
+
+    // подготовленный запрос раскрывает шаблон заново после изменения индекса
+    const auto prepared = search_server.PrepareQuery("cat*"s);
+    search_server.AddDocument(5, "catalog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments(prepared)), (vector<int>{1, 2, 4, 5}));
+    search_server.RemoveDocument(4);
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments(prepared)), (vector<int>{1, 2, 5}));
+
+    search_server.Freeze();
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("cat*"s)), (vector<int>{1, 2, 5}));
+    ASSERT_EQUAL(get_ids(search_server.FindTopDocuments("dig~1"s)), (vector<int>{3}));
+
+    for (const string& query : {"*"s, "~1"s, "cat~3"s, "cat~0"s, "+cat*"s}) {
+        try {
+            search_server.FindTopDocuments(query);
+            ASSERT_HINT(false, "Invalid pattern must be rejected: "s + query);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    // число подставленных слов ограничено
+    SearchServer large_server("and"s);
+    for (int i = 0; i < MAX_PATTERN_EXPANSIONS * 2; ++i) {
+        large_server.AddDocument(i, "word"s + to_string(i), DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL(get<0>(large_server.MatchDocument("word*"s, 0)).size(), 1u);
+    size_t matched_count = 0;
+    for (const int document_id : large_server) {
+        matched_count += get<0>(large_server.MatchDocument("word*"s, document_id)).size();
+    }
+    ASSERT_EQUAL(matched_count, static_cast<size_t>(MAX_PATTERN_EXPANSIONS));
+
+    // при переполнении остаются ближайшие к шаблону слова, а из равноудалённых - самые частые,
+    // хотя 144 слова на расстоянии 2 в алфавите раньше слова шаблона
+    SearchServer fuzzy_server(""s);
+    int document_id = 0;
+    for (char first = 'a'; first <= 'l'; ++first) {
+        for (char second = 'a'; second <= 'l'; ++second) {
+            fuzzy_server.AddDocument(document_id++, string{first, second, 'm'}, DocumentStatus::ACTUAL, {1});
+        }
+    }
+    const int frequent_id = document_id;
+    for (int i = 0; i < 3; ++i) {
+        fuzzy_server.AddDocument(document_id++, "llm"s, DocumentStatus::ACTUAL, {1});
+    }
+    const int exact_id = document_id++;
+    fuzzy_server.AddDocument(exact_id, "mmm"s, DocumentStatus::ACTUAL, {1});
+    const int near_id = document_id++;
+    fuzzy_server.AddDocument(near_id, "mmz"s, DocumentStatus::ACTUAL, {1});
+    for (const int id : {exact_id, near_id, frequent_id}) {
+        ASSERT_EQUAL_HINT(get<0>(fuzzy_server.MatchDocument("mmm~2"s, id)).size(), 1u, "Nearest and most frequent expansions must be kept"s);
+    }
+    ASSERT(get<0>(fuzzy_server.MatchDocument("mmm~2"s, frequent_id - 2)).empty());
+    ASSERT_EQUAL(get<0>(fuzzy_server.MatchDocument("mm*"s, exact_id)).size(), 1u);
+
+    // расстояние считается в буквах, а не в байтах UTF-8
+    SearchServer cyrillic_server(""s);
+    cyrillic_server.AddDocument(1, "ко"s, DocumentStatus::ACTUAL, {1});
+    cyrillic_server.AddDocument(2, "кит"s, DocumentStatus::ACTUAL, {1});
+    cyrillic_server.AddDocument(3, "кота"s, DocumentStatus::ACTUAL, {1});
+    cyrillic_server.AddDocument(4, "кошка"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(get_ids(cyrillic_server.FindTopDocuments("кот~1"s)), (vector<int>{1, 2, 3}));
+    cyrillic_server.Freeze();
+    ASSERT_EQUAL(get_ids(cyrillic_server.FindTopDocuments("кот~1"s)), (vector<int>{1, 2, 3}));
+    ASSERT_EQUAL(get_ids(cyrillic_server.FindTopDocuments("кошк~1"s)), (vector<int>{4}));
+}
+
+void TestSnippets() {
+    {
+        mt19937 generator(42);
+        const vector<string> dictionary = GenerateDictionary(generator, 100, 8);
+        DocumentStore store;
+        vector<string> texts;
+        for (int i = 0; i < 300; ++i) {
+            // встречаются документы длиннее блока
+            texts.push_back(GenerateQuery(generator, dictionary, i % 50 == 0 ? 5000 : 30));
+            store.Add(i, texts.back());
+        }
+        for (int i = 0; i < 300; ++i) {
+            ASSERT_EQUAL(store.Get(i), texts[i]);
+        }
+        ASSERT(store.GetStoredBytes() < store.GetTextBytes());
+        store.Erase(7);
+        ASSERT(!store.Contains(7));
+        ASSERT(store.Get(7).empty());
+        ASSERT_EQUAL(store.Get(8), texts[8]);
+
+        // повтор, перекрывающийся с самим собой
+        const string repeated = "ab"s + string(100, 'a') + "xyz"s;
+        ASSERT_EQUAL(DecompressBlock(CompressBlock(repeated), repeated.size()), repeated);
+        ASSERT_EQUAL(DecompressBlock(CompressBlock(repeated), 10), repeated.substr(0, 10));
+    }
+
+    SearchServer search_server("and in at"s, IndexOptions{false, true});
+    search_server.AddDocument(1, "white cat and fashionable collar sits in the garden near a big old tree with a curly dog"s,
+                              DocumentStatus::ACTUAL, {8});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    ASSERT_EQUAL(search_server.GetDocumentText(2), "fluffy cat fluffy tail"s);
+
+    const Snippet snippet = search_server.GetSnippet("curly dog tree"s, 1, 5);
+    ASSERT_EQUAL(snippet.text, "tree with a curly dog"s);
+    ASSERT_EQUAL(snippet.highlights.size(), 3u);
+    ostringstream output;
+    output << snippet;
+    ASSERT_EQUAL(output.str(), "[tree] with a [curly] [dog]"s);
+
+    // окно выбирается по сумме весов различных слов: редкое слово "garden" весит больше "cat"
+    ostringstream weighted;
+    weighted << search_server.GetSnippet("cat garden"s, 1, 3);
+    ASSERT_EQUAL(weighted.str(), "in the [garden]"s);
+
+    ostringstream no_match;
+    no_match << search_server.GetSnippet("sparrow"s, 2);
+    ASSERT_EQUAL(no_match.str(), "fluffy cat fluffy tail"s);
+
+    // минус-слово исключает документ, как в MatchDocument
+    ASSERT(search_server.GetSnippet("cat -tail"s, 2).highlights.empty());
+
+    search_server.RemoveDocument(2);
+    try {
+        search_server.GetSnippet("cat"s, 2);
+        ASSERT_HINT(false, "Removed document must be rejected"s);
+    } catch (const out_of_range&) {
+    }
+    SearchServer no_store_server("and"s);
+    no_store_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    try {
+        no_store_server.GetSnippet("cat"s, 1);
+        ASSERT_HINT(false, "Snippets require stored documents"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestPersistence() {
+    const string directory = (filesystem::temp_directory_path() / "search_server_persistence"s).string();
+    filesystem::remove_all(directory);
+    const string wal_path = (filesystem::path(directory) / "wal"s).string();
+    const IndexOptions index_options{true, true};
+    const vector<string> queries = {"curly cat"s, "\"fancy collar\""s, "sparrow -dog"s, "cat*"s};
+
+    const auto assert_same = [&queries](const SearchServer& lhs, const SearchServer& rhs) {
+        ASSERT_EQUAL(lhs.GetDocumentCount(), rhs.GetDocumentCount());
+        for (const string& query : queries) {
+            const auto lhs_documents = lhs.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; });
+            const auto rhs_documents = rhs.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; });
+            ASSERT_EQUAL_HINT(lhs_documents.size(), rhs_documents.size(), query);
+            for (size_t i = 0; i < lhs_documents.size(); ++i) {
+                ASSERT_EQUAL_HINT(lhs_documents[i].id, rhs_documents[i].id, query);
+                ASSERT_EQUAL_HINT(lhs_documents[i].rating, rhs_documents[i].rating, query);
+                ASSERT_HINT(lhs_documents[i].relevance == rhs_documents[i].relevance, query);
+            }
+        }
+        for (const int document_id : lhs) {
+            ASSERT_EQUAL(lhs.GetDocumentText(document_id), rhs.GetDocumentText(document_id));
+        }
+    };
+
+    SearchServer expected("and in"s, index_options);
+    const vector<CorpusRecord> records = {
+            {1, DocumentStatus::ACTUAL, {7, 2, 7}, "curly cat curly tail"sv},
+            {2, DocumentStatus::ACTUAL, {1, 2, 3}, "curly dog and fancy collar"sv},
+            {3, DocumentStatus::BANNED, {-4}, "big cat fancy collar"sv},
+    };
+    expected.AddDocuments(execution::seq, records);
+    {
+        PersistentSearchServer server(directory, "and in"s, index_options, PersistenceOptions{4, chrono::milliseconds(1000), 0});
+        server.AddDocuments(execution::par, records);
+        server.AddDocument(4, "sparrow in the garden"s, DocumentStatus::IRRELEVANT, {5});
+        server.RemoveDocument(4);
+        try {
+            server.AddDocument(1, "duplicate"s, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "Duplicate id must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+    {
+        // только журнал, без снимка
+        PersistentSearchServer server(directory, "other stop words"s);
+        ASSERT_EQUAL(server.GetRecoveryStats().snapshot_documents, 0u);
+        ASSERT_EQUAL(server.GetRecoveryStats().replayed_records, 5u);
+        assert_same(server.GetSearchServer(), expected);
+
+        server.Checkpoint();
+        server.AddDocument(5, "white sparrow"s, DocumentStatus::ACTUAL, {2});
+        expected.AddDocument(5, "white sparrow"s, DocumentStatus::ACTUAL, {2});
+    }
+    {
+        // снимок и хвост журнала после него; настройки берутся из снимка
+        PersistentSearchServer server(directory, "other stop words"s);
+        ASSERT_EQUAL(server.GetRecoveryStats().snapshot_documents, 3u);
+        ASSERT_EQUAL(server.GetRecoveryStats().replayed_records, 1u);
+        assert_same(server.GetSearchServer(), expected);
+        server.Sync();
+    }
+
+    // недописанная последняя запись отбрасывается, а новые записи идут после целых
+    const string torn_record = "\x30\x00\x00\x00garbage"s;
+    {
+        ofstream out(wal_path, ios::binary | ios::app);
+        out << torn_record;
+    }
+    {
+        PersistentSearchServer server(directory, "and in"s, index_options, PersistenceOptions{1, chrono::milliseconds(0), 0});
+        ASSERT_EQUAL(server.GetRecoveryStats().replayed_records, 1u);
+        ASSERT_EQUAL(server.GetRecoveryStats().discarded_bytes, torn_record.size());
+        assert_same(server.GetSearchServer(), expected);
+        server.RemoveDocument(1);
+        expected.RemoveDocument(1);
+    }
+
+    // повреждённая запись в середине: применяются только записи до неё
+    {
+        fstream file(wal_path, ios::binary | ios::in | ios::out);
+        file.seekp(10);
+        file.put('#');
+    }
+    {
+        PersistentSearchServer server(directory, "and in"s);
+        ASSERT_EQUAL(server.GetRecoveryStats().replayed_records, 0u);
+        ASSERT_EQUAL(server.GetSearchServer().GetDocumentCount(), 3);
+    }
+
+    // снимок записывается автоматически; записи журнала старше снимка не применяются повторно
+    filesystem::remove_all(directory);
+    {
+        PersistentSearchServer server(directory, "and in"s, {}, PersistenceOptions{1, chrono::milliseconds(0), 2});
+        for (int document_id = 0; document_id < 5; ++document_id) {
+            server.AddDocument(document_id, "cat number "s + to_string(document_id), DocumentStatus::ACTUAL, {document_id});
+        }
+    }
+    {
+        PersistentSearchServer server(directory, "and in"s);
+        ASSERT_EQUAL(server.GetRecoveryStats().snapshot_documents, 4u);
+        ASSERT_EQUAL(server.GetRecoveryStats().replayed_records, 1u);
+        ASSERT_EQUAL(server.GetSearchServer().GetDocumentCount(), 5);
+    }
+    filesystem::remove_all(directory);
+
+    // единственная запись сбрасывается по истечении sync_interval без новых записей
+    const string flush_path = (filesystem::temp_directory_path() / "search_server_wal_flush"s).string();
+    filesystem::remove(flush_path);
+    {
+        WriteAheadLog wal(flush_path, 100, chrono::milliseconds(20));
+        WalRecord record;
+        record.lsn = 1;
+        record.document_id = 7;
+        record.text = "lonely record"s;
+        wal.Append(record);
+        ASSERT_EQUAL(filesystem::file_size(flush_path), 0u);
+        this_thread::sleep_for(chrono::milliseconds(200));
+        ASSERT_HINT(filesystem::file_size(flush_path) > 0, "Idle record must be synced after sync_interval"s);
+        ASSERT_EQUAL(ReadWriteAheadLog(flush_path).records.size(), 1u);
+    }
+    filesystem::remove(flush_path);
+}
+
+void TestCursorPagination() {
+    SearchServer search_server("and"s);
+    // у части документов совпадают релевантность и рейтинг: их порядок задаёт id
+    for (int document_id = 0; document_id < 40; ++document_id) {
+        const string text = document_id % 3 == 0 ? "white cat and dog"s : document_id % 3 == 1 ? "black cat"s : "grey parrot"s;
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 4});
+    }
+    search_server.AddDocument(40, "white cat"s, DocumentStatus::BANNED, {10});
+    const auto prepared_query = search_server.PrepareQuery("white cat -parrot"s);
+
+    const vector<Document> all_documents = search_server.FindTopDocumentsAfter(prepared_query, nullopt, 1000);
+    ASSERT_EQUAL(all_documents.size(), 27u);
+    for (size_t i = 1; i < all_documents.size(); ++i) {
+        const Document& lhs = all_documents[i - 1];
+        const Document& rhs = all_documents[i];
+        ASSERT_HINT(lhs.relevance > rhs.relevance + EPSILON
+                    || (abs(lhs.relevance - rhs.relevance) < EPSILON
+                        && (lhs.rating > rhs.rating || (lhs.rating == rhs.rating && lhs.id < rhs.id))),
+                    "Documents must be in ranking order with ties broken by id"s);
+    }
+
+    // первая страница совпадает с обычным поиском
+    const vector<Document> top_documents = search_server.FindTopDocuments(prepared_query);
+    ASSERT_EQUAL(top_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    for (size_t i = 0; i < top_documents.size(); ++i) {
+        ASSERT_EQUAL(top_documents[i].id, all_documents[i].id);
+    }
+
+    // страницы по курсору складываются в полный список без пропусков и повторов
+    vector<Document> paged_documents;
+    optional<Document> cursor;
+    for (vector<Document> page = search_server.FindTopDocumentsAfter(prepared_query, cursor, 4); !page.empty();
+         page = search_server.FindTopDocumentsAfter(prepared_query, cursor, 4)) {
+        ASSERT(page.size() <= 4u);
+        paged_documents.insert(paged_documents.end(), page.begin(), page.end());
+        cursor = page.back();
+    }
+    ASSERT_EQUAL(paged_documents.size(), all_documents.size());
+    for (size_t i = 0; i < all_documents.size(); ++i) {
+        ASSERT_EQUAL(paged_documents[i].id, all_documents[i].id);
+    }
+
+    // ленивый постраничный обход потока результатов
+    size_t page_count = 0;
+    size_t position = 0;
+    for (const vector<Document>& page : PaginateLazily(SearchResultStream<>(search_server, "white cat -parrot"s), 5)) {
+        ++page_count;
+        for (const Document& document : page) {
+            ASSERT_EQUAL(document.id, all_documents[position++].id);
+        }
+    }
+    ASSERT_EQUAL(page_count, 6u);
+    ASSERT_EQUAL(position, all_documents.size());
+
+    // переход сразу к глубокой странице
+    SearchResultStream<> stream(search_server, "white cat -parrot"s);
+    stream.Skip(20);
+    const vector<Document> deep_page = stream.NextPage(5);
+    ASSERT_EQUAL(deep_page.size(), 5u);
+    ASSERT_EQUAL(deep_page.front().id, all_documents[20].id);
+    ASSERT_EQUAL(stream.GetCursor()->id, all_documents[24].id);
+    ASSERT(stream.NextPage(5).size() == 2u);
+    ASSERT(stream.NextPage(5).empty());
+
+    // фильтр по статусу
+    SearchResultStream<> banned_stream(search_server, "white cat"s, DocumentStatus::BANNED);
+    const vector<Document> banned_page = banned_stream.NextPage(10);
+    ASSERT_EQUAL(banned_page.size(), 1u);
+    ASSERT_EQUAL(banned_page[0].id, 40);
+}
+
+void TestNumaSearchServer() {
+    ASSERT(ParseCpuList("0-3,8,10-11\n"s) == vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    ASSERT(ParseCpuList(""s).empty());
+    try {
+        ParseCpuList("3-1"s);
+        ASSERT_HINT(false, "Reversed cpu range must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // каталог в формате sysfs: узел только с памятью пропускается
+    const filesystem::path node_directory = filesystem::temp_directory_path() / "search_server_test_numa"s;
+    filesystem::remove_all(node_directory);
+    for (const auto& [name, cpulist] : vector<pair<string, string>>{{"node1"s, "4-5\n"s}, {"node0"s, "0-3\n"s},
+                                                                     {"node2"s, "\n"s}, {"possible"s, ""s}}) {
+        filesystem::create_directories(node_directory / name);
+        ofstream(node_directory / name / "cpulist"s) << cpulist;
+    }
+    const vector<NumaNode> read_nodes = ReadNumaNodes(node_directory.string());
+    filesystem::remove_all(node_directory);
+    ASSERT_EQUAL(read_nodes.size(), 2u);
+    ASSERT_EQUAL(read_nodes[0].id, 0);
+    ASSERT(read_nodes[0].cpus == vector<int>({0, 1, 2, 3}));
+    ASSERT_EQUAL(read_nodes[1].id, 1);
+    ASSERT(ReadNumaNodes((node_directory / "missing"s).string()).empty());
+
+    // на любой машине находится хотя бы один узел с процессорами
+    const vector<NumaNode> detected_nodes = DetectNumaNodes();
+    ASSERT(!detected_nodes.empty());
+    ASSERT(!detected_nodes[0].cpus.empty());
+
+    mt19937 generator(5);
+    const auto dictionary = GenerateDictionary(generator, 100, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 300, 12);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 7)});
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 50, 3);
+    const auto expected = ::ProcessQueries(search_server, queries);
+
+    const auto check_results = [&expected](const vector<vector<Document>>& actual) {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            ASSERT_EQUAL(actual[i].size(), expected[i].size());
+            for (size_t j = 0; j < actual[i].size(); ++j) {
+                ASSERT_EQUAL(actual[i][j].id, expected[i][j].id);
+                ASSERT(abs(actual[i][j].relevance - expected[i][j].relevance) < EPSILON);
+            }
+        }
+    };
+
+    // на машине с одним узлом копии не строятся
+    {
+        NumaSearchServer numa_server(search_server, vector<NumaNode>{detected_nodes[0]});
+        check_results(numa_server.ProcessQueries(queries));
+        const auto stats = numa_server.GetNodeStats();
+        ASSERT_EQUAL(stats.size(), 1u);
+        ASSERT(!stats[0].has_replica);
+        ASSERT_EQUAL(stats[0].queries, queries.size());
+    }
+
+    // процессоры делятся между двумя узлами, у каждого своя копия индекса
+    const vector<int> allowed_cpus = GetAllowedCpus();
+    const size_t half = max<size_t>(1, allowed_cpus.size() / 2);
+    const vector<int> first_cpus(allowed_cpus.begin(), allowed_cpus.begin() + half);
+    const vector<int> second_cpus = allowed_cpus.size() > 1 ? vector<int>(allowed_cpus.begin() + half, allowed_cpus.end())
+                                                            : allowed_cpus;
+    NumaSearchServer numa_server(search_server, {{0, first_cpus}, {1, second_cpus}}, NumaOptions{true, 2});
+    ASSERT_EQUAL(numa_server.GetNodeCount(), 2u);
+    check_results(numa_server.ProcessQueries(queries));
+    // потоки узлов переживают ошибку в запросе и исполняют следующие пакеты
+    vector<string> invalid_queries = queries;
+    invalid_queries[queries.size() / 2] = "cat --dog"s;
+    try {
+        numa_server.ProcessQueries(invalid_queries);
+        ASSERT_HINT(false, "Invalid query must be reported by ProcessQueries"s);
+    } catch (const invalid_argument&) {
+    }
+    check_results(numa_server.ProcessQueries(queries));
+
+    uint64_t total_queries = 0;
+    for (const NumaNodeStats& stats : numa_server.GetNodeStats()) {
+        ASSERT(stats.has_replica);
+        total_queries += stats.queries;
+        if (allowed_cpus.size() > 1) {
+            ASSERT_EQUAL_HINT(stats.off_node_queries, 0u, "Pinned workers must stay on their node"s);
+        }
+    }
+    // куски пакета с ошибкой, исполненные без неё, тоже учтены
+    ASSERT(total_queries >= 2 * queries.size() && total_queries < 3 * queries.size());
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const vector<Document> result = numa_server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(result.size(), expected[i].size());
+    }
+
+    try {
+        NumaSearchServer invalid_server(search_server, {{0, {}}});
+        ASSERT_HINT(false, "Node without cpus must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestQuantizedImpacts() {
+    mt19937 generator(46);
+    // небольшой словарь даёт списки из нескольких блоков, часть которых пропускается
+    const vector<string> dictionary = GenerateDictionary(generator, 60, 6);
+    SearchServer search_server("and in at"s, IndexOptions{true});
+    SearchServer server_8("and in at"s, IndexOptions{true});
+    SearchServer server_16("and in at"s, IndexOptions{true});
+    SearchServer server_exact("and in at"s, IndexOptions{true});
+    for (int i = 0; i < 1500; ++i) {
+        const int document_id = i * 2 + 5;
+        // короткие документы дают много равных релевантностей, которые различает только рейтинг
+        const string text = GenerateQuery(generator, dictionary, i % 3 == 0 ? 3 : 25);
+        const auto status = static_cast<DocumentStatus>(i % 5 == 0 ? i % DOCUMENT_STATUS_COUNT : 0);
+        for (SearchServer* server : {&search_server, &server_8, &server_16, &server_exact}) {
+            server->AddDocument(document_id, text, status, {i % 4});
+        }
+    }
+    server_8.Freeze(FreezeOptions{false, ImpactPrecision::BITS_8});
+    server_16.Freeze(FreezeOptions{false, ImpactPrecision::BITS_16});
+    server_exact.Freeze();
+    // вклады учитываются в памяти замороженного индекса и заменяют tf в списках, поэтому
+    // индекс с вкладами меньше точного
+    const IndexStats stats_8 = server_8.GetIndexStats(0);
+    const IndexStats stats_16 = server_16.GetIndexStats(0);
+    const IndexStats stats_exact = server_exact.GetIndexStats(0);
+    ASSERT(stats_8.impact_bytes > 0 && stats_8.impact_bytes < stats_16.impact_bytes);
+    ASSERT(stats_16.impact_bytes < stats_16.frozen_index_bytes);
+    ASSERT_HINT(stats_8.frozen_index_bytes < stats_16.frozen_index_bytes, "8-bit impacts must take less memory than 16-bit"s);
+    ASSERT_HINT(stats_16.frozen_index_bytes < stats_exact.frozen_index_bytes, "Impacts must replace the exact term frequencies"s);
+
+    vector<string> queries = GenerateQueries(generator, dictionary, 200, 5);
+    for (size_t i = 0; i < 50; ++i) {
+        queries[i] += " -"s + dictionary[i % dictionary.size()];
+    }
+    queries.push_back(dictionary[3].substr(0, 2) + "* "s + dictionary[7]);
+    queries.push_back("\""s + dictionary[1] + " "s + dictionary[2] + "\""s);
+    queries.push_back("+"s + dictionary[4] + " "s + dictionary[5]);
+    queries.push_back("unknownword"s);
+
+    // точный пересчёт кандидатов сохраняет и состав, и порядок, и релевантность лучших документов
+    for (const string& query : queries) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const vector<Document> expected = search_server.FindTopDocuments(query, status);
+            for (const SearchServer* server : {&server_8, &server_16}) {
+                const vector<Document> actual = server->FindTopDocuments(query, status);
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for (size_t i = 0; i < actual.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, query);
+                    ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, query);
+                    ASSERT_HINT(actual[i].relevance == expected[i].relevance, query);
+                }
+            }
+        }
+    }
+    const auto parallel_result = server_8.FindTopDocuments(execution::par, queries[0]);
+    const auto sequential_result = search_server.FindTopDocuments(queries[0]);
+    ASSERT_EQUAL(parallel_result.size(), sequential_result.size());
+    // поиск без вкладов читает tf списков из прямого индекса и не меняет результат
+    const auto is_selected = [](int document_id, DocumentStatus, int) { return document_id % 4 == 1; };
+    for (size_t i = 0; i < 20; ++i) {
+        const vector<Document> expected = search_server.FindTopDocuments<Bm25Scorer>(execution::seq, queries[i], is_selected);
+        const vector<Document> actual = server_16.FindTopDocuments<Bm25Scorer>(execution::seq, queries[i], is_selected);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), queries[i]);
+        for (size_t j = 0; j < actual.size(); ++j) {
+            ASSERT_EQUAL_HINT(actual[j].id, expected[j].id, queries[i]);
+            ASSERT_HINT(actual[j].relevance == expected[j].relevance, queries[i]);
+        }
+    }
+
+    // вклад частого слова в длинных документах округляется до нуля: блоки с нулевым наибольшим
+    // вкладом пропускаются при первом проходе, но их документы должны попасть в результат
+    SearchServer exact_server(""s);
+    SearchServer rounded_server(""s);
+    string long_text;
+    for (int i = 0; i < 300; ++i) {
+        long_text += "filler "s;
+    }
+    for (SearchServer* server : {&exact_server, &rounded_server}) {
+        server->AddDocument(0, "rare"s, DocumentStatus::ACTUAL, {1});
+        for (int document_id = 1; document_id <= 4; ++document_id) {
+            server->AddDocument(document_id, long_text + "common"s, DocumentStatus::ACTUAL, {1});
+        }
+        for (int document_id = 5; document_id <= 8; ++document_id) {
+            server->AddDocument(document_id, "unrelated"s, DocumentStatus::ACTUAL, {1});
+        }
+    }
+    rounded_server.Freeze(FreezeOptions{false, ImpactPrecision::BITS_8});
+    const vector<Document> exact_documents = exact_server.FindTopDocuments("rare common"s);
+    const vector<Document> rounded_documents = rounded_server.FindTopDocuments("rare common"s);
+    ASSERT_EQUAL(exact_documents.size(), 5u);
+    ASSERT_EQUAL(rounded_documents.size(), exact_documents.size());
+    for (size_t i = 0; i < exact_documents.size(); ++i) {
+        ASSERT_EQUAL(rounded_documents[i].id, exact_documents[i].id);
+        ASSERT(rounded_documents[i].relevance == exact_documents[i].relevance);
+    }
+}
+
+void TestImpactKernel() {
+    ASSERT(IsKernelIsaSupported(KernelIsa::SCALAR));
+    ASSERT(IsKernelIsaSupported(GetBestKernelIsa()));
+
+    mt19937 generator(47);
+    vector<uint32_t> all_indices(2000);
+    iota(all_indices.begin(), all_indices.end(), 0);
+    for (const size_t count : {0u, 1u, 7u, 8u, 15u, 16u, 127u, 128u, 300u}) {
+        // номера документов в одном вызове не повторяются, как в списке документов слова
+        shuffle(all_indices.begin(), all_indices.end(), generator);
+        const vector<uint32_t> indices(all_indices.begin(), all_indices.begin() + count);
+        vector<uint8_t> impacts_8(count);
+        vector<uint16_t> impacts_16(count);
+        for (size_t i = 0; i < count; ++i) {
+            impacts_8[i] = generator() % 256;
+            impacts_16[i] = generator() % 65536;
+        }
+        vector<uint32_t> initial_scores(all_indices.size());
+        for (uint32_t& score : initial_scores) {
+            score = generator() % 2 == 0 ? 0 : generator() % 100000;
+        }
+
+        vector<uint32_t> expected_8 = initial_scores;
+        vector<uint32_t> expected_16 = initial_scores;
+        AddImpacts(KernelIsa::SCALAR, indices.data(), impacts_8.data(), count, expected_8.data());
+        AddImpacts(KernelIsa::SCALAR, indices.data(), impacts_16.data(), count, expected_16.data());
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQUAL(expected_8[indices[i]], (initial_scores[indices[i]] + impacts_8[i]) | IMPACT_TOUCHED_BIT);
+        }
+
+        for (const KernelIsa isa : {KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (!IsKernelIsaSupported(isa)) {
+                continue;
+            }
+            vector<uint32_t> scores_8 = initial_scores;
+            vector<uint32_t> scores_16 = initial_scores;
+            AddImpacts(isa, indices.data(), impacts_8.data(), count, scores_8.data());
+            AddImpacts(isa, indices.data(), impacts_16.data(), count, scores_16.data());
+            ASSERT_HINT(scores_8 == expected_8, string(ToString(isa)));
+            ASSERT_HINT(scores_16 == expected_16, string(ToString(isa)));
+        }
+    }
+}
+
+void TestIndexStats() {
+    SearchServer search_server("and in"s, IndexOptions{true, true});
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.AddDocument(4, "groomed starling cat"s, DocumentStatus::ACTUAL, {9});
+
+    const IndexStats stats = search_server.GetIndexStats(3);
+    ASSERT_EQUAL(stats.document_count, 4u);
+    // white cat fashionable collar fluffy tail groomed dog expressive eyes starling
+    ASSERT_EQUAL(stats.term_count, 11u);
+    ASSERT_EQUAL(stats.posting_count, 14u);
+    // 9 слов в одном документе, groomed в двух, cat в трёх
+    ASSERT(stats.posting_length_histogram == vector<size_t>({9, 2}));
+    ASSERT_EQUAL(stats.heaviest_terms.size(), 3u);
+    ASSERT_EQUAL(stats.heaviest_terms[0].word, "cat"s);
+    ASSERT_EQUAL(stats.heaviest_terms[0].document_count, 3u);
+    for (size_t i = 1; i < stats.heaviest_terms.size(); ++i) {
+        ASSERT(stats.heaviest_terms[i - 1].bytes >= stats.heaviest_terms[i].bytes);
+    }
+    ASSERT(stats.dictionary_bytes > 0 && stats.postings_bytes > 0 && stats.positions_bytes > 0);
+    ASSERT(stats.forward_index_bytes > 0 && stats.document_ids_bytes > 0 && stats.rating_index_bytes > 0);
+    ASSERT(stats.document_store_bytes > 0);
+    ASSERT_EQUAL(stats.frozen_index_bytes, 0u);
+    ASSERT(stats.index_pool_bytes > 0);
+    ASSERT(stats.total_bytes >= stats.dictionary_bytes + stats.postings_bytes + stats.forward_index_bytes);
+
+    ostringstream out;
+    out << stats;
+    ASSERT(out.str().find("terms = 11"s) != string::npos);
+
+    search_server.RemoveDocument(2);
+    const IndexStats removed_stats = search_server.GetIndexStats(0);
+    ASSERT_EQUAL(removed_stats.document_count, 3u);
+    ASSERT_EQUAL(removed_stats.posting_count, 11u);
+    ASSERT(removed_stats.heaviest_terms.empty());
+
+    // после заморозки списки учитываются в памяти замороженного индекса
+    search_server.Freeze();
+    const IndexStats frozen_stats = search_server.GetIndexStats();
+    ASSERT_EQUAL(frozen_stats.posting_count, removed_stats.posting_count);
+    ASSERT_EQUAL(frozen_stats.postings_bytes, 0u);
+    ASSERT(frozen_stats.frozen_index_bytes > 0);
+    ASSERT_EQUAL(frozen_stats.impact_bytes, 0u);
+    ASSERT_EQUAL(frozen_stats.heaviest_terms.front().word, "cat"s);
+}
+
+void TestQueryPlanner() {
+    mt19937 generator(49);
+    const vector<string> dictionary = GenerateDictionary(generator, 30, 6);
+    SearchServer search_server("and in at"s, IndexOptions{true});
+    SearchServer frozen_server("and in at"s);
+    for (int i = 0; i < 2000; ++i) {
+        const string text = GenerateQuery(generator, dictionary, 20) + (i % 700 == 0 ? " rareword"s : ""s);
+        const auto status = static_cast<DocumentStatus>(i % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL);
+        search_server.AddDocument(i, text, status, {i % 5});
+        frozen_server.AddDocument(i, text, status, {i % 5});
+    }
+    frozen_server.Freeze(FreezeOptions{false, ImpactPrecision::BITS_16});
+    const auto even_rating = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating % 2 == 0;
+    };
+    const auto assert_same = [](const vector<Document>& actual, const vector<Document>& expected, const string& hint) {
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+        for (size_t i = 0; i < actual.size(); ++i) {
+            ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+            ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+            ASSERT_HINT(actual[i].relevance == expected[i].relevance, hint);
+        }
+    };
+    const auto has_strategy = [](const QueryPlan& plan, QueryStrategy strategy) {
+        return any_of(plan.alternatives.begin(), plan.alternatives.end(), [strategy](const auto& alternative) {
+            return alternative.first == strategy;
+        });
+    };
+
+    const string query = dictionary[1] + " "s + dictionary[2] + " "s + dictionary[3] + " rareword -"s + dictionary[4];
+    const auto prepared_query = search_server.PrepareQuery(query);
+    {
+        // слова плана упорядочены по избирательности, минус-слово тоже учитывается
+        const QueryPlan plan = search_server.PlanQuery(prepared_query);
+        ASSERT(plan.strategy == QueryStrategy::SEQUENTIAL);
+        ASSERT(!plan.reads_document_data);
+        ASSERT_EQUAL(plan.terms.size(), 5u);
+        ASSERT_EQUAL(plan.terms.front().word, "rareword"s);
+        ASSERT(plan.terms.back().document_count >= plan.terms[1].document_count);
+        ASSERT_EQUAL(count_if(plan.terms.begin(), plan.terms.end(), [](const PlannedTerm& term) {
+                         return term.role == TermRole::MINUS;
+                     }), 1);
+        ASSERT(plan.minus_postings > 0);
+        ASSERT(!has_strategy(plan, QueryStrategy::BITMAP));
+        assert_same(search_server.FindTopDocumentsPlanned(prepared_query), search_server.FindTopDocuments(query), query);
+    }
+    {
+        // предикату нужны данные каждого документа: дешевле проверить их один раз через битовую карту
+        const QueryExplanation explanation = search_server.ExplainQuery(prepared_query, even_rating);
+        ASSERT(explanation.plan.strategy == QueryStrategy::BITMAP);
+        ASSERT(explanation.plan.reads_document_data);
+        ASSERT(explanation.scored_documents >= explanation.documents.size());
+        ASSERT(explanation.scored_documents <= explanation.plan.estimated_matches);
+        assert_same(explanation.documents, search_server.FindTopDocuments(query, even_rating), query);
+        ostringstream out;
+        out << explanation;
+        ASSERT_HINT(out.str().find("EXPLAIN bitmap"s) == 0, out.str());
+        ASSERT_HINT(out.str().find("scored_documents = "s) != string::npos, out.str());
+        // битовая карта читает целиком списки минус-слов и плюс-слов
+        ASSERT_EQUAL(explanation.posting_reads, explanation.plan.plus_postings + explanation.plan.minus_postings);
+        ASSERT_HINT(out.str().find("posting_reads = "s + to_string(explanation.posting_reads)) != string::npos, out.str());
+
+        // политике BM25 длина документа нужна всё равно, и битовая карта не рассматривается
+        const QueryPlan plan = search_server.PlanQuery<Bm25Scorer>(prepared_query, even_rating);
+        ASSERT(!has_strategy(plan, QueryStrategy::BITMAP));
+        assert_same(search_server.FindTopDocumentsPlanned<Bm25Scorer>(prepared_query, even_rating),
+                    search_server.FindTopDocuments<Bm25Scorer>(query, even_rating), query);
+    }
+    {
+        // по одному редкому слову обходить все документы дороже, чем его список
+        const auto rare_query = search_server.PrepareQuery("rareword"s);
+        ASSERT(search_server.PlanQuery(rare_query, even_rating).strategy == QueryStrategy::SEQUENTIAL);
+        assert_same(search_server.FindTopDocumentsPlanned(rare_query, even_rating),
+                    search_server.FindTopDocuments("rareword"s, even_rating), "rareword"s);
+    }
+    {
+        const string required_query = "+rareword "s + dictionary[1];
+        const auto prepared_required = search_server.PrepareQuery(required_query);
+        const QueryPlan plan = search_server.PlanQuery(prepared_required, even_rating);
+        ASSERT(plan.strategy == QueryStrategy::INTERSECTION);
+        ASSERT(plan.terms.front().role == TermRole::REQUIRED);
+        ASSERT(plan.estimated_matches <= 3u);
+        assert_same(search_server.FindTopDocumentsPlanned(prepared_required, even_rating),
+                    search_server.FindTopDocuments(required_query, even_rating), required_query);
+        // пересечение читает короткий список и ищет его документы в длинном, не обходя его
+        const QueryExplanation explanation = search_server.ExplainQuery(prepared_required, even_rating);
+        ASSERT(explanation.posting_reads > 0);
+        ASSERT_HINT(explanation.posting_reads < plan.plus_postings / 10, to_string(explanation.posting_reads));
+
+        const string required_phrase_query = "+rareword \""s + dictionary[1] + " "s + dictionary[2] + "\""s;
+        const auto prepared_required_phrase = search_server.PrepareQuery(required_phrase_query);
+        ASSERT(search_server.PlanQuery(prepared_required_phrase).strategy == QueryStrategy::INTERSECTION);
+        assert_same(search_server.FindTopDocumentsPlanned(prepared_required_phrase),
+                    search_server.FindTopDocuments(required_phrase_query), required_phrase_query);
+    }
+    {
+        const string phrase_query = "\""s + dictionary[1] + " "s + dictionary[2] + "\" "s + dictionary[5] + " "s + dictionary[6];
+        const auto prepared_phrase = search_server.PrepareQuery(phrase_query);
+        ASSERT(search_server.PlanQuery(prepared_phrase, even_rating).strategy == QueryStrategy::BITMAP);
+        assert_same(search_server.FindTopDocumentsPlanned(prepared_phrase, even_rating),
+                    search_server.FindTopDocuments(phrase_query, even_rating), phrase_query);
+    }
+    {
+        const auto frozen_query = frozen_server.PrepareQuery(query);
+        const QueryExplanation explanation = frozen_server.ExplainQuery(frozen_query, DocumentStatus::BANNED);
+        ASSERT(explanation.plan.strategy == QueryStrategy::IMPACT_PRUNING);
+        ASSERT(explanation.scored_documents >= explanation.documents.size());
+        ASSERT(explanation.posting_reads > 0);
+        assert_same(explanation.documents, search_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        // для произвольного предиката квантованные вклады не применяются
+        ASSERT(!has_strategy(frozen_server.PlanQuery(frozen_query, even_rating), QueryStrategy::IMPACT_PRUNING));
+    }
+}
+
+void TestRoaringBitmap() {
+    mt19937 generator(50);
+    // блоки разной плотности: массивы, битовые карты и блоки на границе ARRAY_MAX_SIZE
+    const auto generate_set = [&generator](size_t dense_count) {
+        set<int> document_ids;
+        for (size_t i = 0; i < dense_count; ++i) {
+            document_ids.insert(uniform_int_distribution<int>(0, 65535)(generator));
+        }
+        for (int i = 0; i < 3000; ++i) {
+            document_ids.insert(uniform_int_distribution<int>(65536, 4 * 65536)(generator));
+        }
+        document_ids.insert(numeric_limits<int>::max());
+        return document_ids;
+    };
+    const auto to_bitmap = [](const set<int>& document_ids) {
+        RoaringBitmap bitmap;
+        // добавление не по возрастанию проверяет вставку в середину блоков
+        for (auto it = document_ids.rbegin(); it != document_ids.rend(); ++it) {
+            bitmap.Add(*it);
+        }
+        return bitmap;
+    };
+    const auto to_vector = [](const set<int>& document_ids) {
+        return vector<int>(document_ids.begin(), document_ids.end());
+    };
+
+    for (const size_t dense_count : {100u, 4096u, 30000u}) {
+        const set<int> lhs_ids = generate_set(dense_count);
+        const set<int> rhs_ids = generate_set(dense_count / 2 + 5000);
+        const RoaringBitmap lhs = to_bitmap(lhs_ids);
+        const RoaringBitmap rhs = to_bitmap(rhs_ids);
+        ASSERT_EQUAL(lhs.Cardinality(), lhs_ids.size());
+        ASSERT_EQUAL(lhs.ToVector(), to_vector(lhs_ids));
+        for (int document_id = 0; document_id < 70000; document_id += 7) {
+            ASSERT_EQUAL(lhs.Contains(document_id), lhs_ids.count(document_id) > 0);
+        }
+        ASSERT(!lhs.Contains(-1));
+
+        set<int> expected;
+        set_intersection(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(), inserter(expected, expected.end()));
+        RoaringBitmap result = lhs;
+        result.And(rhs);
+        ASSERT_EQUAL(result.ToVector(), to_vector(expected));
+        ASSERT(result == to_bitmap(expected));
+
+        expected.clear();
+        set_union(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(), inserter(expected, expected.end()));
+        result = lhs;
+        result.Or(rhs);
+        ASSERT_EQUAL(result.ToVector(), to_vector(expected));
+        ASSERT(result == to_bitmap(expected));
+
+        expected.clear();
+        set_difference(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(), inserter(expected, expected.end()));
+        result = lhs;
+        result.AndNot(rhs);
+        ASSERT_EQUAL(result.ToVector(), to_vector(expected));
+        ASSERT(result == to_bitmap(expected));
+        result.AndNot(lhs);
+        ASSERT(result.Empty());
+    }
+
+    // плотный блок занимает бит на документ, редкий - 2 байта
+    RoaringBitmap dense;
+    for (int document_id = 0; document_id < 60000; ++document_id) {
+        dense.Add(document_id);
+    }
+    ASSERT(dense.GetMemoryBytes() < 60000 / 8 + 1024);
+    for (int document_id = 0; document_id < 60000; document_id += 2) {
+        ASSERT(dense.Remove(document_id));
+    }
+    ASSERT(!dense.Remove(0) && !dense.Remove(100000));
+    try {
+        dense.Add(-1);
+        ASSERT_HINT(false, "Negative document id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(dense.Cardinality(), 30000u);
+    ASSERT(dense.Contains(1) && !dense.Contains(2));
+
+    // копия в заданной памяти не зависит от исходного множества
+    pmr::monotonic_buffer_resource memory;
+    RoaringBitmap copy(dense, &memory);
+    dense.Clear();
+    ASSERT(dense.Empty());
+    ASSERT_EQUAL(copy.Cardinality(), 30000u);
+}
+
+void TestAllowedDocumentsFilter() {
+    mt19937 generator(51);
+    const vector<string> dictionary = GenerateDictionary(generator, 40, 6);
+    SearchServer search_server("and in at"s);
+    for (int i = 0; i < 1000; ++i) {
+        const auto status = i % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(i * 3, GenerateQuery(generator, dictionary, 15), status, {i % 10});
+    }
+    ASSERT_EQUAL(search_server.GetStatusDocuments(DocumentStatus::BANNED).Cardinality(), 250u);
+    ASSERT_EQUAL(search_server.GetStatusDocuments(DocumentStatus::ACTUAL).Cardinality(), 750u);
+    ASSERT(search_server.GetStatusDocuments(DocumentStatus::REMOVED).Empty());
+    search_server.RemoveDocument(0);
+    search_server.RemoveDocument(execution::par, 3);
+    ASSERT(!search_server.GetStatusDocuments(DocumentStatus::BANNED).Contains(0));
+    ASSERT(!search_server.GetStatusDocuments(DocumentStatus::ACTUAL).Contains(3));
+    ASSERT(search_server.GetIndexStats().status_documents_bytes > 0);
+
+    const vector<string> queries = GenerateQueries(generator, dictionary, 50, 4);
+    // небольшое множество проверяется по документам, большое - при обходе списков;
+    // в множестве есть и id, которых нет в индексе
+    for (const int step : {1, 2, 40}) {
+        auto allowed_documents = make_shared<RoaringBitmap>();
+        for (int document_id = 0; document_id < 3100; document_id += step) {
+            allowed_documents->Add(document_id);
+        }
+        const DocumentFilter filter = DocumentFilter().AddStatus(DocumentStatus::ACTUAL).SetAllowedDocuments(allowed_documents);
+        const DocumentFilter rating_filter = DocumentFilter(filter).SetRatingRange(3, 4);
+        const auto is_allowed = [&allowed_documents](int document_id, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL && allowed_documents->Contains(document_id);
+        };
+        const auto is_allowed_rating = [&is_allowed](int document_id, DocumentStatus status, int rating) {
+            return is_allowed(document_id, status, rating) && 3 <= rating && rating <= 4;
+        };
+        for (const string& query : queries) {
+            const vector<Document> expected = search_server.FindTopDocuments(query, is_allowed);
+            for (const auto& actual : {search_server.FindTopDocuments(query, filter),
+                                       search_server.FindTopDocuments(execution::par, query, filter)}) {
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for (size_t i = 0; i < actual.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, query);
+                    ASSERT_HINT(abs(actual[i].relevance - expected[i].relevance) < EPSILON, query);
+                }
+            }
+            const vector<Document> expected_rating = search_server.FindTopDocuments(query, is_allowed_rating);
+            const vector<Document> actual_rating = search_server.FindTopDocuments(query, rating_filter);
+            ASSERT_EQUAL_HINT(actual_rating.size(), expected_rating.size(), query);
+            for (size_t i = 0; i < actual_rating.size(); ++i) {
+                ASSERT_EQUAL_HINT(actual_rating[i].id, expected_rating[i].id, query);
+            }
+        }
+    }
+
+    try {
+        DocumentFilter().SetAllowedDocuments(nullptr);
+        ASSERT_HINT(false, "Null document set must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -299,4 +1912,30 @@ void TestSearchServer() {
     RUN_TEST(TestGetWordFrequencies);
     RUN_TEST(TestRemoveDocument);
     RUN_TEST(TestRemoveDuplicates); //Дает дополнительный вывод в cout из функции RemoveDuplicates
+    RUN_TEST(TestLoadCorpus);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestScorers);
+    RUN_TEST(TestRequiredWords);
+    RUN_TEST(TestMinusWordsExclusion);
+    RUN_TEST(TestStatusPartitionedPostings);
+    RUN_TEST(TestDocumentFilter);
+    RUN_TEST(TestRequestStats);
+    RUN_TEST(TestAsyncSearchServer);
+    RUN_TEST(TestFindTopDocumentsBatch);
+    RUN_TEST(TestQueryAllocations);
+    RUN_TEST(TestForwardIndex);
+    RUN_TEST(TestPreparedQuery);
+    RUN_TEST(TestDifferential);
+    RUN_TEST(TestFrozenIndex);
+    RUN_TEST(TestTermExpansion);
+    RUN_TEST(TestSnippets);
+    RUN_TEST(TestPersistence);
+    RUN_TEST(TestCursorPagination);
+    RUN_TEST(TestNumaSearchServer);
+    RUN_TEST(TestQuantizedImpacts);
+    RUN_TEST(TestImpactKernel);
+    RUN_TEST(TestIndexStats);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestRoaringBitmap);
+    RUN_TEST(TestAllowedDocumentsFilter);
 }
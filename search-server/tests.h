@@ -84,6 +84,84 @@ void TestRemoveDocument();
 
 void TestRemoveDuplicates();
 
+//Загрузка корпуса из отображённого в память файла
+void TestLoadCorpus();
+
+//Фразовые запросы и запросы близости по позициям слов
+void TestPhraseQueries();
+
+//Ранжирование политиками TF-IDF и BM25
+void TestScorers();
+
+//Обязательные слова и режим поиска по всем словам
+void TestRequiredWords();
+
+//Исключение документов с минус-словами до подсчёта релевантности
+void TestMinusWordsExclusion();
+
+//Списки документов, разделённые по статусу
+void TestStatusPartitionedPostings();
+
+//Типизированный фильтр по статусам и диапазону рейтинга
+void TestDocumentFilter();
+
+//Статистика запросов по окнам реального времени
+void TestRequestStats();
+
+//Асинхронный поиск с группировкой запросов в пакеты
+void TestAsyncSearchServer();
+
+//Пакетный поиск с общим обходом списков документов
+void TestFindTopDocumentsBatch();
+
+//Поиск без выделений памяти после прогрева
+void TestQueryAllocations();
+
+//Прямой индекс по номерам слов
+void TestForwardIndex();
+
+//Подготовленные запросы для многократного выполнения
+void TestPreparedQuery();
+
+//Сравнение с эталонной реализацией на случайных сценариях
+void TestDifferential();
+
+//Замороженный индекс только для чтения
+void TestFrozenIndex();
+
+//Поиск по префиксу и нечёткий поиск
+void TestTermExpansion();
+
+//Хранилище текстов документов и фрагменты с найденными словами
+void TestSnippets();
+
+//Журнал изменений, снимки индекса и восстановление после перезапуска
+void TestPersistence();
+
+//Постраничный поиск по курсору и ленивый постраничный обход результатов
+void TestCursorPagination();
+
+//Поиск с копиями индекса на узлах NUMA и привязкой потоков к узлам
+void TestNumaSearchServer();
+
+//Поиск по квантованным вкладам слов с точным пересчётом лучших документов
+void TestQuantizedImpacts();
+
+//Векторное ядро сложения квантованных вкладов и его скалярный вариант
+void TestImpactKernel();
+
+//Статистика индекса и учёт памяти по структурам
+void TestIndexStats();
+
+//Планировщик запросов: выбор способа выполнения по оценке стоимости и вывод EXPLAIN
+void TestQueryPlanner();
+
+//Сжатое множество документов и операции над ним
+void TestRoaringBitmap();
+
+//Фильтр по готовому множеству допустимых документов и множества документов по статусам
+void TestAllowedDocumentsFilter();
+
 // --------- Окончание модульных тестов поисковой системы -----------
 
 // Функция TestSearchServer является точкой входа для запуска тестов
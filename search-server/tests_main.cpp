@@ -0,0 +1,7 @@
+// Точка входа для запуска тестов, в том числе под санитайзерами.
+// Сборка описана в README.md; в сборку main.cpp файл не входит
+#include "tests.h"
+
+int main() {
+    TestSearchServer();
+}
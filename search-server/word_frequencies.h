@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Запись прямого индекса: номер слова в словаре сервера и его частота в документе
+struct TermFrequency {
+    int term_id;
+    double freq;
+};
+
+// Частоты слов документа: представление над записями прямого индекса, упорядоченными
+// по номеру слова, а не по алфавиту. Действительно до следующего изменения сервера
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const TermFrequency* entry, const std::vector<std::string_view>* terms)
+                : entry_(entry)
+                , terms_(terms) {
+        }
+
+        value_type operator*() const {
+            return {(*terms_)[entry_->term_id], entry_->freq};
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const TermFrequency* entry_;
+        const std::vector<std::string_view>* terms_;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const std::vector<TermFrequency>& entries, const std::vector<std::string_view>& terms)
+            : first_(entries.data())
+            , last_(entries.data() + entries.size())
+            , terms_(&terms) {
+    }
+
+    Iterator begin() const {
+        return {first_, terms_};
+    }
+
+    Iterator end() const {
+        return {last_, terms_};
+    }
+
+    size_t size() const {
+        return last_ - first_;
+    }
+
+    bool empty() const {
+        return first_ == last_;
+    }
+
+    // Для кода, которому нужен прежний словарь с алфавитным порядком
+    operator std::map<std::string_view, double>() const {
+        return {begin(), end()};
+    }
+
+private:
+    const TermFrequency* first_ = nullptr;
+    const TermFrequency* last_ = nullptr;
+    const std::vector<std::string_view>* terms_ = nullptr;
+};
@@ -0,0 +1,190 @@
+#include "write_ahead_log.h"
+#include "binary_io.h"
+#include "corpus_reader.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+void WriteAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            throw runtime_error("Ошибка записи журнала изменений"s);
+        }
+        data.remove_prefix(written);
+    }
+}
+
+WalRecord ParseRecord(string_view payload) {
+    ByteReader in(payload);
+    WalRecord record;
+    record.lsn = in.ReadVarint();
+    record.type = static_cast<WalRecord::Type>(in.ReadVarint());
+    record.document_id = in.ReadInt();
+    if (record.type == WalRecord::Type::ADD_DOCUMENT) {
+        const uint64_t status = in.ReadVarint();
+        if (status >= DOCUMENT_STATUS_COUNT) {
+            throw invalid_argument("Некорректный статус в журнале изменений"s);
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        record.ratings.resize(in.ReadVarint());
+        for (int& rating : record.ratings) {
+            rating = in.ReadInt();
+        }
+        record.text = in.ReadString();
+    } else if (record.type != WalRecord::Type::REMOVE_DOCUMENT) {
+        throw invalid_argument("Некорректный тип записи журнала изменений"s);
+    }
+    return record;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path, size_t sync_every_records, chrono::milliseconds sync_interval)
+        : sync_every_records_(max<size_t>(sync_every_records, 1))
+        , sync_interval_(sync_interval) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        throw invalid_argument("Не удалось открыть журнал изменений "s + path);
+    }
+    flusher_ = thread([this] { RunFlusher(); });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    buffer_changed_.notify_one();
+    flusher_.join();
+    try {
+        Sync();
+    } catch (...) {
+        // деструктор не должен бросать; несброшенные записи теряются, как при сбое
+    }
+    close(fd_);
+}
+
+void WriteAheadLog::Append(const WalRecord& record) {
+    ByteWriter payload;
+    payload.WriteVarint(record.lsn);
+    payload.WriteVarint(static_cast<uint8_t>(record.type));
+    payload.WriteInt(record.document_id);
+    if (record.type == WalRecord::Type::ADD_DOCUMENT) {
+        payload.WriteVarint(static_cast<int>(record.status));
+        payload.WriteVarint(record.ratings.size());
+        for (const int rating : record.ratings) {
+            payload.WriteInt(rating);
+        }
+        payload.WriteString(record.text);
+    }
+
+    ByteWriter header;
+    header.WriteUint32(payload.Data().size());
+    header.WriteUint32(ComputeCrc32(payload.Data()));
+
+    lock_guard lock(mutex_);
+    ThrowFlushError();
+    buffer_ += header.Data();
+    buffer_ += payload.Data();
+
+    if (++pending_records_ >= sync_every_records_) {
+        WriteBuffer();
+    } else if (pending_records_ == 1) {
+        oldest_record_time_ = chrono::steady_clock::now();
+        buffer_changed_.notify_one();
+    }
+}
+
+void WriteAheadLog::Sync() {
+    lock_guard lock(mutex_);
+    ThrowFlushError();
+    WriteBuffer();
+}
+
+void WriteAheadLog::Truncate(size_t size) {
+    lock_guard lock(mutex_);
+    ThrowFlushError();
+    WriteBuffer();
+    if (ftruncate(fd_, size) != 0 || fdatasync(fd_) != 0) {
+        throw runtime_error("Ошибка усечения журнала изменений"s);
+    }
+}
+
+void WriteAheadLog::WriteBuffer() {
+    if (!buffer_.empty()) {
+        WriteAll(fd_, buffer_);
+        buffer_.clear();
+        if (fdatasync(fd_) != 0) {
+            throw runtime_error("Ошибка синхронизации журнала изменений"s);
+        }
+    }
+    pending_records_ = 0;
+}
+
+void WriteAheadLog::ThrowFlushError() const {
+    if (flush_error_) {
+        rethrow_exception(flush_error_);
+    }
+}
+
+void WriteAheadLog::RunFlusher() {
+    unique_lock lock(mutex_);
+    while (!is_stopping_) {
+        if (pending_records_ == 0) {
+            buffer_changed_.wait(lock);
+            continue;
+        }
+        // буфер мог быть сброшен и заполнен заново, пока поток ждал, поэтому срок считается каждый раз
+        const auto deadline = oldest_record_time_ + sync_interval_;
+        if (chrono::steady_clock::now() < deadline) {
+            buffer_changed_.wait_until(lock, deadline);
+            continue;
+        }
+        try {
+            WriteBuffer();
+        } catch (...) {
+            // повторять сброс после ошибки записи бессмысленно: её получит следующий вызов
+            flush_error_ = current_exception();
+            return;
+        }
+    }
+}
+
+WalContents ReadWriteAheadLog(const string& path) {
+    WalContents contents;
+    if (!filesystem::exists(path)) {
+        return contents;
+    }
+    const MappedFile file(path);
+    string_view data = file.Data();
+    while (data.size() >= RECORD_HEADER_SIZE) {
+        ByteReader header(data.substr(0, RECORD_HEADER_SIZE));
+        const uint32_t size = header.ReadUint32();
+        const uint32_t crc = header.ReadUint32();
+        if (size > data.size() - RECORD_HEADER_SIZE) {
+            break;
+        }
+        const string_view payload = data.substr(RECORD_HEADER_SIZE, size);
+        if (ComputeCrc32(payload) != crc) {
+            break;
+        }
+        try {
+            contents.records.push_back(ParseRecord(payload));
+        } catch (const invalid_argument&) {
+            break;
+        }
+        data.remove_prefix(RECORD_HEADER_SIZE + size);
+        contents.valid_size += RECORD_HEADER_SIZE + size;
+    }
+    return contents;
+}
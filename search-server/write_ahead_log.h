@@ -0,0 +1,85 @@
+#pragma once
+
+#include "document.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct WalRecord {
+    enum class Type : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    // номер записи: растёт на единицу с каждой записью и продолжается после снимков
+    uint64_t lsn = 0;
+    Type type = Type::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// Журнал изменений индекса. Запись - длина, CRC-32 и содержимое, поэтому недописанный
+// при сбое хвост распознаётся при чтении. Записи копятся в буфере и сбрасываются на диск
+// группой: одним write и одним fdatasync, когда накопилось sync_every_records записей или
+// самая старая запись буфера ждёт дольше sync_interval. По времени буфер сбрасывает фоновый
+// поток, поэтому последняя запись попадает на диск, даже если новых записей больше нет.
+// Записи, не попавшие на диск, при сбое теряются
+class WriteAheadLog {
+public:
+    WriteAheadLog(const std::string& path, size_t sync_every_records, std::chrono::milliseconds sync_interval);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Останавливает фоновый поток и сбрасывает накопленные записи
+    ~WriteAheadLog();
+
+    // Ошибку фонового сброса Append и Sync бросают повторно
+    void Append(const WalRecord& record);
+
+    // Записывает накопленные записи и дожидается их попадания на диск
+    void Sync();
+
+    // Обрезает журнал до size байт; накопленные записи предварительно сбрасываются
+    void Truncate(size_t size);
+
+private:
+    int fd_ = -1;
+    std::string buffer_;
+    size_t pending_records_ = 0;
+    size_t sync_every_records_;
+    std::chrono::milliseconds sync_interval_;
+
+    std::mutex mutex_;
+    std::condition_variable buffer_changed_;
+    std::chrono::steady_clock::time_point oldest_record_time_;
+    std::exception_ptr flush_error_;
+    bool is_stopping_ = false;
+    std::thread flusher_;
+
+    // Сбрасывает буфер на диск; вызывается под mutex_
+    void WriteBuffer();
+
+    void ThrowFlushError() const;
+
+    void RunFlusher();
+};
+
+struct WalContents {
+    std::vector<WalRecord> records;
+    // длина части файла с целыми записями; всё, что дальше, - недописанный или повреждённый хвост
+    size_t valid_size = 0;
+};
+
+// Записи журнала до первой недописанной или повреждённой; пустой результат, если файла нет
+WalContents ReadWriteAheadLog(const std::string& path);